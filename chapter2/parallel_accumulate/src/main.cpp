@@ -1,24 +1,45 @@
 #include <thread>
 #include <numeric>
 #include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
 #include <vector>
 #include <iostream>
 
+#include "grain_controller.h"
+#include "simd_kernels.h"
+
 // 使用函数对象可以获得更好的复用性
+// 连续内存上的 int/float/double 交给向量化内核, 其余类型仍走 std::accumulate
 template <typename Iterator, typename T>
 struct accumulate_block {
   void operator()(Iterator first, Iterator last, T& result) {
-    result = std::accumulate(first, last, result);
+    if constexpr (std::contiguous_iterator<Iterator> &&
+                  simd::is_vectorizable_v<T> &&
+                  std::is_same_v<std::iter_value_t<Iterator>, T>) {
+      result = simd::sum(std::to_address(first),
+                         static_cast<std::size_t>(last - first), result);
+    } else {
+      result = std::accumulate(first, last, result);
+    }
   }
 };
 
 template <typename Iterator, typename T>
 T parallel_accumulate(Iterator first, Iterator last, T init) {
-  unsigned long const length = std::distance(first, last);
+  unsigned long length = std::distance(first, last);
+  // 每个线程至少处理 grain 个元素, grain 由第一次调用时测量的每个元素开销决定
+  grain_controller& grains = grain_controller_for<"parallel_accumulate", accumulate_block<Iterator, T>>();
+  unsigned long const sampled = grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+    accumulate_block<Iterator, T>()(begin, end, init);
+  });
+  std::advance(first, sampled);
+  length -= sampled;
   if (length == 0) {
     return init;
   }
-  unsigned long const min_per_thread = 25;
+  unsigned long const min_per_thread = grains.grain();
   unsigned long const max_threads = (length + min_per_thread - 1) / min_per_thread;
   unsigned long const hardware_threads = std::thread::hardware_concurrency();
   unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
@@ -37,7 +58,9 @@ T parallel_accumulate(Iterator first, Iterator last, T init) {
     block_start = block_end;
   }
 
+  chunk_timer timer(grains, length - (num_threads - 1) * block_size);
   accumulate_block<Iterator, T>()(block_start, last, results[num_threads - 1]);
+  timer.stop();
   for(auto& entry : threads) {
     entry.join();
   }
@@ -73,5 +96,7 @@ int main() {
     std::cout << "result validation: incorrect" << std::endl;
   }
 
+  grain_registry::instance().print(std::cout);
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_KERNELS_X86 1
+#endif
+
+// 显式向量化的块内归约内核 (sum / min / max / dot)
+// Debug(-O0) 下 std::accumulate 不会被自动向量化, 这里用 intrinsics 手写内核,
+// 每个内核使用4组独立累加器来隐藏加法延迟, 运行时通过 CPUID 选择 AVX-512 / AVX2
+// / 标量实现, 同一个二进制可以在不同机器上各自跑最快的路径
+// 注意: 浮点求和的结合顺序与 std::accumulate 不同, 结果可能有舍入误差;
+// min/max 不处理 NaN
+namespace simd {
+
+enum class isa { scalar, avx2, avx512 };
+
+enum class reduce_op { sum, min, max };
+
+template <typename T>
+inline constexpr bool is_vectorizable_v =
+    std::is_same_v<T, int> || std::is_same_v<T, float> ||
+    std::is_same_v<T, double>;
+
+// 只在第一次调用时执行 CPUID, 之后直接返回缓存的结果
+inline isa detect_isa() {
+  static const isa level = [] {
+#if defined(SIMD_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return isa::avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      return isa::avx2;
+    }
+#endif
+    return isa::scalar;
+  }();
+  return level;
+}
+
+inline const char* isa_name(isa level) {
+  switch (level) {
+    case isa::avx512:
+      return "avx512";
+    case isa::avx2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+namespace detail {
+
+template <reduce_op Op, typename T>
+inline T combine(T a, T b) {
+  if constexpr (Op == reduce_op::sum) {
+    return a + b;
+  } else if constexpr (Op == reduce_op::min) {
+    return b < a ? b : a;
+  } else {
+    return a < b ? b : a;
+  }
+}
+
+// 标量实现同样使用4个独立累加器, 打断循环携带的依赖链
+template <reduce_op Op, typename T>
+T reduce_scalar(const T* first, std::size_t n, T init) {
+  std::size_t i = 0;
+  if (n >= 4) {
+    T acc0 = Op == reduce_op::sum ? T() : first[0];
+    T acc1 = Op == reduce_op::sum ? T() : first[1];
+    T acc2 = Op == reduce_op::sum ? T() : first[2];
+    T acc3 = Op == reduce_op::sum ? T() : first[3];
+    i = Op == reduce_op::sum ? 0 : 4;
+    for (; i + 4 <= n; i += 4) {
+      acc0 = combine<Op>(acc0, first[i]);
+      acc1 = combine<Op>(acc1, first[i + 1]);
+      acc2 = combine<Op>(acc2, first[i + 2]);
+      acc3 = combine<Op>(acc3, first[i + 3]);
+    }
+    init = combine<Op>(init, combine<Op>(combine<Op>(acc0, acc1),
+                                         combine<Op>(acc2, acc3)));
+  }
+  for (; i < n; ++i) {
+    init = combine<Op>(init, first[i]);
+  }
+  return init;
+}
+
+template <typename T>
+T dot_scalar(const T* a, const T* b, std::size_t n, T init) {
+  T acc0 = T(), acc1 = T(), acc2 = T(), acc3 = T();
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    acc0 += a[i] * b[i];
+    acc1 += a[i + 1] * b[i + 1];
+    acc2 += a[i + 2] * b[i + 2];
+    acc3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < n; ++i) {
+    acc0 += a[i] * b[i];
+  }
+  return init + ((acc0 + acc1) + (acc2 + acc3));
+}
+
+#if defined(SIMD_KERNELS_X86)
+
+// -O0 下也要保证这些包装函数被内联, 否则每条指令都是一次函数调用
+#define SIMD_AVX2 __attribute__((target("avx2,fma"), always_inline)) inline
+#define SIMD_AVX512 __attribute__((target("avx512f"), always_inline)) inline
+
+template <typename T>
+struct avx2_vec;
+
+template <>
+struct avx2_vec<int> {
+  using reg = __m256i;
+  static constexpr std::size_t lanes = 8;
+  SIMD_AVX2 static reg zero() { return _mm256_setzero_si256(); }
+  SIMD_AVX2 static reg load(const int* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  SIMD_AVX2 static void store(int* p, reg v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  SIMD_AVX2 static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+  SIMD_AVX2 static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+  SIMD_AVX2 static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+  SIMD_AVX2 static reg fmadd(reg a, reg b, reg c) {
+    return _mm256_add_epi32(_mm256_mullo_epi32(a, b), c);
+  }
+};
+
+template <>
+struct avx2_vec<float> {
+  using reg = __m256;
+  static constexpr std::size_t lanes = 8;
+  SIMD_AVX2 static reg zero() { return _mm256_setzero_ps(); }
+  SIMD_AVX2 static reg load(const float* p) { return _mm256_loadu_ps(p); }
+  SIMD_AVX2 static void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+  SIMD_AVX2 static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+  SIMD_AVX2 static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+  SIMD_AVX2 static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+  SIMD_AVX2 static reg fmadd(reg a, reg b, reg c) {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+};
+
+template <>
+struct avx2_vec<double> {
+  using reg = __m256d;
+  static constexpr std::size_t lanes = 4;
+  SIMD_AVX2 static reg zero() { return _mm256_setzero_pd(); }
+  SIMD_AVX2 static reg load(const double* p) { return _mm256_loadu_pd(p); }
+  SIMD_AVX2 static void store(double* p, reg v) { _mm256_storeu_pd(p, v); }
+  SIMD_AVX2 static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+  SIMD_AVX2 static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+  SIMD_AVX2 static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+  SIMD_AVX2 static reg fmadd(reg a, reg b, reg c) {
+    return _mm256_fmadd_pd(a, b, c);
+  }
+};
+
+template <typename T>
+struct avx512_vec;
+
+template <>
+struct avx512_vec<int> {
+  using reg = __m512i;
+  static constexpr std::size_t lanes = 16;
+  SIMD_AVX512 static reg zero() { return _mm512_setzero_si512(); }
+  SIMD_AVX512 static reg load(const int* p) { return _mm512_loadu_si512(p); }
+  SIMD_AVX512 static void store(int* p, reg v) { _mm512_storeu_si512(p, v); }
+  SIMD_AVX512 static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+  SIMD_AVX512 static reg min(reg a, reg b) { return _mm512_min_epi32(a, b); }
+  SIMD_AVX512 static reg max(reg a, reg b) { return _mm512_max_epi32(a, b); }
+  SIMD_AVX512 static reg fmadd(reg a, reg b, reg c) {
+    return _mm512_add_epi32(_mm512_mullo_epi32(a, b), c);
+  }
+};
+
+template <>
+struct avx512_vec<float> {
+  using reg = __m512;
+  static constexpr std::size_t lanes = 16;
+  SIMD_AVX512 static reg zero() { return _mm512_setzero_ps(); }
+  SIMD_AVX512 static reg load(const float* p) { return _mm512_loadu_ps(p); }
+  SIMD_AVX512 static void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+  SIMD_AVX512 static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+  SIMD_AVX512 static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+  SIMD_AVX512 static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+  SIMD_AVX512 static reg fmadd(reg a, reg b, reg c) {
+    return _mm512_fmadd_ps(a, b, c);
+  }
+};
+
+template <>
+struct avx512_vec<double> {
+  using reg = __m512d;
+  static constexpr std::size_t lanes = 8;
+  SIMD_AVX512 static reg zero() { return _mm512_setzero_pd(); }
+  SIMD_AVX512 static reg load(const double* p) { return _mm512_loadu_pd(p); }
+  SIMD_AVX512 static void store(double* p, reg v) { _mm512_storeu_pd(p, v); }
+  SIMD_AVX512 static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+  SIMD_AVX512 static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+  SIMD_AVX512 static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+  SIMD_AVX512 static reg fmadd(reg a, reg b, reg c) {
+    return _mm512_fmadd_pd(a, b, c);
+  }
+};
+
+// 两套 ISA 的内核除了 target 属性外完全相同, 用宏展开避免手写两份
+// clang-format off
+#define SIMD_DEFINE_KERNELS(PREFIX, TARGET)                                    \
+  template <reduce_op Op, typename V>                                          \
+  TARGET typename V::reg PREFIX##_apply(typename V::reg a,                     \
+                                        typename V::reg b) {                   \
+    if constexpr (Op == reduce_op::sum) {                                      \
+      return V::add(a, b);                                                     \
+    } else if constexpr (Op == reduce_op::min) {                               \
+      return V::min(a, b);                                                     \
+    } else {                                                                   \
+      return V::max(a, b);                                                     \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  template <reduce_op Op, typename T>                                          \
+  __attribute__((target(TARGET##_ISA)))                                        \
+  T reduce_##PREFIX(const T* first, std::size_t n, T init) {                   \
+    using V = PREFIX##_vec<T>;                                                 \
+    constexpr std::size_t W = V::lanes;                                        \
+    std::size_t i = 0;                                                         \
+    if (n >= 4 * W) {                                                          \
+      typename V::reg acc0, acc1, acc2, acc3;                                  \
+      if constexpr (Op == reduce_op::sum) {                                    \
+        acc0 = acc1 = acc2 = acc3 = V::zero();                                 \
+      } else {                                                                 \
+        acc0 = V::load(first);                                                 \
+        acc1 = V::load(first + W);                                             \
+        acc2 = V::load(first + 2 * W);                                         \
+        acc3 = V::load(first + 3 * W);                                         \
+        i = 4 * W;                                                             \
+      }                                                                        \
+      for (; i + 4 * W <= n; i += 4 * W) {                                     \
+        acc0 = PREFIX##_apply<Op, V>(acc0, V::load(first + i));                \
+        acc1 = PREFIX##_apply<Op, V>(acc1, V::load(first + i + W));            \
+        acc2 = PREFIX##_apply<Op, V>(acc2, V::load(first + i + 2 * W));        \
+        acc3 = PREFIX##_apply<Op, V>(acc3, V::load(first + i + 3 * W));        \
+      }                                                                        \
+      acc0 = PREFIX##_apply<Op, V>(PREFIX##_apply<Op, V>(acc0, acc1),          \
+                                   PREFIX##_apply<Op, V>(acc2, acc3));         \
+      alignas(64) T lanes[W];                                                  \
+      V::store(lanes, acc0);                                                   \
+      for (std::size_t k = 0; k < W; ++k) {                                    \
+        init = combine<Op>(init, lanes[k]);                                    \
+      }                                                                        \
+    }                                                                          \
+    for (; i < n; ++i) {                                                       \
+      init = combine<Op>(init, first[i]);                                      \
+    }                                                                          \
+    return init;                                                               \
+  }                                                                            \
+                                                                               \
+  template <typename T>                                                        \
+  __attribute__((target(TARGET##_ISA)))                                        \
+  T dot_##PREFIX(const T* a, const T* b, std::size_t n, T init) {              \
+    using V = PREFIX##_vec<T>;                                                 \
+    constexpr std::size_t W = V::lanes;                                        \
+    typename V::reg acc0 = V::zero(), acc1 = V::zero(), acc2 = V::zero(),      \
+                    acc3 = V::zero();                                          \
+    std::size_t i = 0;                                                         \
+    for (; i + 4 * W <= n; i += 4 * W) {                                       \
+      acc0 = V::fmadd(V::load(a + i), V::load(b + i), acc0);                   \
+      acc1 = V::fmadd(V::load(a + i + W), V::load(b + i + W), acc1);           \
+      acc2 = V::fmadd(V::load(a + i + 2 * W), V::load(b + i + 2 * W), acc2);   \
+      acc3 = V::fmadd(V::load(a + i + 3 * W), V::load(b + i + 3 * W), acc3);   \
+    }                                                                          \
+    acc0 = V::add(V::add(acc0, acc1), V::add(acc2, acc3));                     \
+    alignas(64) T lanes[W];                                                    \
+    V::store(lanes, acc0);                                                     \
+    for (std::size_t k = 0; k < W; ++k) {                                      \
+      init += lanes[k];                                                        \
+    }                                                                          \
+    for (; i < n; ++i) {                                                       \
+      init += a[i] * b[i];                                                     \
+    }                                                                          \
+    return init;                                                               \
+  }
+// clang-format on
+
+#define SIMD_AVX2_ISA "avx2,fma"
+#define SIMD_AVX512_ISA "avx512f"
+
+SIMD_DEFINE_KERNELS(avx2, SIMD_AVX2)
+SIMD_DEFINE_KERNELS(avx512, SIMD_AVX512)
+
+#undef SIMD_DEFINE_KERNELS
+
+#endif  // SIMD_KERNELS_X86
+
+template <reduce_op Op, typename T>
+T reduce(const T* first, std::size_t n, T init, isa level) {
+#if defined(SIMD_KERNELS_X86)
+  switch (level) {
+    case isa::avx512:
+      return reduce_avx512<Op>(first, n, init);
+    case isa::avx2:
+      return reduce_avx2<Op>(first, n, init);
+    default:
+      break;
+  }
+#else
+  (void)level;
+#endif
+  return reduce_scalar<Op>(first, n, init);
+}
+
+}  // namespace detail
+
+// 以下接口默认使用 detect_isa() 选出的最优实现, 也可以显式指定 isa 做对比测试
+template <typename T>
+T sum(const T* first, std::size_t n, T init = T(), isa level = detect_isa()) {
+  static_assert(is_vectorizable_v<T>, "simd::sum supports int/float/double");
+  return detail::reduce<reduce_op::sum>(first, n, init, level);
+}
+
+// 调用方保证 n > 0
+template <typename T>
+T reduce_min(const T* first, std::size_t n, isa level = detect_isa()) {
+  static_assert(is_vectorizable_v<T>, "simd::min supports int/float/double");
+  return detail::reduce<reduce_op::min>(first + 1, n - 1, first[0], level);
+}
+
+template <typename T>
+T reduce_max(const T* first, std::size_t n, isa level = detect_isa()) {
+  static_assert(is_vectorizable_v<T>, "simd::max supports int/float/double");
+  return detail::reduce<reduce_op::max>(first + 1, n - 1, first[0], level);
+}
+
+template <typename T>
+T dot(const T* a, const T* b, std::size_t n, T init = T(),
+      isa level = detect_isa()) {
+  static_assert(is_vectorizable_v<T>, "simd::dot supports int/float/double");
+#if defined(SIMD_KERNELS_X86)
+  switch (level) {
+    case isa::avx512:
+      return detail::dot_avx512(a, b, n, init);
+    case isa::avx2:
+      return detail::dot_avx2(a, b, n, init);
+    default:
+      break;
+  }
+#else
+  (void)level;
+#endif
+  return detail::dot_scalar(a, b, n, init);
+}
+
+}  // namespace simd
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "node_pool.h"
+
+// 基于纪元(epoch)的内存回收
+// 全局有一个纪元计数. 线程访问共享节点之前进入临界区(enter), 在自己的记录
+// 里公布当前的全局纪元, 离开(leave)时撤销公布; 摘下的节点按摘下时的纪元
+// 放进线程自己的待回收(limbo)列表.
+// 只有临界区里的线程都已经公布了当前纪元 e, 全局纪元才能推进到 e + 1.
+// 全局纪元到达 e + 2 时, 纪元 e 摘下节点那一刻还在临界区里的线程都已经
+// 离开过, 之后进入的线程不可能再拿到这些节点, 可以删除
+//   - 每次操作只在进入临界区时写一次记录, 读指针没有额外开销;
+//     风险指针每读一个指针都要写一次槽位并等待写入全局可见
+//   - 代价是停在临界区里的线程(被挂起, 或者长时间不离开)会拖住纪元,
+//     所有线程的待回收列表都会一直增长. stalled_threads() 报告拖住纪元的
+//     线程数, pending() 报告还没回收的节点数; 长时间留在临界区里的线程
+//     应该在不持有任何节点的时候调用 quiescent_state() 公布新的纪元
+//   - 待回收列表由固定大小的块串成, 块来自节点池(见 node_pool.h), 释放后
+//     所有线程共用. 纪元被拖住时列表变长只会从池里多取块, 池子填满之后
+//     不再调用 malloc
+// 临界区可以嵌套, 只有最外层的 enter/leave 会修改公布的纪元
+class epoch_domain {
+ public:
+  // 每个线程摘下这么多节点后尝试推进纪元并回收一次
+  static constexpr unsigned scan_threshold = 64;
+
+  static epoch_domain& instance() {
+    static epoch_domain domain;
+    return domain;
+  }
+
+  epoch_domain(epoch_domain const&) = delete;
+  epoch_domain& operator=(epoch_domain const&) = delete;
+
+  // 所有线程都已经退出, 剩下的节点不会再被访问
+  ~epoch_domain() {
+    record* r = records_.load(std::memory_order_acquire);
+    while (r != nullptr) {
+      record* const next = r->next;
+      for (limbo_list& limbo : r->limbo) {
+        free_all(limbo);
+      }
+      delete r;
+      r = next;
+    }
+  }
+
+  void enter() {
+    record& r = local_record();
+    if (r.depth++ == 0) {
+      announce(r);
+    }
+  }
+
+  void leave() {
+    record& r = local_record();
+    if (--r.depth == 0) {
+      r.announced.store(r.announced.load(std::memory_order_relaxed) & ~1ull,
+                        std::memory_order_release);
+    }
+  }
+
+  // 调用者保证此时没有持有任何之前读到的节点. 在临界区里时重新公布最新的
+  // 纪元, 不再拖住纪元推进; 不在临界区里时只尝试回收
+  void quiescent_state() {
+    record& r = local_record();
+    if (r.depth != 0) {
+      announce(r);
+    }
+    try_advance();
+    reclaim(r);
+  }
+
+  // 节点已经从容器中摘下, 纪元推进两次之后用 delete 释放
+  template <typename T>
+  void retire(T* ptr) {
+    retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+  }
+
+  void retire(void* ptr, void (*deleter)(void*)) {
+    record& r = local_record();
+    std::uint64_t const e = global_.load(std::memory_order_acquire);
+    std::size_t const b = e % 3;
+    // 同一个桶里原来的节点至少早了 3 个纪元
+    if (r.limbo_epoch[b] != e) {
+      free_all(r.limbo[b]);
+      r.limbo_epoch[b] = e;
+    }
+    r.limbo[b].push({ptr, deleter});
+    update_pending(r);
+    if (++r.retired_since_scan >= scan_threshold) {
+      r.retired_since_scan = 0;
+      try_advance();
+      reclaim(r);
+    }
+  }
+
+  std::uint64_t epoch() const {
+    return global_.load(std::memory_order_relaxed);
+  }
+
+  // 在临界区里但还停在旧纪元的线程数, 不为 0 时纪元无法推进
+  unsigned stalled_threads() const {
+    std::uint64_t const g = global_.load(std::memory_order_seq_cst);
+    unsigned stalled = 0;
+    for (record* r = records_.load(std::memory_order_acquire); r != nullptr;
+         r = r->next) {
+      std::uint64_t const a = r->announced.load(std::memory_order_seq_cst);
+      if ((a & 1) != 0 && (a >> 1) != g) {
+        ++stalled;
+      }
+    }
+    return stalled;
+  }
+
+  // 所有线程已经摘下但还没有释放的节点数
+  std::size_t pending() const {
+    std::size_t total = 0;
+    for (record* r = records_.load(std::memory_order_acquire); r != nullptr;
+         r = r->next) {
+      total += r->pending.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+ private:
+  struct retired_node {
+    void* ptr;
+    void (*deleter)(void*);
+  };
+
+  struct limbo_block : pool_allocated<limbo_block> {
+    static constexpr std::size_t capacity = 63;
+    retired_node nodes[capacity];
+    std::size_t count = 0;
+    limbo_block* next = nullptr;
+  };
+
+  // 新的节点追加在第一块里, 第一块满了才从节点池取一块
+  struct limbo_list {
+    limbo_block* head = nullptr;
+    std::size_t size = 0;
+
+    void push(retired_node node) {
+      if (head == nullptr || head->count == limbo_block::capacity) {
+        limbo_block* const block = new limbo_block;
+        block->next = head;
+        head = block;
+      }
+      head->nodes[head->count++] = node;
+      ++size;
+    }
+  };
+
+  // 每条记录独占缓存行, 公布纪元不会干扰其他线程
+  struct alignas(64) record {
+    // (纪元 << 1) | 是否在临界区里
+    std::atomic<std::uint64_t> announced{0};
+    std::atomic<bool> active{true};
+    std::atomic<std::size_t> pending{0};
+    record* next = nullptr;
+    // 以下只由占用记录的线程访问
+    unsigned depth = 0;
+    unsigned retired_since_scan = 0;
+    // 三个桶轮流使用, 分别存放纪元 limbo_epoch[i] 摘下的节点
+    limbo_list limbo[3];
+    std::uint64_t limbo_epoch[3] = {};
+  };
+
+  // 线程第一次用到时占用一条记录, 退出时先尽量回收再归还,
+  // 剩下的节点留给之后占用这条记录的线程
+  struct thread_record {
+    record* r = nullptr;
+    ~thread_record() {
+      if (r != nullptr) {
+        epoch_domain& domain = instance();
+        r->depth = 0;
+        r->announced.store(0, std::memory_order_release);
+        domain.try_advance();
+        domain.try_advance();
+        domain.reclaim(*r);
+        r->active.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  epoch_domain() = default;
+
+  record& local_record() {
+    thread_local thread_record local;
+    if (local.r == nullptr) {
+      local.r = acquire_record();
+    }
+    return *local.r;
+  }
+
+  record* acquire_record() {
+    for (record* r = records_.load(std::memory_order_acquire); r != nullptr;
+         r = r->next) {
+      bool expected = false;
+      if (!r->active.load(std::memory_order_relaxed) &&
+          r->active.compare_exchange_strong(expected, true,
+                                            std::memory_order_acquire)) {
+        return r;
+      }
+    }
+    record* const r = new record;
+    r->next = records_.load(std::memory_order_relaxed);
+    while (!records_.compare_exchange_weak(r->next, r,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+    return r;
+  }
+
+  // 公布之后重新读一次全局纪元, 两次相同才说明公布的是当前纪元;
+  // 否则推进纪元的线程可能没有看到这次公布
+  void announce(record& r) {
+    std::uint64_t e = global_.load(std::memory_order_acquire);
+    for (;;) {
+      r.announced.store((e << 1) | 1, std::memory_order_seq_cst);
+      std::uint64_t const now = global_.load(std::memory_order_seq_cst);
+      if (now == e) {
+        return;
+      }
+      e = now;
+    }
+  }
+
+  // 临界区里的线程都已经公布了当前纪元时推进一次
+  void try_advance() {
+    std::uint64_t g = global_.load(std::memory_order_seq_cst);
+    for (record* r = records_.load(std::memory_order_acquire); r != nullptr;
+         r = r->next) {
+      std::uint64_t const a = r->announced.load(std::memory_order_seq_cst);
+      if ((a & 1) != 0 && (a >> 1) != g) {
+        return;
+      }
+    }
+    global_.compare_exchange_strong(g, g + 1, std::memory_order_seq_cst);
+  }
+
+  // 释放至少早了两个纪元的桶
+  void reclaim(record& r) {
+    std::uint64_t const g = global_.load(std::memory_order_acquire);
+    for (std::size_t b = 0; b < 3; ++b) {
+      if (r.limbo[b].size != 0 && r.limbo_epoch[b] + 2 <= g) {
+        free_all(r.limbo[b]);
+      }
+    }
+    update_pending(r);
+  }
+
+  static void free_all(limbo_list& limbo) {
+    while (limbo_block* const block = limbo.head) {
+      for (std::size_t i = 0; i < block->count; ++i) {
+        block->nodes[i].deleter(block->nodes[i].ptr);
+      }
+      limbo.head = block->next;
+      delete block;
+    }
+    limbo.size = 0;
+  }
+
+  static void update_pending(record& r) {
+    r.pending.store(r.limbo[0].size + r.limbo[1].size + r.limbo[2].size,
+                    std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint64_t> global_{0};
+  std::atomic<record*> records_{nullptr};
+};
+
+// 在作用域内处于临界区
+class epoch_guard {
+ public:
+  epoch_guard() { epoch_domain::instance().enter(); }
+  ~epoch_guard() { epoch_domain::instance().leave(); }
+  epoch_guard(epoch_guard const&) = delete;
+  epoch_guard& operator=(epoch_guard const&) = delete;
+};
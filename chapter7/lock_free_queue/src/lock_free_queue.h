@@ -1,33 +1,183 @@
+#pragma once
+
 #include <atomic>
 #include <memory>
+#include <utility>
 
-template <typename T>
+#include "node_pool.h"
+#include "reclaimer.h"
+#include "tagged_ptr.h"
+
+// 无锁队列, Reclaimer 决定出队的节点何时删除(见 reclaimer.h)
+// 节点从节点池分配(见 node_pool.h), 元素直接构造在节点里, 不再单独分配
+// (引用计数的特化把元素放在同样来自节点池的块里, 见下面):
+//   emplace(args...)  在节点里原地构造元素, push(value) 等价于
+//                     emplace(std::move(value))
+//   try_pop(T& value) 把队首元素移动赋值给 value 并销毁节点里的元素,
+//                     队列为空时返回 false. 只要求 T 可以移动, 支持只能
+//                     移动的类型
+//   pop()             同 try_pop, 但把元素移动到新分配的 unique_ptr 里
+// 交给调用者的处理(移动赋值或者分配 unique_ptr)抛出异常时, 元素已经出队,
+// 它被销毁, 异常继续传出.
+// 这是风险指针和纪元策略共用的实现(Michael-Scott 队列): head 指向哑节点,
+// 队首元素在哑节点的下一个节点里; 出队时 head 前移一个节点, 新的队首节点
+// 变成哑节点, 原来的哑节点交给 Reclaimer 回收. head/tail 是普通指针,
+// 读它们不用对共享的计数做 CAS, 也不需要 16 字节的原子操作.
+// split_reference_count 是下面的特化
+template <typename T, typename Reclaimer = split_reference_count>
 class lock_free_queue {
+ private:
+  // 哑节点(包括出队之后成为哑节点的节点)里没有元素, 析构时不销毁 value
+  struct node : pool_allocated<node> {
+    union {
+      T value;  // 入队时在链上之前构造
+    };
+    std::atomic<node*> next{nullptr};
+    node() {}
+    ~node() {}
+  };
+
+  std::atomic<node*> head_;
+  std::atomic<node*> tail_;
+
+  static_assert(std::atomic<node*>::is_always_lock_free);
+
+  // 取出队首元素交给 consume(T&&), 之后销毁它. 队列为空时返回 false
+  template <typename Consume>
+  bool dequeue(Consume&& consume) {
+    typename Reclaimer::guard guard;
+    for (;;) {
+      node* old_head = guard.protect(head_, 0);
+      node* const next = guard.protect(old_head->next, 1);
+      if (next == nullptr) {
+        return false;
+      }
+      // 保护 next 之后 head 没变, next 就还在队列里, 可以安全地访问
+      if (head_.load() != old_head) {
+        continue;
+      }
+      // tail 还指向哑节点时先把它移走, 否则 tail 会指向被回收的节点
+      node* old_tail = tail_.load();
+      if (old_tail == old_head) {
+        tail_.compare_exchange_strong(old_tail, next);
+        continue;
+      }
+      if (head_.compare_exchange_strong(old_head, next)) {
+        guard.reset(0);
+        Reclaimer::retire(old_head);
+        // next 成为新的哑节点, 它仍然受 guard 保护; 元素只有换掉 head 的
+        // 线程访问
+        try {
+          consume(std::move(next->value));
+        } catch (...) {
+          std::destroy_at(&next->value);
+          throw;
+        }
+        std::destroy_at(&next->value);
+        return true;
+      }
+    }
+  }
+
+ public:
+  lock_free_queue() {
+    node* const dummy = new node;
+    head_.store(dummy);
+    tail_.store(dummy);
+  }
+
+  lock_free_queue(lock_free_queue const&) = delete;
+  lock_free_queue& operator=(lock_free_queue const&) = delete;
+
+  ~lock_free_queue() {
+    while (dequeue([](T&&) {})) {
+    }
+    delete head_.load();
+  }
+
+  void push(T new_value) { emplace(std::move(new_value)); }
+
+  template <typename... Args>
+  void emplace(Args&&... args) {
+    node* const new_node = new node;
+    try {
+      std::construct_at(&new_node->value, std::forward<Args>(args)...);
+    } catch (...) {
+      delete new_node;
+      throw;
+    }
+    typename Reclaimer::guard guard;
+    for (;;) {
+      node* const old_tail = guard.protect(tail_, 0);
+      node* next = old_tail->next.load(std::memory_order_acquire);
+      if (next != nullptr) {
+        // tail 落后了, 帮前一个入队的线程把它移到最后
+        node* expected = old_tail;
+        tail_.compare_exchange_strong(expected, next);
+        continue;
+      }
+      if (old_tail->next.compare_exchange_strong(next, new_node)) {
+        node* expected = old_tail;
+        tail_.compare_exchange_strong(expected, new_node);
+        return;
+      }
+    }
+  }
+
+  bool try_pop(T& value) {
+    return dequeue([&](T&& front) { value = std::move(front); });
+  }
+
+  std::unique_ptr<T> pop() {
+    std::unique_ptr<T> result;
+    dequeue([&](T&& front) { result = std::make_unique<T>(std::move(front)); });
+    return result;
+  }
+};
+
+// 分离引用计数: head/tail 和前一个节点的 next 带有外部计数, 节点里是内部
+// 计数和外部计数器的个数, 全部归零时删除. 数据属于 tail 指向的节点:
+// 入队时先在一个单独的块(element, 同样来自节点池)里构造好元素, 再用一次
+// CAS 把节点的 data 从空改为这个块, 占用节点的同时发布元素, 然后链上一个
+// 新的空节点作为 tail. 占用之前构造抛出的异常不影响队列; head 与 tail
+// 不同时队首节点的元素一定已经发布, 出队不会因为某个入队线程被挂起而把
+// 非空的队列当作空队列.
+// 外部计数放在指针的标签里(见 tagged_ptr.h). 每个线程对同一个节点只持有
+// 一次外部计数, 出队发现队列为空时把它还回去, 计数不会超过同时访问这个
+// 节点的线程数
+template <typename T>
+class lock_free_queue<T, split_reference_count> {
  private:
   struct node;
-  struct counted_node_ptr {
-    int external_count;
-    node* ptr;
-  } __attribute__((aligned(16)));
+  using counted_node_ptr = tagged_ptr<node>;
 
   struct node_counter {
     unsigned internal_count : 30;
     unsigned external_counters : 2;
   } __attribute__((packed));
 
-  struct node {
-    std::atomic<T*> data;
+  struct element : pool_allocated<element> {
+    template <typename... Args>
+    explicit element(std::in_place_t, Args&&... args)
+        : value(std::forward<Args>(args)...) {}
+    T value;
+  };
+
+  // data 为空时节点还没被占用; 出队之后 data 保持不变(块已经删除), 还拿着
+  // 旧 tail 的入队线程看到它不为空, 不会占用已经出队的节点
+  struct node : pool_allocated<node> {
+    std::atomic<element*> data{nullptr};
     std::atomic<node_counter> count;
-    std::atomic<counted_node_ptr> next;
+    atomic_tagged_ptr<node> next;
     node() {
       node_counter new_count;
       new_count.internal_count = 0;
       new_count.external_counters = 2;
       count.store(new_count);
-      next.ptr = nullptr;
-      next.external_count = 0;
     }
 
+    // 计数的修改都是 acq_rel: 减到 0 的线程负责删除, 它必须看到其他线程
+    // 在释放引用之前对节点的所有访问
     void release_ref() {
       node_counter old_counter = count.load(std::memory_order_relaxed);
       node_counter new_counter;
@@ -35,7 +185,7 @@ class lock_free_queue {
         new_counter = old_counter;
         --new_counter.internal_count;
       } while (!count.compare_exchange_strong(old_counter, new_counter,
-                                              std::memory_order_acquire,
+                                              std::memory_order_acq_rel,
                                               std::memory_order_relaxed));
       if (!new_counter.internal_count && !new_counter.external_counters) {
         delete this;
@@ -43,37 +193,56 @@ class lock_free_queue {
     }
   };
 
-  std::atomic<counted_node_ptr> head_;
-  std::atomic<counted_node_ptr> tail_;
+  atomic_tagged_ptr<node> head_;
+  atomic_tagged_ptr<node> tail_;
+
+  static_assert(atomic_tagged_ptr<node>::is_always_lock_free,
+                "head_/tail_ would fall back to a lock-based atomic");
+  static_assert(std::atomic<node_counter>::is_always_lock_free);
 
   void set_new_tail(counted_node_ptr& old_tail,
                     const counted_node_ptr& new_tail) {
-    const node* current_tail_ptr = old_tail.ptr;
+    node* const current_tail_ptr = old_tail.ptr();
     while (!tail_.compare_exchange_weak(old_tail, new_tail) &&
-           old_tail.ptr == current_tail_ptr) {
-      if (old_tail.ptr == current_tail_ptr) {
-        free_external_counter(old_tail);
-      } else {
-        current_tail_ptr->release_ref();
-      }
+           old_tail.ptr() == current_tail_ptr) {
+    }
+    // 自己换掉了 tail 就释放外部计数, 否则别的线程已经换掉了, 只释放引用
+    if (old_tail.ptr() == current_tail_ptr) {
+      free_external_counter(old_tail);
+    } else {
+      current_tail_ptr->release_ref();
     }
   }
 
-  static void increase_external_count(std::atomic<counted_node_ptr>& counter,
+  static void increase_external_count(atomic_tagged_ptr<node>& counter,
                                       counted_node_ptr& old_counter) {
     counted_node_ptr new_counter;
     do {
-      new_counter = old_counter;
-      ++new_counter.external_count;
+      new_counter = counted_node_ptr(old_counter.ptr(), old_counter.tag() + 1);
     } while (!counter.compare_exchange_strong(old_counter, new_counter,
                                               std::memory_order_acquire,
                                               std::memory_order_relaxed));
-    old_counter.external_count = new_counter.external_count;
+    old_counter = new_counter;
+  }
+
+  // 归还 increase_external_count 拿到的引用: counter 还指向同一个节点时
+  // 直接减外部计数; 已经换成别的节点时外部计数转入了内部计数, 释放内部计数
+  static void decrease_external_count(atomic_tagged_ptr<node>& counter,
+                                      counted_node_ptr old_counter) {
+    node* const ptr = old_counter.ptr();
+    while (!counter.compare_exchange_weak(
+        old_counter, counted_node_ptr(ptr, old_counter.tag() - 1),
+        std::memory_order_release, std::memory_order_relaxed)) {
+      if (old_counter.ptr() != ptr) {
+        ptr->release_ref();
+        return;
+      }
+    }
   }
 
   static void free_external_counter(counted_node_ptr& old_counter_ptr) {
-    node* const ptr_to_delete = old_counter_ptr.ptr;
-    int const count_increase = old_counter_ptr.external_count - 2;
+    node* const ptr_to_delete = old_counter_ptr.ptr();
+    int const count_increase = static_cast<int>(old_counter_ptr.tag()) - 2;
     node_counter old_counter =
         ptr_to_delete->count.load(std::memory_order_relaxed);
     node_counter new_counter;
@@ -82,62 +251,112 @@ class lock_free_queue {
       --new_counter.external_counters;
       new_counter.internal_count += count_increase;
     } while (!ptr_to_delete->count.compare_exchange_strong(
-        old_counter, new_counter, std::memory_order_acquire,
+        old_counter, new_counter, std::memory_order_acq_rel,
         std::memory_order_relaxed));
     if (!new_counter.internal_count && !new_counter.external_counters) {
       delete ptr_to_delete;
     }
   }
 
- public:
-  void push(T new_value) {
-    std::unique_ptr<T> new_data(new T(new_value));
-    counted_node_ptr new_next;
-    new_next.ptr = new node;
-    new_next.external_count = 1;
+  // 占用 tail 指向的节点并发布 new_element; 返回之后块属于队列
+  void enqueue(element* new_element) {
+    counted_node_ptr new_next(new node, 1);
     counted_node_ptr old_tail = tail_.load();
     for (;;) {
       increase_external_count(tail_, old_tail);
-      T* old_data = nullptr;
-      if (old_tail.ptr->data.compare_exchange_strong(old_data,
-                                                     new_data.get())) {
-        counted_node_ptr old_next = {0};
-        if (!old_tail.ptr->next.compare_exchange_strong(old_next, new_next)) {
-          delete new_next.ptr;
+      node* const tail_ptr = old_tail.ptr();
+      element* old_data = nullptr;
+      if (tail_ptr->data.compare_exchange_strong(old_data, new_element)) {
+        counted_node_ptr old_next;
+        if (!tail_ptr->next.compare_exchange_strong(old_next, new_next)) {
+          delete new_next.ptr();
           new_next = old_next;
         }
         set_new_tail(old_tail, new_next);
-        new_data.release();
         break;
       } else {
-        counted_node_ptr old_next = {0};
-        if (old_tail.ptr->next.compare_exchange_strong(old_next, new_next)) {
+        // 别的线程占了这个节点但还没链上新节点, 帮它链上并移动 tail 后重试
+        counted_node_ptr old_next;
+        if (tail_ptr->next.compare_exchange_strong(old_next, new_next)) {
           old_next = new_next;
-          new_next.ptr = new node;
+          new_next = counted_node_ptr(new node, 1);
         }
-        set_new_tail(old_tail, new_next);
-        new_data.release();
-        break;
+        set_new_tail(old_tail, old_next);
       }
     }
   }
 
-  std::unique_ptr<T> pop() {
+  // 取出队首元素交给 consume(T&&), 之后销毁它. 队列为空时返回 false
+  template <typename Consume>
+  bool dequeue(Consume&& consume) {
     counted_node_ptr old_head = head_.load(std::memory_order_relaxed);
     for (;;) {
       increase_external_count(head_, old_head);
-      node* const old_head_ptr = old_head.ptr;
-      if (old_head_ptr == tail_.load().ptr) {
-        return std::unique_ptr<T>();
+      node* const old_head_ptr = old_head.ptr();
+      // head 与 tail 不同时节点的元素已经发布
+      if (old_head_ptr == tail_.load().ptr()) {
+        decrease_external_count(head_, old_head);
+        return false;
       }
       counted_node_ptr next =
           old_head_ptr->next.load(std::memory_order_relaxed);
-      if (head_.compare_exchange_strong(old_head, next)) {
-        T* const res = old_head_ptr->data.exchange(nullptr);
+      // CAS 失败但 head 还是这个节点时只是计数变了, 已经持有的引用仍然有效
+      bool popped;
+      do {
+        popped = head_.compare_exchange_strong(old_head, next);
+      } while (!popped && old_head.ptr() == old_head_ptr);
+      if (popped) {
+        // 只有换掉 head 的线程会取元素
+        element* const front = old_head_ptr->data.load();
+        try {
+          consume(std::move(front->value));
+        } catch (...) {
+          delete front;
+          free_external_counter(old_head);
+          throw;
+        }
+        delete front;
         free_external_counter(old_head);
-        return std::unique_ptr<T>(res);
+        return true;
       }
       old_head_ptr->release_ref();
     }
   }
-};
\ No newline at end of file
+
+ public:
+  // head 和 tail 指向同一个空的哑节点, 两个外部计数器各占一个
+  lock_free_queue() {
+    counted_node_ptr const dummy(new node, 1);
+    head_.store(dummy);
+    tail_.store(dummy);
+  }
+
+  lock_free_queue(lock_free_queue const&) = delete;
+  lock_free_queue& operator=(lock_free_queue const&) = delete;
+
+  ~lock_free_queue() {
+    while (dequeue([](T&&) {})) {
+    }
+    delete head_.load().ptr();
+  }
+
+  void push(T new_value) { emplace(std::move(new_value)); }
+
+  template <typename... Args>
+  void emplace(Args&&... args) {
+    std::unique_ptr<element> new_element(
+        new element(std::in_place, std::forward<Args>(args)...));
+    enqueue(new_element.get());
+    new_element.release();
+  }
+
+  bool try_pop(T& value) {
+    return dequeue([&](T&& front) { value = std::move(front); });
+  }
+
+  std::unique_ptr<T> pop() {
+    std::unique_ptr<T> result;
+    dequeue([&](T&& front) { result = std::make_unique<T>(std::move(front)); });
+    return result;
+  }
+};
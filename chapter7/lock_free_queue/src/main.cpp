@@ -2,19 +2,24 @@
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <set>
 #include <thread>
 #include <vector>
 
+#include "faa_queue.h"
 #include "lock_free_queue.h"
+#include "reclaimer.h"
 
 // 基本功能测试
-void test_basic_operations() {
-  std::cout << "=== 基本功能测试 ===" << std::endl;
+template <typename Queue>
+void test_basic_operations(char const* name) {
+  std::cout << "=== 基本功能测试: " << name << " ===" << std::endl;
 
-  lock_free_queue<int> queue;
+  Queue queue;
 
   // 测试空队列 pop
   auto empty_result = queue.pop();
@@ -86,10 +91,11 @@ void test_single_producer_single_consumer() {
 }
 
 // 多生产者多消费者测试
-void test_multiple_producers_consumers() {
-  std::cout << "=== 多生产者多消费者测试 ===" << std::endl;
+template <typename Queue>
+void test_multiple_producers_consumers(char const* name) {
+  std::cout << "=== 多生产者多消费者测试: " << name << " ===" << std::endl;
 
-  lock_free_queue<int> queue;
+  Queue queue;
   const int num_producers = 4;
   const int num_consumers = 3;
   const int items_per_producer = 2500;
@@ -298,6 +304,349 @@ void test_custom_type() {
   std::cout << "✓ 自定义类型测试通过" << std::endl;
 }
 
+// 只能移动的元素: emplace 原地构造, try_pop 移动出来
+template <typename Queue>
+void test_move_only(char const* name) {
+  std::cout << "=== 只能移动的元素: " << name << " ===" << std::endl;
+
+  Queue queue;
+  std::unique_ptr<int> value;
+  assert(!queue.try_pop(value));
+  for (int i = 0; i < 100; ++i) {
+    queue.emplace(std::make_unique<int>(i));
+  }
+  for (int i = 0; i < 100; ++i) {
+    assert(queue.try_pop(value) && value != nullptr && *value == i);
+  }
+  assert(!queue.try_pop(value));
+  std::cout << "✓ emplace / try_pop 的 FIFO 顺序正确" << std::endl;
+
+  // 多个生产者和消费者, 每个值恰好取到一次
+  const int producers = 4;
+  const int per_producer = 5000;
+  std::vector<std::atomic<int>> seen(producers * per_producer);
+  std::atomic<int> consumed(0);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i < per_producer; ++i) {
+        queue.emplace(std::make_unique<int>(p * per_producer + i));
+      }
+    });
+  }
+  for (int c = 0; c < producers; ++c) {
+    threads.emplace_back([&] {
+      std::unique_ptr<int> item;
+      while (consumed.load() < producers * per_producer) {
+        if (queue.try_pop(item)) {
+          seen[*item].fetch_add(1);
+          ++consumed;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto const& count : seen) {
+    assert(count.load() == 1);
+  }
+  std::cout << "✓ 多生产者多消费者下每个元素恰好取出一次" << std::endl;
+}
+
+// 统计存活的对象个数
+struct Tracked {
+  static inline std::atomic<int> alive{0};
+  int value;
+
+  explicit Tracked(int v) : value(v) { ++alive; }
+  Tracked(Tracked&& other) noexcept : value(other.value) { ++alive; }
+  Tracked& operator=(Tracked&&) = default;
+  ~Tracked() { --alive; }
+};
+
+// 出队的元素和队列析构时剩下的元素都被销毁, 没有多余的对象
+template <typename Queue>
+void test_element_lifetime(char const* name) {
+  std::cout << "=== 元素的生命周期: " << name << " ===" << std::endl;
+  {
+    Queue queue;
+    for (int i = 0; i < 1000; ++i) {
+      queue.emplace(i);
+    }
+    assert(Tracked::alive.load() == 1000);
+    Tracked out(-1);
+    for (int i = 0; i < 500; ++i) {
+      assert(queue.try_pop(out) && out.value == i);
+    }
+    assert(Tracked::alive.load() == 501);
+  }
+  assert(Tracked::alive.load() == 0);
+  std::cout << "✓ 出队和析构时元素都被销毁" << std::endl;
+}
+
+// 预先放入 items 个元素, threads 个线程同时 pop 直到队列为空
+// 返回每秒成功的 pop 次数, popped 返回实际取出的元素个数
+template <typename Queue>
+double pop_throughput(int threads, int items, long long& popped) {
+  Queue queue;
+  for (int i = 0; i < items; ++i) {
+    queue.push(i);
+  }
+  std::atomic<long long> count{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&queue, &count, &go]() {
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      long long local = 0;
+      while (queue.pop() != nullptr) {
+        local++;
+      }
+      count.fetch_add(local);
+    });
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  go.store(true);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      end_time - start_time);
+
+  popped = count.load();
+  return popped * 1000000.0 / std::max<long long>(duration.count(), 1);
+}
+
+// 队列里预先有 prefill 个元素, threads 个线程共执行 total_ops 次操作,
+// 其中 push_percent% 是 push, 其余是 pop. 返回每秒的操作数,
+// balanced 返回元素个数是否守恒
+template <typename Queue>
+double mixed_throughput(int threads, int total_ops, int push_percent,
+                        int prefill, bool& balanced) {
+  Queue queue;
+  for (int i = 0; i < prefill; ++i) {
+    queue.push(i);
+  }
+  std::atomic<long long> pushes{0};
+  std::atomic<long long> pops{0};
+  std::atomic<bool> go{false};
+  int const ops_per_thread = total_ops / threads;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&queue, &pushes, &pops, &go, push_percent,
+                          ops_per_thread, t]() {
+      std::mt19937 gen(t);
+      std::uniform_int_distribution<> dis(0, 99);
+      long long local_pushes = 0;
+      long long local_pops = 0;
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < ops_per_thread; ++i) {
+        if (dis(gen) < push_percent) {
+          queue.push(i);
+          local_pushes++;
+        } else if (queue.pop() != nullptr) {
+          local_pops++;
+        }
+      }
+      pushes.fetch_add(local_pushes);
+      pops.fetch_add(local_pops);
+    });
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  go.store(true);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      end_time - start_time);
+
+  long long remaining = 0;
+  while (queue.pop() != nullptr) {
+    remaining++;
+  }
+  balanced = prefill + pushes.load() - pops.load() == remaining;
+  return static_cast<double>(ops_per_thread) * threads * 1000000.0 /
+         std::max<long long>(duration.count(), 1);
+}
+
+// 三种回收策略的吞吐量: 分离引用计数, 风险指针, 纪元
+void test_reclaimer_throughput() {
+  std::cout << "=== 回收策略对比(引用计数 / 风险指针 / 纪元) ===" << std::endl;
+  const int items = 200000;
+  const int mixed_ops = 256000;
+
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << "  竞争下的 pop(预先放入 " << items << " 个元素), 操作/秒:"
+            << std::endl;
+  for (int threads : {1, 2, 4, 8, 16}) {
+    long long counted_popped = 0;
+    long long hazard_popped = 0;
+    long long epoch_popped = 0;
+    double counted = pop_throughput<lock_free_queue<int>>(threads, items,
+                                                          counted_popped);
+    double hazard =
+        pop_throughput<lock_free_queue<int, hazard_pointer_reclaimer>>(
+            threads, items, hazard_popped);
+    double epoch = pop_throughput<lock_free_queue<int, epoch_reclaimer>>(
+        threads, items, epoch_popped);
+    assert(counted_popped == items && hazard_popped == items &&
+           epoch_popped == items);
+    std::cout << "    线程数 " << threads << ": 引用计数 " << counted
+              << ", 风险指针 " << hazard << ", 纪元 " << epoch << std::endl;
+  }
+
+  // 50% push 时队列一直很短; 20% push 时预先放入一批, 大部分 pop 都能成功
+  for (int push_percent : {50, 20}) {
+    std::cout << "  " << push_percent << "% push / " << 100 - push_percent
+              << "% pop, 共 " << mixed_ops << " 次操作, 操作/秒:" << std::endl;
+    int const prefill = push_percent == 50 ? 0 : mixed_ops;
+    for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+      bool counted_ok = false;
+      bool hazard_ok = false;
+      bool epoch_ok = false;
+      double counted = mixed_throughput<lock_free_queue<int>>(
+          threads, mixed_ops, push_percent, prefill, counted_ok);
+      double hazard =
+          mixed_throughput<lock_free_queue<int, hazard_pointer_reclaimer>>(
+              threads, mixed_ops, push_percent, prefill, hazard_ok);
+      double epoch = mixed_throughput<lock_free_queue<int, epoch_reclaimer>>(
+          threads, mixed_ops, push_percent, prefill, epoch_ok);
+      assert(counted_ok && hazard_ok && epoch_ok);
+      std::cout << "    线程数 " << threads << ": 引用计数 " << counted
+                << ", 风险指针 " << hazard << ", 纪元 " << epoch << std::endl;
+    }
+  }
+  std::cout.unsetf(std::ios::fixed);
+  std::cout << "✓ 回收策略对比完成" << std::endl;
+}
+
+// 元素个数跨越多个段: 每个生产者的元素按顺序出队, 取空的段被回收复用
+template <typename Queue>
+void test_segment_crossing(char const* name) {
+  std::cout << "=== 跨段的 FIFO 顺序: " << name << " ===" << std::endl;
+
+  Queue queue;
+  int const segments = 8;
+  int const items = static_cast<int>(Queue::segment_size) * segments + 7;
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < items; ++i) {
+      queue.push(i);
+    }
+    int value = -1;
+    for (int i = 0; i < items; ++i) {
+      assert(queue.try_pop(value) && value == i);
+    }
+    assert(!queue.try_pop(value));
+  }
+  std::cout << "✓ 单线程跨 " << segments << " 个段的顺序正确" << std::endl;
+
+  // 每个生产者自己的元素必须按 push 的顺序被取出
+  int const producers = 4;
+  int const consumers = 4;
+  int const per_producer = items;
+  std::atomic<int> consumed{0};
+  std::atomic<bool> ordered{true};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i < per_producer; ++i) {
+        queue.push(p * per_producer + i);
+      }
+    });
+  }
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&] {
+      std::vector<int> last(producers, -1);
+      int item = 0;
+      while (consumed.load() < producers * per_producer) {
+        if (!queue.try_pop(item)) {
+          std::this_thread::yield();
+          continue;
+        }
+        int const p = item / per_producer;
+        if (item % per_producer <= last[p]) {
+          ordered.store(false);
+        }
+        last[p] = item % per_producer;
+        ++consumed;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  assert(ordered.load());
+  std::cout << "✓ 多生产者多消费者下每个生产者的元素保持顺序" << std::endl;
+}
+
+// CAS 循环的 lock_free_queue 与 fetch_add 领取槽位的 faa_queue,
+// 两者都用风险指针和纪元回收. 括号里是相对单线程的倍数
+void test_faa_queue_throughput() {
+  std::cout << "=== CAS 循环 / fetch_add 队列对比 ===" << std::endl;
+  const int mixed_ops = 256000;
+  bool correct = true;
+
+  using hazard_queue = lock_free_queue<int, hazard_pointer_reclaimer>;
+  using hazard_faa = faa_queue<int, hazard_pointer_reclaimer>;
+  using epoch_queue = lock_free_queue<int, epoch_reclaimer>;
+  using epoch_faa = faa_queue<int, epoch_reclaimer>;
+
+  for (int push_percent : {50, 20}) {
+    std::cout << "  " << push_percent << "% push / " << 100 - push_percent
+              << "% pop, 共 " << mixed_ops << " 次操作, 操作/秒:" << std::endl;
+    int const prefill = push_percent == 50 ? 0 : mixed_ops;
+    double base[4] = {};
+    std::cout << std::fixed;
+    for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+      bool ok[4] = {};
+      double const rates[4] = {
+          mixed_throughput<hazard_queue>(threads, mixed_ops, push_percent,
+                                         prefill, ok[0]),
+          mixed_throughput<hazard_faa>(threads, mixed_ops, push_percent,
+                                       prefill, ok[1]),
+          mixed_throughput<epoch_queue>(threads, mixed_ops, push_percent,
+                                        prefill, ok[2]),
+          mixed_throughput<epoch_faa>(threads, mixed_ops, push_percent,
+                                      prefill, ok[3]),
+      };
+      for (int i = 0; i < 4; ++i) {
+        correct = correct && ok[i];
+        if (threads == 1) {
+          base[i] = rates[i];
+        }
+      }
+      auto report = [&](int i) {
+        std::cout << std::setprecision(0) << rates[i] << " (x"
+                  << std::setprecision(2) << rates[i] / base[i] << ")";
+      };
+      std::cout << "    线程数 " << threads << ": 风险指针 CAS ";
+      report(0);
+      std::cout << ", fetch_add ";
+      report(1);
+      std::cout << "; 纪元 CAS ";
+      report(2);
+      std::cout << ", fetch_add ";
+      report(3);
+      std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+  }
+  assert(correct);
+  std::cout << "✓ 队列对比完成, 元素个数守恒" << std::endl;
+}
+
 int main() {
   std::cout << "开始 lock_free_queue 测试..." << std::endl;
   std::cout << "硬件并发数: " << std::thread::hardware_concurrency()
@@ -305,13 +654,20 @@ int main() {
   std::cout << std::endl;
 
   try {
-    test_basic_operations();
+    test_basic_operations<lock_free_queue<int>>("引用计数");
+    test_basic_operations<lock_free_queue<int, hazard_pointer_reclaimer>>(
+        "风险指针");
+    test_basic_operations<lock_free_queue<int, epoch_reclaimer>>("纪元");
     std::cout << std::endl;
 
     test_single_producer_single_consumer();
     std::cout << std::endl;
 
-    test_multiple_producers_consumers();
+    test_multiple_producers_consumers<lock_free_queue<int>>("引用计数");
+    test_multiple_producers_consumers<
+        lock_free_queue<int, hazard_pointer_reclaimer>>("风险指针");
+    test_multiple_producers_consumers<lock_free_queue<int, epoch_reclaimer>>(
+        "纪元");
     std::cout << std::endl;
 
     test_stress();
@@ -323,6 +679,32 @@ int main() {
     test_custom_type();
     std::cout << std::endl;
 
+    test_move_only<lock_free_queue<std::unique_ptr<int>>>("引用计数");
+    test_move_only<
+        lock_free_queue<std::unique_ptr<int>, hazard_pointer_reclaimer>>(
+        "风险指针");
+    test_move_only<lock_free_queue<std::unique_ptr<int>, epoch_reclaimer>>(
+        "纪元");
+    test_element_lifetime<lock_free_queue<Tracked>>("引用计数");
+    test_element_lifetime<lock_free_queue<Tracked, hazard_pointer_reclaimer>>(
+        "风险指针");
+    test_element_lifetime<lock_free_queue<Tracked, epoch_reclaimer>>("纪元");
+    std::cout << std::endl;
+
+    test_basic_operations<faa_queue<int>>("fetch_add 队列");
+    test_multiple_producers_consumers<faa_queue<int>>("fetch_add 队列");
+    test_segment_crossing<faa_queue<int>>("风险指针");
+    test_segment_crossing<faa_queue<int, epoch_reclaimer>>("纪元");
+    test_move_only<faa_queue<std::unique_ptr<int>>>("fetch_add 队列");
+    test_element_lifetime<faa_queue<Tracked>>("fetch_add 队列");
+    std::cout << std::endl;
+
+    test_reclaimer_throughput();
+    std::cout << std::endl;
+
+    test_faa_queue_throughput();
+    std::cout << std::endl;
+
     std::cout << "🎉 所有测试通过！lock_free_queue 工作正常。" << std::endl;
 
   } catch (const std::exception& e) {
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "tagged_ptr.h"
+
+// 消除数组(elimination backoff): push 和 pop 的效果正好相互抵消, 竞争
+// head 失败之后, 一对 push/pop 可以在数组里随机的一个槽位上直接交接
+// 节点, 不再访问 head. 线程越多, 同时失败的 push/pop 越多, 相遇的机会
+// 也越多, 争用从一个 head 分散到多个槽位上
+//   - push 把自己的节点放进一个空槽位, 等待 wait_rounds 轮; 期间节点被
+//     pop 取走就完成了, 否则撤回节点回到 head 上重试
+//   - pop 只看一个槽位, 里面有节点就取走, 不等待
+// 取走的节点从来没有进过栈, 其他线程拿不到它, pop 可以直接删除.
+// 槽位是带标签的指针, 每次放入节点标签加 1: 节点被取走、释放之后同一个
+// 地址又被放回同一个槽位时, 原来的 push 撤回不会误拿别人的节点
+template <typename Node, bool Enabled = true>
+class elimination_array {
+ public:
+  static constexpr unsigned max_slots = 16;
+  static constexpr unsigned wait_rounds = 16;
+
+  elimination_array()
+      : slots_used_(std::clamp(std::thread::hardware_concurrency() / 2, 1u,
+                               max_slots)) {}
+
+  elimination_array(elimination_array const&) = delete;
+  elimination_array& operator=(elimination_array const&) = delete;
+
+  // 节点被某个 pop 取走时返回 true, 之后不能再访问 node
+  bool try_push(Node* node) {
+    atomic_tagged_ptr<Node>& slot = random_slot();
+    tagged_ptr<Node> current = slot.load(std::memory_order_relaxed);
+    if (current.ptr() != nullptr) {
+      return false;
+    }
+    tagged_ptr<Node> const offer(node, current.tag() + 1);
+    if (!slot.compare_exchange_strong(current, offer,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    for (unsigned round = 0; round < wait_rounds; ++round) {
+      if (!(slot.load(std::memory_order_relaxed) == offer)) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+    tagged_ptr<Node> expected = offer;
+    return !slot.compare_exchange_strong(
+        expected, tagged_ptr<Node>(nullptr, offer.tag()),
+        std::memory_order_relaxed, std::memory_order_relaxed);
+  }
+
+  // 取走一个等待中的 push 的节点, 没有时返回 nullptr
+  Node* try_pop() {
+    atomic_tagged_ptr<Node>& slot = random_slot();
+    tagged_ptr<Node> current = slot.load(std::memory_order_relaxed);
+    if (current.ptr() == nullptr ||
+        !slot.compare_exchange_strong(
+            current, tagged_ptr<Node>(nullptr, current.tag()),
+            std::memory_order_acquire, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return current.ptr();
+  }
+
+ private:
+  // 每个槽位独占缓存行
+  struct alignas(64) slot {
+    atomic_tagged_ptr<Node> value;
+  };
+
+  atomic_tagged_ptr<Node>& random_slot() {
+    // xorshift, 每个线程一个状态
+    thread_local std::uint32_t state =
+        static_cast<std::uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id())) |
+        1u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return slots_[state % slots_used_].value;
+  }
+
+  unsigned const slots_used_;  // 只用前面这么多个槽位, 随核数变化
+  slot slots_[max_slots];
+};
+
+// 不使用消除数组时不占空间
+template <typename Node>
+class elimination_array<Node, false> {};
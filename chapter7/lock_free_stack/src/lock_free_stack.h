@@ -1,48 +1,317 @@
+#pragma once
+
 #include <atomic>
+#include <cstddef>
+#include <iterator>
 #include <memory>
+#include <utility>
+
+#include "elimination_array.h"
+#include "node_pool.h"
+#include "reclaimer.h"
+#include "tagged_ptr.h"
+
+// 无锁栈, Reclaimer 决定摘下的节点何时删除(见 reclaimer.h)
+// 节点和 shared_ptr 的数据块都从节点池分配(见 node_pool.h), 稳定状态下
+// push/pop 不调用 malloc.
+// Elimination 为 true 时, CAS head 失败的 push/pop 先尝试在消除数组里
+// 直接交接节点(见 elimination_array.h), 大量线程混合 push/pop 时吞吐量
+// 不会因为争用同一个 head 而下降
+// 这是风险指针和纪元策略共用的实现: head 是普通指针, pop 先通过 guard
+// 保护 head 指向的节点再读它的 next. 被保护的节点不会被释放, 也就不会被
+// 重新分配后再次出现在栈顶, CAS 不会遇到 ABA 问题.
+// split_reference_count 是下面的特化.
+// push_range 在本地把一批节点链好, 一次 CAS 接到栈顶; pop_all 一次摘下
+// 整个栈, 返回的 batch 在本地遍历, 适合批量生产、一次取走全部的场景
+
+// batch 的前向迭代器, 从栈顶开始, 解引用得到节点里的 shared_ptr<T>
+template <typename Node, typename T>
+class stack_batch_iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::shared_ptr<T>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = std::shared_ptr<T>*;
+  using reference = std::shared_ptr<T>&;
+
+  stack_batch_iterator() = default;
+  explicit stack_batch_iterator(Node* node) : node_(node) {}
+
+  reference operator*() const { return node_->data; }
+  pointer operator->() const { return &node_->data; }
+
+  stack_batch_iterator& operator++() {
+    node_ = node_->next_node();
+    return *this;
+  }
+  stack_batch_iterator operator++(int) {
+    stack_batch_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  bool operator==(stack_batch_iterator const&) const = default;
+
+ private:
+  Node* node_ = nullptr;
+};
 
-template <typename T>
+template <typename T, typename Reclaimer = split_reference_count,
+          bool Elimination = false>
 class lock_free_stack {
+ private:
+  struct node : pool_allocated<node> {
+    std::shared_ptr<T> data;
+    node* next;
+    node(T const& data_)
+        : data(std::allocate_shared<T>(pool_allocator<T>(), data_)),
+          next(nullptr) {}
+    node* next_node() const { return next; }
+  };
+  std::atomic<node*> head_{nullptr};
+  [[no_unique_address]] elimination_array<node, Elimination> elimination_;
+
+  static_assert(std::atomic<node*>::is_always_lock_free);
+
+  // 从消除数组取到的节点没有进过栈, 直接删除
+  static std::shared_ptr<T> take_eliminated(node* n) {
+    std::shared_ptr<T> result;
+    result.swap(n->data);
+    delete n;
+    return result;
+  }
+
+  // 还没有发布出去的一串节点
+  static void delete_chain(node* top) {
+    while (top != nullptr) {
+      node* const next = top->next;
+      delete top;
+      top = next;
+    }
+  }
+
+ public:
+  // pop_all 摘下的节点, 析构时交给 Reclaimer: 别的线程可能还在读它们的
+  // next. 节点里的数据只有持有 batch 的线程访问
+  class batch {
+   public:
+    using iterator = stack_batch_iterator<node, T>;
+
+    batch(batch&& other) noexcept
+        : head_(std::exchange(other.head_, nullptr)) {}
+    batch& operator=(batch&&) = delete;
+
+    ~batch() {
+      while (head_ != nullptr) {
+        node* const next = head_->next;
+        head_->data.reset();
+        Reclaimer::retire(head_);
+        head_ = next;
+      }
+    }
+
+    iterator begin() const { return iterator(head_); }
+    iterator end() const { return iterator(); }
+    bool empty() const { return head_ == nullptr; }
+
+   private:
+    friend class lock_free_stack;
+    explicit batch(node* head) : head_(head) {}
+
+    node* head_;
+  };
+
+  lock_free_stack() = default;
+  lock_free_stack(lock_free_stack const&) = delete;
+  lock_free_stack& operator=(lock_free_stack const&) = delete;
+
+  ~lock_free_stack() {
+    while (pop()) {
+    }
+  }
+
+  void push(T const& data) {
+    node* const new_node = new node(data);
+    new_node->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(new_node->next, new_node,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+      if constexpr (Elimination) {
+        if (elimination_.try_push(new_node)) {
+          return;
+        }
+      }
+    }
+  }
+
+  std::shared_ptr<T> pop() {
+    typename Reclaimer::guard guard;
+    node* old_head;
+    for (;;) {
+      old_head = guard.protect(head_, 0);
+      if (old_head == nullptr) {
+        return std::shared_ptr<T>();
+      }
+      if (head_.compare_exchange_strong(old_head, old_head->next)) {
+        break;
+      }
+      if constexpr (Elimination) {
+        if (node* const n = elimination_.try_pop()) {
+          return take_eliminated(n);
+        }
+      }
+    }
+    guard.reset(0);
+    // 其他线程最多还在读 next, data 只有摘下节点的线程会访问
+    std::shared_ptr<T> result;
+    result.swap(old_head->data);
+    Reclaimer::retire(old_head);
+    return result;
+  }
+
+  // 依次压入 [first, last), 结果与逐个 push 相同(最后一个元素在栈顶)
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    if (first == last) {
+      return;
+    }
+    node* const bottom = new node(*first);
+    node* top = bottom;
+    try {
+      for (++first; first != last; ++first) {
+        node* const new_node = new node(*first);
+        new_node->next = top;
+        top = new_node;
+      }
+    } catch (...) {
+      delete_chain(top);
+      throw;
+    }
+    bottom->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(bottom->next, top,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  // 摘下整个栈, 栈空时不写 head
+  batch pop_all() {
+    if (head_.load(std::memory_order_relaxed) == nullptr) {
+      return batch(nullptr);
+    }
+    return batch(head_.exchange(nullptr, std::memory_order_acquire));
+  }
+};
+
+// 分离引用计数: head 带有外部计数, 节点里是内部计数, 两者之和为 0 时删除
+// 外部计数放在 head 的标签里(见 tagged_ptr.h). 每个线程对同一个节点只增加
+// 一次外部计数, 它不会超过同时访问这个节点的线程数
+template <typename T, bool Elimination>
+class lock_free_stack<T, split_reference_count, Elimination> {
  private:
   struct node;
-  struct counted_node_ptr {
-    int external_count;
-    node* ptr;
-  } __attribute__((aligned(16)));
-  struct node {
+  using counted_node_ptr = tagged_ptr<node>;
+  struct node : pool_allocated<node> {
     std::shared_ptr<T> data;
     std::atomic<int> internal_count;
     counted_node_ptr next;
     node(T const& data_)
-        : data(std::make_shared<T>(data_)), internal_count(0) {}
+        : data(std::allocate_shared<T>(pool_allocator<T>(), data_)),
+          internal_count(0) {}
+    node* next_node() const { return next.ptr(); }
   };
-  std::atomic<counted_node_ptr> head_;
+  atomic_tagged_ptr<node> head_;
+  [[no_unique_address]] elimination_array<node, Elimination> elimination_;
+
+  static_assert(atomic_tagged_ptr<node>::is_always_lock_free,
+                "head_ would fall back to a lock-based atomic");
+  static_assert(std::atomic<int>::is_always_lock_free);
+
+  // 从消除数组取到的节点没有进过栈, 也没有别的线程持有引用, 直接删除
+  static std::shared_ptr<T> take_eliminated(node* n) {
+    std::shared_ptr<T> result;
+    result.swap(n->data);
+    delete n;
+    return result;
+  }
+
+  // 还没有发布出去的一串节点
+  static void delete_chain(node* top) {
+    while (top != nullptr) {
+      node* const next = top->next.ptr();
+      delete top;
+      top = next;
+    }
+  }
 
   void increase_head_count(counted_node_ptr& old_counter) {
     counted_node_ptr new_counter;
     do {
-      new_counter = old_counter;
-      ++new_counter.external_count;
+      new_counter = counted_node_ptr(old_counter.ptr(), old_counter.tag() + 1);
     } while (!head_.compare_exchange_strong(old_counter, new_counter,
                                             std::memory_order_acquire,
                                             std::memory_order_relaxed));
-    old_counter.external_count = new_counter.external_count;
+    old_counter = new_counter;
   }
 
  public:
+  lock_free_stack() = default;
+  lock_free_stack(lock_free_stack const&) = delete;
+  lock_free_stack& operator=(lock_free_stack const&) = delete;
+
+  // pop_all 摘下的节点. 摘下时 head 或上一个节点的 next 里的外部计数
+  // 包含了当时正在访问这个节点的线程, 它们还会释放各自的引用; batch 析构
+  // 时像 pop 一样把外部计数转入内部计数, 最后一个释放引用的线程删除节点
+  class batch {
+   public:
+    using iterator = stack_batch_iterator<node, T>;
+
+    batch(batch&& other) noexcept
+        : head_(std::exchange(other.head_, counted_node_ptr())) {}
+    batch& operator=(batch&&) = delete;
+
+    ~batch() {
+      while (node* const ptr = head_.ptr()) {
+        counted_node_ptr const next = ptr->next;
+        ptr->data.reset();
+        // 摘下的线程没有增加过外部计数, 只减去链表本身的一个
+        int const count_increase = static_cast<int>(head_.tag()) - 1;
+        if (ptr->internal_count.fetch_add(count_increase,
+                                          std::memory_order_acq_rel) ==
+            -count_increase) {
+          delete ptr;
+        }
+        head_ = next;
+      }
+    }
+
+    iterator begin() const { return iterator(head_.ptr()); }
+    iterator end() const { return iterator(); }
+    bool empty() const { return head_.ptr() == nullptr; }
+
+   private:
+    friend class lock_free_stack;
+    explicit batch(counted_node_ptr head) : head_(head) {}
+
+    counted_node_ptr head_;
+  };
+
   ~lock_free_stack() {
     while (pop()) {
     }
   }
 
   void push(T const& data) {
-    counted_node_ptr new_node;
-    new_node.ptr = new node(data);
-    new_node.external_count = 1;
-    new_node.ptr->next = head_.load(std::memory_order_relaxed);
-    while (!head_.compare_exchange_weak(new_node.ptr->next, new_node,
+    counted_node_ptr const new_node(new node(data), 1);
+    new_node.ptr()->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(new_node.ptr()->next, new_node,
                                         std::memory_order_release,
                                         std::memory_order_relaxed)) {
+      if constexpr (Elimination) {
+        if (elimination_.try_push(new_node.ptr())) {
+          return;
+        }
+      }
     }
   }
 
@@ -50,15 +319,21 @@ class lock_free_stack {
     counted_node_ptr old_head = head_.load(std::memory_order_relaxed);
     for (;;) {
       increase_head_count(old_head);
-      node* const ptr = old_head.ptr;
+      node* const ptr = old_head.ptr();
       if (ptr == nullptr) {
         return std::shared_ptr<T>();
       }
-      if (head_.compare_exchange_strong(old_head, ptr->next,
-                                        std::memory_order_relaxed)) {
+      // CAS 失败但 head 还是这个节点时只是计数变了, 已经持有的引用仍然有效,
+      // 直接重试, 不用释放之后再增加一次
+      bool popped;
+      do {
+        popped = head_.compare_exchange_strong(old_head, ptr->next,
+                                               std::memory_order_relaxed);
+      } while (!popped && old_head.ptr() == ptr);
+      if (popped) {
         std::shared_ptr<T> result(ptr->data);
         result.swap(ptr->data);
-        int count_increase = old_head.external_count - 2;
+        int const count_increase = static_cast<int>(old_head.tag()) - 2;
         if (ptr->internal_count.fetch_add(
                 count_increase, std::memory_order_release) == -count_increase) {
           delete ptr;
@@ -69,6 +344,46 @@ class lock_free_stack {
         ptr->internal_count.load(std::memory_order_acquire);
         delete ptr;
       }
+      // head 被别的线程换掉了, 先看看有没有正在等待的 push
+      if constexpr (Elimination) {
+        if (node* const n = elimination_.try_pop()) {
+          return take_eliminated(n);
+        }
+      }
+    }
+  }
+
+  // 依次压入 [first, last), 结果与逐个 push 相同(最后一个元素在栈顶)
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    if (first == last) {
+      return;
+    }
+    node* const bottom = new node(*first);
+    counted_node_ptr top(bottom, 1);
+    try {
+      for (++first; first != last; ++first) {
+        node* const new_node = new node(*first);
+        new_node->next = top;
+        top = counted_node_ptr(new_node, 1);
+      }
+    } catch (...) {
+      delete_chain(top.ptr());
+      throw;
+    }
+    bottom->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(bottom->next, top,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  // 摘下整个栈, 栈空时不写 head
+  batch pop_all() {
+    if (head_.load(std::memory_order_relaxed).ptr() == nullptr) {
+      return batch(counted_node_ptr());
     }
+    return batch(
+        head_.exchange(counted_node_ptr(), std::memory_order_acquire));
   }
-};
\ No newline at end of file
+};
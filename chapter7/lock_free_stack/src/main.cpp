@@ -1,13 +1,19 @@
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
+#include <new>
 #include <random>
 #include <thread>
 #include <vector>
 
+#include "epoch.h"
 #include "lock_free_stack.h"
+#include "reclaimer.h"
 
 // 测试配置
 const int NUM_THREADS = 8;
@@ -19,6 +25,34 @@ std::atomic<long long> total_push_operations(0);
 std::atomic<long long> total_pop_operations(0);
 std::atomic<long long> successful_pop_operations(0);
 
+// 全局 operator new 的调用次数, 用来确认节点池在稳定状态下不再分配内存
+std::atomic<long long> global_new_calls(0);
+
+void* operator new(std::size_t size) {
+  global_new_calls.fetch_add(1, std::memory_order_relaxed);
+  if (void* const ptr = std::malloc(size != 0 ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+  global_new_calls.fetch_add(1, std::memory_order_relaxed);
+  std::size_t const alignment = static_cast<std::size_t>(align);
+  std::size_t const rounded = (size + alignment - 1) / alignment * alignment;
+  if (void* const ptr = std::aligned_alloc(alignment, rounded)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
 // 用于收集pop出的数据
 std::mutex result_mutex;
 std::vector<int> popped_values;
@@ -311,6 +345,421 @@ void stress_test() {
             << " ops/sec" << std::endl;
 }
 
+// 预先压入 items 个元素, threads 个线程同时 pop 直到栈空
+// 返回每秒成功的 pop 次数, popped 返回实际弹出的元素个数
+template <typename Stack>
+double pop_throughput(int threads, int items, long long& popped) {
+  Stack stack;
+  for (int i = 0; i < items; ++i) {
+    stack.push(i);
+  }
+  std::atomic<long long> count(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      long long local = 0;
+      while (stack.pop()) {
+        ++local;
+      }
+      count += local;
+    });
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  go = true;
+  for (auto& t : workers) {
+    t.join();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      end_time - start_time);
+
+  popped = count;
+  return count * 1000000.0 / std::max<long long>(duration.count(), 1);
+}
+
+// 栈里预先有 prefill 个元素, threads 个线程共执行 total_ops 次操作,
+// 其中 push_percent% 是 push, 其余是 pop. 返回每秒的操作数;
+// balanced 返回元素个数是否守恒: 预先压入 + push - 成功的 pop = 剩余
+template <typename Stack>
+double mixed_throughput(int threads, int total_ops, int push_percent,
+                        int prefill, bool& balanced) {
+  Stack stack;
+  for (int i = 0; i < prefill; ++i) {
+    stack.push(i);
+  }
+  std::atomic<long long> pushes(0);
+  std::atomic<long long> pops(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937 gen(t);
+      std::uniform_int_distribution<> op_dis(0, 99);
+      long long local_pushes = 0, local_pops = 0;
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < total_ops / threads; ++i) {
+        if (op_dis(gen) < push_percent) {
+          stack.push(i);
+          ++local_pushes;
+        } else if (stack.pop()) {
+          ++local_pops;
+        }
+      }
+      pushes += local_pushes;
+      pops += local_pops;
+    });
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  go = true;
+  for (auto& t : workers) {
+    t.join();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      end_time - start_time);
+
+  long long remaining = 0;
+  while (stack.pop()) {
+    ++remaining;
+  }
+  balanced = prefill + pushes - pops == remaining;
+  long long const ops = static_cast<long long>(total_ops / threads) * threads;
+  return ops * 1000000.0 / std::max<long long>(duration.count(), 1);
+}
+
+// threads 个线程各自 push items 个元素再全部 pop, 重复 rounds 轮,
+// 返回这期间 operator new 的调用次数(不含创建线程). 只有一个线程时
+// 直接在当前线程里执行
+template <typename Stack>
+long long allocations_per_rounds(Stack& stack, int threads, int items,
+                                 int rounds) {
+  auto work = [&] {
+    for (int i = 0; i < items; ++i) {
+      stack.push(i);
+    }
+    for (int i = 0; i < items; ++i) {
+      stack.pop();
+    }
+  };
+  long long total = 0;
+  for (int round = 0; round < rounds; ++round) {
+    long long const before = global_new_calls.load();
+    if (threads == 1) {
+      work();
+      total += global_new_calls.load() - before;
+      continue;
+    }
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&] {
+        while (!go.load()) {
+          std::this_thread::yield();
+        }
+        work();
+      });
+    }
+    // 创建线程本身的分配不计入
+    long long const started = global_new_calls.load();
+    go = true;
+    for (auto& t : workers) {
+      t.join();
+    }
+    total += global_new_calls.load() - started;
+  }
+  return total;
+}
+
+// 节点和数据块来自节点池: 第一轮把池子填满之后, 三种回收策略的 push/pop
+// 都不再调用 operator new(风险指针扫描用的数组留在线程记录里复用, 纪元的
+// 待回收列表也由节点池里的块串成). 多线程时每轮都是新线程, 新线程第一次
+// 使用节点池可能还要分配弹匣; 纪元被挂起的线程拖住时待回收的节点变多,
+// 池子也可能再申请 slab, 所以只检查单线程
+void node_pool_test() {
+  std::cout << "\n=== 节点池: 稳定状态下的内存分配 ===" << std::endl;
+  const int ITEMS = 10000;
+  const int ROUNDS = 3;
+  bool correct = true;
+  for (int threads : {1, 8}) {
+    lock_free_stack<int> counted;
+    lock_free_stack<int, hazard_pointer_reclaimer> hazard;
+    lock_free_stack<int, epoch_reclaimer> epoch;
+    long long const counted_cold =
+        allocations_per_rounds(counted, threads, ITEMS, 1);
+    long long const counted_warm =
+        allocations_per_rounds(counted, threads, ITEMS, ROUNDS);
+    allocations_per_rounds(hazard, threads, ITEMS, 1);
+    long long const hazard_warm =
+        allocations_per_rounds(hazard, threads, ITEMS, ROUNDS);
+    allocations_per_rounds(epoch, threads, ITEMS, 1);
+    long long const epoch_warm =
+        allocations_per_rounds(epoch, threads, ITEMS, ROUNDS);
+    long long const ops = 2LL * threads * ITEMS * ROUNDS;
+    std::cout << "线程数 " << threads << ": 第一轮 operator new "
+              << counted_cold << " 次; 之后 " << ops << " 次操作中, 引用计数 "
+              << counted_warm << " 次, 风险指针 " << hazard_warm
+              << " 次, 纪元 " << epoch_warm << " 次" << std::endl;
+    if (threads == 1) {
+      correct = correct && counted_warm == 0 && hazard_warm == 0 &&
+                epoch_warm == 0;
+    }
+  }
+  std::cout << "单线程稳定状态下不再分配: " << (correct ? "正确" : "错误")
+            << std::endl;
+}
+
+// 三种回收策略的吞吐量: 分离引用计数, 风险指针, 纪元
+void reclaimer_benchmark() {
+  std::cout << "\n=== 回收策略对比(引用计数 / 风险指针 / 纪元) ==="
+            << std::endl;
+  const int POP_ITEMS = 200000;
+  const int MIXED_OPS = 256000;
+  bool correct = true;
+
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << "竞争下的 pop(预先压入 " << POP_ITEMS << " 个元素), ops/sec:"
+            << std::endl;
+  for (int threads : {1, 2, 4, 8, 16}) {
+    long long counted_popped = 0, hazard_popped = 0, epoch_popped = 0;
+    double const counted = pop_throughput<lock_free_stack<int>>(
+        threads, POP_ITEMS, counted_popped);
+    double const hazard =
+        pop_throughput<lock_free_stack<int, hazard_pointer_reclaimer>>(
+            threads, POP_ITEMS, hazard_popped);
+    double const epoch = pop_throughput<lock_free_stack<int, epoch_reclaimer>>(
+        threads, POP_ITEMS, epoch_popped);
+    correct = correct && counted_popped == POP_ITEMS &&
+              hazard_popped == POP_ITEMS && epoch_popped == POP_ITEMS;
+    std::cout << "  线程数 " << threads << ": 引用计数 " << counted
+              << ", 风险指针 " << hazard << ", 纪元 " << epoch << std::endl;
+  }
+
+  // 50% push 时栈一直很浅; 20% push 时预先压入一批, 大部分 pop 都能成功
+  for (int push_percent : {50, 20}) {
+    std::cout << push_percent << "% push / " << 100 - push_percent
+              << "% pop, 共 " << MIXED_OPS << " 次操作, ops/sec:" << std::endl;
+    int const prefill = push_percent == 50 ? 0 : MIXED_OPS;
+    for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+      bool counted_ok = false, hazard_ok = false, epoch_ok = false;
+      double const counted = mixed_throughput<lock_free_stack<int>>(
+          threads, MIXED_OPS, push_percent, prefill, counted_ok);
+      double const hazard =
+          mixed_throughput<lock_free_stack<int, hazard_pointer_reclaimer>>(
+              threads, MIXED_OPS, push_percent, prefill, hazard_ok);
+      double const epoch =
+          mixed_throughput<lock_free_stack<int, epoch_reclaimer>>(
+              threads, MIXED_OPS, push_percent, prefill, epoch_ok);
+      correct = correct && counted_ok && hazard_ok && epoch_ok;
+      std::cout << "  线程数 " << threads << ": 引用计数 " << counted
+                << ", 风险指针 " << hazard << ", 纪元 " << epoch << std::endl;
+    }
+  }
+  std::cout.unsetf(std::ios::fixed);
+  std::cout << "元素个数守恒: " << (correct ? "正确" : "错误") << std::endl;
+}
+
+// 50% push / 50% pop 的混合负载下, 有无消除数组的吞吐量随线程数的变化,
+// 括号里是相对单线程的倍数
+void elimination_benchmark() {
+  std::cout << "\n=== 消除数组(elimination backoff) ===" << std::endl;
+  const int MIXED_OPS = 256000;
+  const int PREFILL = 1000;
+  bool correct = true;
+
+  using counted_stack = lock_free_stack<int>;
+  using counted_elimination =
+      lock_free_stack<int, split_reference_count, true>;
+  using epoch_stack = lock_free_stack<int, epoch_reclaimer>;
+  using epoch_elimination = lock_free_stack<int, epoch_reclaimer, true>;
+
+  std::cout << "50% push / 50% pop, 共 " << MIXED_OPS << " 次操作, ops/sec:"
+            << std::endl;
+  double base[4] = {};
+  std::cout << std::fixed;
+  for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+    bool ok[4] = {};
+    double const rates[4] = {
+        mixed_throughput<counted_stack>(threads, MIXED_OPS, 50, PREFILL, ok[0]),
+        mixed_throughput<counted_elimination>(threads, MIXED_OPS, 50, PREFILL,
+                                              ok[1]),
+        mixed_throughput<epoch_stack>(threads, MIXED_OPS, 50, PREFILL, ok[2]),
+        mixed_throughput<epoch_elimination>(threads, MIXED_OPS, 50, PREFILL,
+                                            ok[3]),
+    };
+    for (int i = 0; i < 4; ++i) {
+      correct = correct && ok[i];
+      if (threads == 1) {
+        base[i] = rates[i];
+      }
+    }
+    auto report = [&](int i) {
+      std::cout << std::setprecision(0) << rates[i] << " (x"
+                << std::setprecision(2) << rates[i] / base[i] << ")";
+    };
+    std::cout << "  线程数 " << threads << ": 引用计数 ";
+    report(0);
+    std::cout << ", 加消除 ";
+    report(1);
+    std::cout << "; 纪元 ";
+    report(2);
+    std::cout << ", 加消除 ";
+    report(3);
+    std::cout << std::endl;
+  }
+  std::cout.unsetf(std::ios::fixed);
+  std::cout << std::setprecision(6);
+  std::cout << "元素个数守恒: " << (correct ? "正确" : "错误") << std::endl;
+}
+
+// 生产者每次用 push_range 压入一批, 一半消费者反复 pop_all 取走全部,
+// 另一半逐个 pop, 检查每个值恰好取到一次. 单线程时 pop_all 的顺序与逐个
+// pop 相同
+template <typename Stack>
+bool batch_operations(int producers, int consumers, int bursts,
+                      int burst_size) {
+  Stack stack;
+  std::vector<int> ordered(burst_size);
+  for (int i = 0; i < burst_size; ++i) {
+    ordered[i] = i;
+  }
+  stack.push_range(ordered.begin(), ordered.end());
+  stack.push_range(ordered.end(), ordered.end());
+  bool correct = true;
+  int expected = burst_size;
+  for (auto const& value : stack.pop_all()) {
+    correct = correct && *value == --expected;
+  }
+  correct = correct && expected == 0 && stack.pop_all().empty();
+
+  int const total = producers * bursts * burst_size;
+  std::vector<std::atomic<int>> seen(total);
+  std::atomic<int> producers_done(0);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      std::vector<int> burst(burst_size);
+      for (int b = 0; b < bursts; ++b) {
+        for (int i = 0; i < burst_size; ++i) {
+          burst[i] = (p * bursts + b) * burst_size + i;
+        }
+        stack.push_range(burst.begin(), burst.end());
+      }
+      ++producers_done;
+    });
+  }
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&, c] {
+      for (;;) {
+        // 先读标志再取: 标志已经置位时, 这次取空之后栈里不会再有新元素
+        bool const done = producers_done.load() == producers;
+        if (c % 2 == 0) {
+          for (auto const& value : stack.pop_all()) {
+            seen[*value].fetch_add(1, std::memory_order_relaxed);
+          }
+        } else {
+          while (auto const value = stack.pop()) {
+            seen[*value].fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        if (done) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto const& count : seen) {
+    correct = correct && count.load() == 1;
+  }
+  return correct;
+}
+
+void batch_test() {
+  std::cout << "\n=== 批量操作: push_range / pop_all ===" << std::endl;
+  const int PRODUCERS = 4;
+  const int CONSUMERS = 2;
+  const int BURSTS = 500;
+  const int BURST_SIZE = 64;
+  bool const counted = batch_operations<lock_free_stack<int>>(
+      PRODUCERS, CONSUMERS, BURSTS, BURST_SIZE);
+  bool const hazard =
+      batch_operations<lock_free_stack<int, hazard_pointer_reclaimer>>(
+          PRODUCERS, CONSUMERS, BURSTS, BURST_SIZE);
+  bool const epoch = batch_operations<lock_free_stack<int, epoch_reclaimer>>(
+      PRODUCERS, CONSUMERS, BURSTS, BURST_SIZE);
+  std::cout << PRODUCERS << " 个生产者各压入 " << BURSTS << " 批, 每批 "
+            << BURST_SIZE << " 个; " << CONSUMERS
+            << " 个消费者 pop_all / pop" << std::endl;
+  std::cout << "引用计数: " << (counted ? "正确" : "错误")
+            << ", 风险指针: " << (hazard ? "正确" : "错误")
+            << ", 纪元: " << (epoch ? "正确" : "错误") << std::endl;
+}
+
+// 一个线程停在临界区里时纪元无法推进, 摘下的节点都留在待回收列表里;
+// 它定期调用 quiescent_state() 公布新纪元之后回收恢复
+void epoch_stall_test() {
+  std::cout << "\n=== 纪元回收: 停滞线程 ===" << std::endl;
+  epoch_domain& domain = epoch_domain::instance();
+  lock_free_stack<int, epoch_reclaimer> stack;
+  const int CHURN = 10000;
+  auto churn = [&] {
+    for (int i = 0; i < CHURN; ++i) {
+      stack.push(i);
+      stack.pop();
+      if (i % 1000 == 0) {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  std::atomic<int> phase(0);
+  std::thread reader([&] {
+    epoch_guard guard;
+    phase = 1;
+    while (phase.load() != 2) {
+      std::this_thread::yield();
+    }
+    // 仍然在临界区里, 但定期声明自己没有持有节点
+    while (phase.load() != 3) {
+      domain.quiescent_state();
+      std::this_thread::yield();
+    }
+  });
+  while (phase.load() != 1) {
+    std::this_thread::yield();
+  }
+
+  std::size_t const pending_before = domain.pending();
+  churn();
+  unsigned const stalled = domain.stalled_threads();
+  std::size_t const pending_stalled = domain.pending() - pending_before;
+  phase = 2;
+  churn();
+  std::size_t const pending_after = domain.pending() - pending_before;
+  phase = 3;
+  reader.join();
+
+  std::cout << "停滞线程数: " << stalled << std::endl;
+  std::cout << "停滞期间未回收的节点: " << pending_stalled << std::endl;
+  std::cout << "quiescent_state() 之后未回收的节点: " << pending_after
+            << std::endl;
+  bool const correct = stalled == 1 && pending_stalled > CHURN / 2 &&
+                       pending_after < CHURN / 2;
+  std::cout << "停滞线程阻止回收, 恢复后继续回收: "
+            << (correct ? "正确" : "错误") << std::endl;
+}
+
 int main() {
   std::cout << "Lock-Free Stack 多线程高并发测试" << std::endl;
   std::cout << "================================" << std::endl;
@@ -324,6 +773,11 @@ int main() {
     performance_test();
     mixed_operations_test();
     stress_test();
+    batch_test();
+    epoch_stall_test();
+    node_pool_test();
+    reclaimer_benchmark();
+    elimination_benchmark();
 
     std::cout << "\n所有测试完成！" << std::endl;
 
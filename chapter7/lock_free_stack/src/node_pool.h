@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "tagged_ptr.h"
+
+// 固定大小的节点池: 线程本地的弹匣(magazine) + 全局无锁仓库(depot)
+// 无锁容器每次操作都要分配和释放节点, 竞争下通用的 malloc 会让所有线程
+// 排队. 节点池里每个线程缓存两个弹匣, 每个弹匣最多装 magazine_size 个
+// 空闲块(块越大装得越少, 合计不超过 64 KiB), 分配和释放只在自己的弹匣里
+// 取放, 不需要任何同步:
+//   - 分配时当前弹匣空了, 换上另一个; 两个都空, 从仓库取一个装满的弹匣;
+//     仓库也空了才向系统申请一整块(slab), 切成 magazine_size 个块
+//   - 释放时当前弹匣满了, 换上另一个; 两个都满, 把一个交给仓库, 换一个
+//     空弹匣. 两个弹匣的作用是在边界上来回分配/释放时不会每次都访问仓库
+// 仓库是两个无锁栈(装满的和空的弹匣), head 带 ABA 标签(见 tagged_ptr.h).
+// 稳定状态下所有块都在弹匣和仓库之间流转, 不再调用 malloc.
+// 线程的弹匣在线程退出时交还仓库. 之后这个线程里的分配和释放(例如回收
+// 策略的线程记录析构时释放节点)共用一个加锁的弹匣, 只在退出阶段发生.
+// 块和弹匣都不还给系统: 池本身也不析构, 静态析构阶段(例如回收策略的
+// 单例释放剩余节点)仍然可以归还块
+template <std::size_t Size, std::size_t Align>
+class node_pool {
+ public:
+  static constexpr std::size_t magazine_size =
+      std::clamp<std::size_t>(65536 / Size, 1, 64);
+
+  static node_pool& instance() {
+    static node_pool* const pool = new node_pool;
+    return *pool;
+  }
+
+  node_pool(node_pool const&) = delete;
+  node_pool& operator=(node_pool const&) = delete;
+
+  void* allocate() {
+    local_cache& cache = local();
+    if (cache.loaded != nullptr && cache.loaded->count != 0) {
+      return cache.loaded->blocks[--cache.loaded->count];
+    }
+    return allocate_slow(cache);
+  }
+
+  void deallocate(void* block) {
+    local_cache& cache = local();
+    if (cache.loaded != nullptr && cache.loaded->count != magazine_size) {
+      cache.loaded->blocks[cache.loaded->count++] = block;
+      return;
+    }
+    deallocate_slow(cache, block);
+  }
+
+  // 已经向系统申请的 slab 数, 稳定状态下不再增长
+  std::size_t slab_count() const {
+    return slabs_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct magazine {
+    std::atomic<magazine*> next{nullptr};  // 仓库里的链接
+    magazine* registered_next = nullptr;   // 所有弹匣的链表
+    std::size_t count = 0;
+    void* blocks[magazine_size];
+  };
+
+  // 平凡类型, 线程退出的任何阶段都可以访问
+  struct local_cache {
+    magazine* loaded;
+    magazine* previous;
+    bool exited;
+  };
+
+  // 线程退出时把两个弹匣交还仓库, 之后这个线程的分配和释放直接访问仓库
+  struct flusher {
+    ~flusher() {
+      local_cache& cache = local();
+      node_pool& pool = instance();
+      pool.give_back(cache.loaded);
+      pool.give_back(cache.previous);
+      cache = {nullptr, nullptr, true};
+    }
+  };
+
+  node_pool() = default;
+
+  static local_cache& local() {
+    thread_local local_cache cache = {nullptr, nullptr, false};
+    return cache;
+  }
+
+  void attach(local_cache& cache) {
+    thread_local flusher flush_on_exit;
+    cache.loaded = take_empty();
+    cache.previous = take_empty();
+  }
+
+  void* allocate_slow(local_cache& cache) {
+    if (cache.exited) {
+      std::lock_guard<std::mutex> lock(orphan_mutex_);
+      if (orphan_ == nullptr || orphan_->count == 0) {
+        give_back(orphan_);
+        orphan_ = pop(full_);
+        if (orphan_ == nullptr) {
+          orphan_ = take_empty();
+          fill(*orphan_);
+        }
+      }
+      return orphan_->blocks[--orphan_->count];
+    }
+    if (cache.loaded == nullptr) {
+      attach(cache);
+    }
+    if (cache.previous->count == 0) {
+      if (magazine* const m = pop(full_)) {
+        push(empty_, cache.previous);
+        cache.previous = m;
+      } else {
+        fill(*cache.previous);
+      }
+    }
+    std::swap(cache.loaded, cache.previous);
+    return cache.loaded->blocks[--cache.loaded->count];
+  }
+
+  void deallocate_slow(local_cache& cache, void* block) {
+    if (cache.exited) {
+      std::lock_guard<std::mutex> lock(orphan_mutex_);
+      if (orphan_ == nullptr || orphan_->count == magazine_size) {
+        give_back(orphan_);
+        orphan_ = take_empty();
+      }
+      orphan_->blocks[orphan_->count++] = block;
+      return;
+    }
+    if (cache.loaded == nullptr) {
+      attach(cache);
+    }
+    if (cache.previous->count == magazine_size) {
+      push(full_, cache.previous);
+      cache.previous = take_empty();
+    }
+    std::swap(cache.loaded, cache.previous);
+    cache.loaded->blocks[cache.loaded->count++] = block;
+  }
+
+  // 切一个新的 slab 装满空弹匣
+  void fill(magazine& m) {
+    assert(m.count == 0);
+    char* const slab = static_cast<char*>(
+        ::operator new(block_size * magazine_size, std::align_val_t{Align}));
+    slabs_.fetch_add(1, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < magazine_size; ++i) {
+      m.blocks[i] = slab + i * block_size;
+    }
+    m.count = magazine_size;
+  }
+
+  // 新的弹匣挂到 all_ 上. 仓库里的指针带着标签, 内存检查工具认不出来,
+  // 靠这个链表让弹匣和里面的块始终可达
+  magazine* take_empty() {
+    if (magazine* const m = pop(empty_)) {
+      return m;
+    }
+    magazine* const m = new magazine;
+    m->registered_next = all_.load(std::memory_order_relaxed);
+    while (!all_.compare_exchange_weak(m->registered_next, m,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    }
+    return m;
+  }
+
+  void give_back(magazine* m) {
+    if (m != nullptr) {
+      push(m->count != 0 ? full_ : empty_, m);
+    }
+  }
+
+  // 弹匣不会被释放, pop 读到已经被别的线程取走的弹匣的 next 也是安全的,
+  // 标签保证这种情况下 CAS 一定失败
+  static void push(atomic_tagged_ptr<magazine>& list, magazine* m) {
+    tagged_ptr<magazine> old_head = list.load(std::memory_order_relaxed);
+    do {
+      m->next.store(old_head.ptr(), std::memory_order_relaxed);
+    } while (!list.compare_exchange_weak(
+        old_head, tagged_ptr<magazine>(m, old_head.tag()),
+        std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  static magazine* pop(atomic_tagged_ptr<magazine>& list) {
+    tagged_ptr<magazine> old_head = list.load(std::memory_order_acquire);
+    while (old_head.ptr() != nullptr &&
+           !list.compare_exchange_weak(
+               old_head,
+               tagged_ptr<magazine>(
+                   old_head.ptr()->next.load(std::memory_order_relaxed),
+                   old_head.tag() + 1),
+               std::memory_order_acquire, std::memory_order_acquire)) {
+    }
+    return old_head.ptr();
+  }
+
+  static constexpr std::size_t block_size = (Size + Align - 1) / Align * Align;
+
+  atomic_tagged_ptr<magazine> full_;
+  atomic_tagged_ptr<magazine> empty_;
+  std::atomic<magazine*> all_{nullptr};
+  std::atomic<std::size_t> slabs_{0};
+  // 已经退出的线程共用的弹匣
+  std::mutex orphan_mutex_;
+  magazine* orphan_ = nullptr;
+
+  static_assert(atomic_tagged_ptr<magazine>::is_always_lock_free,
+                "the depot would fall back to a lock-based atomic");
+};
+
+template <typename T>
+using node_pool_for = node_pool<sizeof(T), alignof(T)>;
+
+// 节点类型继承它, new/delete 改为从节点池分配, 包括回收策略里的 delete
+template <typename Derived>
+struct pool_allocated {
+  static void* operator new(std::size_t size) {
+    assert(size == sizeof(Derived));
+    (void)size;
+    return node_pool_for<Derived>::instance().allocate();
+  }
+
+  static void operator delete(void* ptr) {
+    node_pool_for<Derived>::instance().deallocate(ptr);
+  }
+};
+
+// 单个对象从节点池分配的分配器, 用于 std::allocate_shared 等
+template <typename T>
+class pool_allocator {
+ public:
+  using value_type = T;
+
+  pool_allocator() = default;
+  template <typename U>
+  pool_allocator(pool_allocator<U> const&) {}
+
+  T* allocate(std::size_t n) {
+    if (n != 1) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<T*>(node_pool_for<T>::instance().allocate());
+  }
+
+  void deallocate(T* ptr, std::size_t n) {
+    if (n != 1) {
+      std::allocator<T>().deallocate(ptr, n);
+      return;
+    }
+    node_pool_for<T>::instance().deallocate(ptr);
+  }
+
+  template <typename U>
+  bool operator==(pool_allocator<U> const&) const {
+    return true;
+  }
+};
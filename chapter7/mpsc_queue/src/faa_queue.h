@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "node_pool.h"
+#include "reclaimer.h"
+
+// 基于 fetch_add 的无界多生产者多消费者队列, 接口与 lock_free_queue 相同
+// 队列是一串段(segment), 每段有 segment_size 个槽位和各自的入队/出队
+// 下标. lock_free_queue 的每次操作都要 CAS 同一个 head/tail, 竞争时
+// 不断失败重试; 这里入队和出队用 fetch_add 领取下标, fetch_add 不会失败,
+// 每个线程领到不同的槽位, 竞争只剩下同一个槽位上的一次交换:
+//   - 入队: 在领到的槽位里原地构造元素, 再把槽位从 empty 改为 ready.
+//     出队线程抢先把槽位标记为 taken 时改写失败, 元素移到下一个槽位重试.
+//     下标超出本段时追加一个新段(元素预先放在新段的第一个槽位)
+//   - 出队: 把领到的槽位交换为 taken, 原来是 ready 就取走元素, 原来是
+//     empty 说明入队线程还没写入, 它会发现自己的槽位被占了, 出队重试.
+//     下标超出本段且后面还有段时把 head 移到下一段, 旧段交给 Reclaimer
+// 段只会在被取空之后从 head 摘下, 摘下之前先保证 tail 不再指向它, 段的
+// 内存来自节点池, 回收之后被新追加的段复用.
+// 出队线程可能一直抢在同一个入队线程前面, 入队不保证在有限步内完成
+template <typename T, typename Reclaimer = hazard_pointer_reclaimer>
+class faa_queue {
+  static_assert(!std::is_same_v<Reclaimer, split_reference_count>,
+                "faa_queue reclaims segments with hazard pointers or epochs");
+  static_assert(std::is_nothrow_move_constructible_v<T>,
+                "a failed slot moves the element to the next one");
+
+ public:
+  static constexpr std::size_t segment_size = 1024;
+
+ private:
+  enum class cell_state : unsigned char { empty, ready, taken };
+
+  struct cell {
+    std::atomic<cell_state> state{cell_state::empty};
+    union {
+      T value;
+    };
+    cell() {}
+    ~cell() {}
+  };
+
+  // 两个下标分别独占缓存行, 入队和出队线程不会互相干扰
+  struct segment : pool_allocated<segment> {
+    alignas(64) std::atomic<std::size_t> enqueue_index{0};
+    alignas(64) std::atomic<std::size_t> dequeue_index{0};
+    alignas(64) std::atomic<segment*> next{nullptr};
+    cell cells[segment_size];
+  };
+
+  alignas(64) std::atomic<segment*> head_;
+  alignas(64) std::atomic<segment*> tail_;
+
+  static_assert(std::atomic<std::size_t>::is_always_lock_free);
+  static_assert(std::atomic<cell_state>::is_always_lock_free);
+
+  // pending 为空时用 args 构造元素, 否则从 pending 移动过来
+  template <typename... Args>
+  static void construct(T* slot, std::optional<T>& pending, Args&&... args) {
+    if (pending) {
+      std::construct_at(slot, std::move(*pending));
+    } else {
+      std::construct_at(slot, std::forward<Args>(args)...);
+    }
+  }
+
+  // 取出队首元素交给 consume(T&&), 之后销毁它. 队列为空时返回 false
+  template <typename Consume>
+  bool dequeue(Consume&& consume) {
+    typename Reclaimer::guard guard;
+    for (;;) {
+      segment* const head = guard.protect(head_, 0);
+      if (head->dequeue_index.load(std::memory_order_acquire) >=
+              head->enqueue_index.load(std::memory_order_acquire) &&
+          head->next.load(std::memory_order_acquire) == nullptr) {
+        return false;
+      }
+      std::size_t const index =
+          head->dequeue_index.fetch_add(1, std::memory_order_acq_rel);
+      if (index >= segment_size) {
+        // 本段已经取空
+        segment* const next = head->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+          return false;
+        }
+        segment* expected = head;
+        tail_.compare_exchange_strong(expected, next);
+        expected = head;
+        if (head_.compare_exchange_strong(expected, next)) {
+          guard.reset(0);
+          Reclaimer::retire(head);
+        }
+        continue;
+      }
+      cell& c = head->cells[index];
+      if (c.state.exchange(cell_state::taken, std::memory_order_acq_rel) !=
+          cell_state::ready) {
+        continue;
+      }
+      try {
+        consume(std::move(c.value));
+      } catch (...) {
+        std::destroy_at(&c.value);
+        throw;
+      }
+      std::destroy_at(&c.value);
+      return true;
+    }
+  }
+
+ public:
+  faa_queue() {
+    segment* const first = new segment;
+    head_.store(first);
+    tail_.store(first);
+  }
+
+  faa_queue(faa_queue const&) = delete;
+  faa_queue& operator=(faa_queue const&) = delete;
+
+  ~faa_queue() {
+    while (dequeue([](T&&) {})) {
+    }
+    segment* s = head_.load();
+    while (s != nullptr) {
+      segment* const next = s->next.load();
+      delete s;
+      s = next;
+    }
+  }
+
+  void push(T new_value) { emplace(std::move(new_value)); }
+
+  template <typename... Args>
+  void emplace(Args&&... args) {
+    // 改写槽位失败后元素暂存在这里
+    std::optional<T> pending;
+    typename Reclaimer::guard guard;
+    for (;;) {
+      segment* const tail = guard.protect(tail_, 0);
+      std::size_t const index =
+          tail->enqueue_index.fetch_add(1, std::memory_order_acq_rel);
+      if (index < segment_size) {
+        cell& c = tail->cells[index];
+        construct(&c.value, pending, std::forward<Args>(args)...);
+        cell_state expected = cell_state::empty;
+        if (c.state.compare_exchange_strong(expected, cell_state::ready,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+          return;
+        }
+        // 出队线程已经放弃了这个槽位
+        pending.emplace(std::move(c.value));
+        std::destroy_at(&c.value);
+        continue;
+      }
+      // 本段已满: 帮忙移动 tail, 或者追加一个新段
+      if (tail != tail_.load()) {
+        continue;
+      }
+      segment* next = tail->next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        segment* const fresh = new segment;
+        try {
+          construct(&fresh->cells[0].value, pending,
+                    std::forward<Args>(args)...);
+        } catch (...) {
+          delete fresh;
+          throw;
+        }
+        fresh->cells[0].state.store(cell_state::ready,
+                                    std::memory_order_relaxed);
+        fresh->enqueue_index.store(1, std::memory_order_relaxed);
+        if (tail->next.compare_exchange_strong(next, fresh,
+                                               std::memory_order_release,
+                                               std::memory_order_acquire)) {
+          segment* expected = tail;
+          tail_.compare_exchange_strong(expected, fresh);
+          return;
+        }
+        pending.emplace(std::move(fresh->cells[0].value));
+        std::destroy_at(&fresh->cells[0].value);
+        delete fresh;
+      }
+      segment* expected = tail;
+      tail_.compare_exchange_strong(expected, next);
+    }
+  }
+
+  bool try_pop(T& value) {
+    return dequeue([&](T&& front) { value = std::move(front); });
+  }
+
+  std::unique_ptr<T> pop() {
+    std::unique_ptr<T> result;
+    dequeue([&](T&& front) { result = std::make_unique<T>(std::move(front)); });
+    return result;
+  }
+};
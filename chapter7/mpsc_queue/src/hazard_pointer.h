@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// 风险指针(hazard pointer)内存回收
+// 无锁容器摘下一个节点之后, 别的线程可能还拿着指向它的指针, 不能马上删除.
+// 线程在解引用一个共享指针之前, 先把它写进自己的风险指针槽位(protect),
+// 声明 "我正在用它"; 摘下节点的线程不直接删除, 而是放进自己的待回收
+// 列表(retire). 待回收的节点攒够一定数量后扫描一次(scan): 收集所有线程
+// 槽位里的指针, 不在其中的节点就没有人能再访问到, 可以删除
+//   - 每个线程占用一条记录: slots_per_thread 个槽位 + 自己的待回收列表,
+//     记录组成一个只增不减的链表, 线程退出后记录留给之后的线程复用
+//   - 待回收的节点数达到 2 * 槽位总数(至少 min_scan_threshold)才扫描,
+//     一次扫描至少能删掉一半, 每个节点分摊的扫描开销是常数
+// 槽位的写入和扫描时的读取都是 seq_cst: 要么扫描看到了槽位里的指针,
+// 要么写槽位的线程重新读取来源时看到节点已经被摘下, 放弃这个指针重试
+class hazard_pointer_domain {
+ public:
+  static constexpr unsigned slots_per_thread = 4;
+  static constexpr std::size_t min_scan_threshold = 64;
+
+  static hazard_pointer_domain& instance() {
+    static hazard_pointer_domain domain;
+    return domain;
+  }
+
+  hazard_pointer_domain(hazard_pointer_domain const&) = delete;
+  hazard_pointer_domain& operator=(hazard_pointer_domain const&) = delete;
+
+  // 所有线程都已经退出, 剩下的节点不会再被访问
+  ~hazard_pointer_domain() {
+    record* r = records_.load(std::memory_order_acquire);
+    while (r != nullptr) {
+      record* const next = r->next;
+      for (retired_node const& node : r->retired) {
+        node.deleter(node.ptr);
+      }
+      delete r;
+      r = next;
+    }
+  }
+
+  // 节点已经从容器中摘下, 没有线程保护它之后用 delete 释放
+  template <typename T>
+  void retire(T* ptr) {
+    retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+  }
+
+  void retire(void* ptr, void (*deleter)(void*)) {
+    record& r = local_record();
+    r.retired.push_back({ptr, deleter});
+    if (r.retired.size() >= scan_threshold()) {
+      scan(r);
+    }
+  }
+
+  // 已注册的记录数, 也就是同时用到风险指针的最大线程数
+  unsigned record_count() const {
+    return record_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  friend class hazard_pointer;
+
+  struct retired_node {
+    void* ptr;
+    void (*deleter)(void*);
+  };
+
+  // 每条记录独占缓存行, 写自己的槽位不会干扰其他线程
+  struct alignas(64) record {
+    std::atomic<void*> slots[slots_per_thread] = {};
+    std::atomic<bool> active{true};
+    record* next = nullptr;
+    // 以下只由占用记录的线程访问
+    unsigned used_slots = 0;  // 已分配槽位的位图
+    std::vector<retired_node> retired;
+    std::vector<void*> hazards;  // scan 收集槽位用, 跨扫描复用
+  };
+
+  // 线程第一次用到时占用一条记录, 退出时先尽量回收再归还
+  struct thread_record {
+    record* r = nullptr;
+    ~thread_record() {
+      if (r != nullptr) {
+        hazard_pointer_domain& domain = instance();
+        domain.scan(*r);
+        r->active.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  hazard_pointer_domain() = default;
+
+  record& local_record() {
+    thread_local thread_record local;
+    if (local.r == nullptr) {
+      local.r = acquire_record();
+    }
+    return *local.r;
+  }
+
+  record* acquire_record() {
+    for (record* r = records_.load(std::memory_order_acquire); r != nullptr;
+         r = r->next) {
+      bool expected = false;
+      if (!r->active.load(std::memory_order_relaxed) &&
+          r->active.compare_exchange_strong(expected, true,
+                                            std::memory_order_acquire)) {
+        return r;
+      }
+    }
+    record* const r = new record;
+    r->next = records_.load(std::memory_order_relaxed);
+    while (!records_.compare_exchange_weak(r->next, r,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+    record_count_.fetch_add(1, std::memory_order_relaxed);
+    return r;
+  }
+
+  std::size_t scan_threshold() const {
+    return std::max<std::size_t>(
+        min_scan_threshold, 2 * std::size_t{record_count()} * slots_per_thread);
+  }
+
+  // 收集槽位的数组和待回收列表都留在记录里复用, 记录数不再增长之后
+  // 扫描不分配内存
+  void scan(record& self) {
+    std::vector<void*>& hazards = self.hazards;
+    hazards.clear();
+    hazards.reserve(std::size_t{record_count()} * slots_per_thread);
+    for (record* r = records_.load(std::memory_order_acquire); r != nullptr;
+         r = r->next) {
+      for (std::atomic<void*> const& slot : r->slots) {
+        if (void* const p = slot.load(std::memory_order_seq_cst)) {
+          hazards.push_back(p);
+        }
+      }
+    }
+    std::sort(hazards.begin(), hazards.end());
+    // 仍被保护的节点留在列表里, 等下一次扫描
+    auto const kept = std::partition(
+        self.retired.begin(), self.retired.end(),
+        [&](retired_node const& node) {
+          return std::binary_search(hazards.begin(), hazards.end(), node.ptr);
+        });
+    for (auto it = kept; it != self.retired.end(); ++it) {
+      it->deleter(it->ptr);
+    }
+    self.retired.erase(kept, self.retired.end());
+  }
+
+  std::atomic<record*> records_{nullptr};
+  std::atomic<unsigned> record_count_{0};
+};
+
+// 一个风险指针槽位, 构造时从当前线程的记录中分配, 析构时清空并归还
+// 同一线程最多同时持有 slots_per_thread 个
+class hazard_pointer {
+ public:
+  hazard_pointer() {
+    record_ = &hazard_pointer_domain::instance().local_record();
+    unsigned const free = ~record_->used_slots;
+    if ((free & ((1u << hazard_pointer_domain::slots_per_thread) - 1)) == 0) {
+      throw std::runtime_error("no hazard pointer slot left in this thread");
+    }
+    index_ = static_cast<unsigned>(std::countr_zero(free));
+    record_->used_slots |= 1u << index_;
+  }
+
+  hazard_pointer(hazard_pointer const&) = delete;
+  hazard_pointer& operator=(hazard_pointer const&) = delete;
+
+  ~hazard_pointer() {
+    reset();
+    record_->used_slots &= ~(1u << index_);
+  }
+
+  // 保护 src 当前指向的对象并返回它, 返回之后对象不会被回收, 直到 reset
+  template <typename T>
+  T* protect(std::atomic<T*> const& src) {
+    T* ptr = src.load(std::memory_order_relaxed);
+    while (!try_protect(ptr, src)) {
+    }
+    return ptr;
+  }
+
+  // ptr 是之前从 src 读到的值. 写入槽位后重新读取 src, 没变就保护成功;
+  // 变了则清空槽位并把 ptr 更新为新读到的值
+  template <typename T>
+  bool try_protect(T*& ptr, std::atomic<T*> const& src) {
+    T* const expected = ptr;
+    reset(expected);
+    ptr = src.load(std::memory_order_seq_cst);
+    if (ptr != expected) {
+      reset();
+      return false;
+    }
+    return true;
+  }
+
+  // 直接声明保护 ptr, 调用者自己负责确认它此时还没有被摘下
+  void reset(void const* ptr = nullptr) {
+    record_->slots[index_].store(const_cast<void*>(ptr),
+                                 ptr != nullptr ? std::memory_order_seq_cst
+                                                : std::memory_order_release);
+  }
+
+ private:
+  hazard_pointer_domain::record* record_;
+  unsigned index_;
+};
@@ -0,0 +1,344 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "faa_queue.h"
+#include "lock_free_queue.h"
+#include "mpsc_queue.h"
+#include "reclaimer.h"
+
+// 全局 operator new 的调用次数, 用来确认入队和出队都不分配内存
+std::atomic<long long> global_new_calls(0);
+
+void* operator new(std::size_t size) {
+  global_new_calls.fetch_add(1, std::memory_order_relaxed);
+  if (void* const ptr = std::malloc(size != 0 ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+  global_new_calls.fetch_add(1, std::memory_order_relaxed);
+  std::size_t const alignment = static_cast<std::size_t>(align);
+  std::size_t const rounded = (size + alignment - 1) / alignment * alignment;
+  if (void* const ptr = std::aligned_alloc(alignment, rounded)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+// 对比用: chapter6 的细粒度锁队列(threadsafe_queue_accurate)
+template <typename T>
+class threadsafe_queue {
+  struct node {
+    std::shared_ptr<T> data;
+    std::unique_ptr<node> next;
+  };
+
+ public:
+  threadsafe_queue() : head_(new node), tail_(head_.get()) {}
+  threadsafe_queue(const threadsafe_queue& other) = delete;
+  threadsafe_queue& operator=(const threadsafe_queue& other) = delete;
+  void push(T new_value) {
+    std::shared_ptr<T> new_data(std::make_shared<T>(std::move(new_value)));
+    std::unique_ptr<node> p(new node);
+    {
+      std::lock_guard<std::mutex> lock(tail_mutex_);
+      tail_->data = new_data;
+      node* const new_tail = p.get();
+      tail_->next = std::move(p);
+      tail_ = new_tail;
+    }
+  }
+  std::shared_ptr<T> try_pop() {
+    std::unique_ptr<node> old_head = try_pop_head();
+    return old_head ? old_head->data : std::shared_ptr<T>();
+  }
+
+ private:
+  node* get_tail() {
+    std::lock_guard<std::mutex> lock(tail_mutex_);
+    return tail_;
+  }
+  std::unique_ptr<node> try_pop_head() {
+    std::lock_guard<std::mutex> lock(head_mutex_);
+    if (head_.get() == get_tail()) {
+      return nullptr;
+    }
+    std::unique_ptr<node> old_head = std::move(head_);
+    head_ = std::move(old_head->next);
+    return old_head;
+  }
+
+ private:
+  std::mutex head_mutex_;
+  std::mutex tail_mutex_;
+  std::unique_ptr<node> head_;
+  node* tail_;  // 指向"虚位"节点(dummy node)
+};
+
+// 邮箱里的消息, 由发送方预先分配
+struct message : mpsc_node {
+  int producer = 0;
+  int seq = 0;
+};
+
+// 基本功能: FIFO 顺序, 空队列, 出队的节点可以再次入队, 不分配内存
+void test_basic_operations() {
+  std::cout << "=== 基本功能测试 ===" << std::endl;
+
+  mpsc_queue<message> queue;
+  std::vector<message> messages(100);
+  for (int i = 0; i < 100; ++i) {
+    messages[i].seq = i;
+  }
+  assert(queue.empty() && queue.pop() == nullptr);
+
+  long long const before = global_new_calls.load();
+  for (int round = 0; round < 3; ++round) {
+    for (auto& m : messages) {
+      queue.push(&m);
+    }
+    assert(!queue.empty());
+    for (int i = 0; i < 100; ++i) {
+      message* const m = queue.pop();
+      assert(m == &messages[i] && m->seq == i);
+    }
+    assert(queue.empty() && queue.pop() == nullptr);
+  }
+  // 交替入队和出队, 队列里一直只有 0 到 1 个元素
+  for (auto& m : messages) {
+    queue.push(&m);
+    assert(queue.pop() == &m);
+  }
+  assert(global_new_calls.load() == before);
+  std::cout << "✓ FIFO 顺序正确, 节点可以重复入队, 没有分配内存" << std::endl;
+}
+
+// 多个生产者, 每个生产者的消息按发送顺序收到
+template <typename Queue>
+void test_multiple_producers(char const* name) {
+  std::cout << "=== 多生产者单消费者测试: " << name << " ===" << std::endl;
+
+  Queue queue;
+  const int producers = 4;
+  const int per_producer = 20000;
+  std::vector<std::vector<message>> outboxes(
+      producers, std::vector<message>(per_producer));
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i < per_producer; ++i) {
+        outboxes[p][i].producer = p;
+        outboxes[p][i].seq = i;
+        queue.push(&outboxes[p][i]);
+      }
+    });
+  }
+
+  std::vector<int> next(producers, 0);
+  for (int received = 0; received < producers * per_producer; ++received) {
+    message* m = nullptr;
+    if constexpr (requires { queue.pop_wait(); }) {
+      m = queue.pop_wait();
+    } else {
+      while ((m = queue.pop()) == nullptr) {
+        std::this_thread::yield();
+      }
+    }
+    assert(m->seq == next[m->producer]);
+    next[m->producer]++;
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  assert(queue.empty());
+  std::cout << "✓ " << producers << " 个生产者的消息都按顺序收到" << std::endl;
+}
+
+// 阻塞的消费者在队列为空时睡眠, 生产者间歇发送时每次都能被唤醒
+void test_blocking_consumer() {
+  std::cout << "=== 阻塞的消费者 ===" << std::endl;
+
+  mpsc_queue<message, true> queue;
+  const int producers = 3;
+  const int bursts = 20;
+  const int burst_size = 5;
+  std::vector<std::vector<message>> outboxes(
+      producers, std::vector<message>(bursts * burst_size));
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (int b = 0; b < bursts; ++b) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        for (int i = 0; i < burst_size; ++i) {
+          message& m = outboxes[p][b * burst_size + i];
+          m.producer = p;
+          m.seq = b * burst_size + i;
+          queue.push(&m);
+        }
+      }
+    });
+  }
+
+  std::vector<int> next(producers, 0);
+  for (int received = 0; received < producers * bursts * burst_size;
+       ++received) {
+    message* const m = queue.pop_wait();
+    assert(m->seq == next[m->producer]);
+    next[m->producer]++;
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  assert(queue.empty());
+  std::cout << "✓ 消费者睡眠之后被唤醒, 没有丢失消息" << std::endl;
+}
+
+// producers 个线程各调用 produce(p, i) per_producer 次, 当前线程作为
+// 消费者调用 consume() 直到取到全部元素, consume 返回是否取到了一个.
+// 返回每秒传递的元素个数
+template <typename Produce, typename Consume>
+double mailbox_rate(int producers, int per_producer, Produce produce,
+                    Consume consume) {
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < per_producer; ++i) {
+        produce(p, i);
+      }
+    });
+  }
+
+  long long const total = static_cast<long long>(producers) * per_producer;
+  auto start_time = std::chrono::high_resolution_clock::now();
+  go.store(true);
+  for (long long received = 0; received < total;) {
+    if (consume()) {
+      ++received;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      end_time - start_time);
+  return total * 1000000.0 / std::max<long long>(duration.count(), 1);
+}
+
+// 同一份工作负载下的吞吐量, 括号里是相对 chapter6 细粒度锁队列的倍数
+void test_performance() {
+  std::cout << "=== 性能测试(多生产者单消费者, 消息/秒) ===" << std::endl;
+  const int total = 400000;
+
+  std::cout << std::fixed;
+  for (int producers : {1, 2, 4, 8, 16}) {
+    int const per_producer = total / producers;
+    std::vector<std::vector<message>> outboxes(
+        producers, std::vector<message>(per_producer));
+
+    auto intrusive = [&]<bool Blocking>() {
+      mpsc_queue<message, Blocking> queue;
+      return mailbox_rate(
+          producers, per_producer,
+          [&](int p, int i) { queue.push(&outboxes[p][i]); },
+          [&] {
+            if constexpr (Blocking) {
+              return queue.pop_wait() != nullptr;
+            } else {
+              return queue.pop() != nullptr;
+            }
+          });
+    };
+    auto by_value = [&]<typename Queue>() {
+      Queue queue;
+      int value = 0;
+      return mailbox_rate(
+          producers, per_producer, [&](int, int i) { queue.push(i); },
+          [&] {
+            if constexpr (requires { queue.try_pop(value); }) {
+              return queue.try_pop(value);
+            } else {
+              return queue.try_pop() != nullptr;
+            }
+          });
+    };
+
+    double const locked = by_value.operator()<threadsafe_queue<int>>();
+    double const rates[4] = {
+        by_value.operator()<lock_free_queue<int>>(),
+        by_value.operator()<faa_queue<int>>(),
+        intrusive.operator()<false>(),
+        intrusive.operator()<true>(),
+    };
+    auto report = [&](double rate) {
+      std::cout << std::setprecision(0) << rate << " (x"
+                << std::setprecision(2) << rate / locked << ")";
+    };
+    std::cout << "  生产者 " << producers << ": 细粒度锁 "
+              << std::setprecision(0) << locked << ", lock_free_queue ";
+    report(rates[0]);
+    std::cout << ", faa_queue ";
+    report(rates[1]);
+    std::cout << ", mpsc_queue ";
+    report(rates[2]);
+    std::cout << ", 阻塞 ";
+    report(rates[3]);
+    std::cout << std::endl;
+  }
+  std::cout.unsetf(std::ios::fixed);
+  std::cout << std::setprecision(6);
+}
+
+int main() {
+  std::cout << "开始 mpsc_queue 测试..." << std::endl;
+  std::cout << "硬件并发数: " << std::thread::hardware_concurrency()
+            << std::endl;
+  std::cout << std::endl;
+
+  try {
+    test_basic_operations();
+    std::cout << std::endl;
+
+    test_multiple_producers<mpsc_queue<message>>("轮询");
+    test_multiple_producers<mpsc_queue<message, true>>("阻塞");
+    std::cout << std::endl;
+
+    test_blocking_consumer();
+    std::cout << std::endl;
+
+    test_performance();
+    std::cout << std::endl;
+
+    std::cout << "🎉 所有测试通过！mpsc_queue 工作正常。" << std::endl;
+
+  } catch (const std::exception& e) {
+    std::cerr << "❌ 测试失败: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+// 侵入式节点: 元素类型继承它, 队列通过它把元素串起来, 自己不分配内存.
+// 复制元素时不复制链接, 副本不在任何队列里
+struct mpsc_node {
+  std::atomic<mpsc_node*> next{nullptr};
+
+  mpsc_node() = default;
+  mpsc_node(mpsc_node const&) {}
+  mpsc_node& operator=(mpsc_node const&) { return *this; }
+};
+
+// 阻塞的消费者在这里睡眠. 生产者只在消费者睡眠时才加锁通知, 平时只多
+// 读一次 sleeping_
+template <bool Blocking>
+class mpsc_waiter {
+ public:
+  void notify() {
+    if (sleeping_.load()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cond_.notify_one();
+    }
+  }
+
+  // 先标记睡眠再检查 ready: 生产者要么看到标记来通知, 要么它的元素在
+  // 检查时已经可见, 不会丢失唤醒
+  template <typename Ready>
+  void wait(Ready ready) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    sleeping_.store(true);
+    cond_.wait(lock, ready);
+    sleeping_.store(false);
+  }
+
+ private:
+  std::atomic<bool> sleeping_{false};
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+// 不阻塞时不占空间
+template <>
+class mpsc_waiter<false> {
+ public:
+  void notify() {}
+};
+
+// 多生产者单消费者的侵入式队列(Vyukov), 用于邮箱式的单线程消费者
+// 元素类型 T 继承 mpsc_node, 调用者负责元素的内存, 入队之后到出队之前
+// 不能销毁或者再次入队. 队列不拥有元素, 析构时不处理剩下的元素.
+//   - push: 任何线程都可以调用. 一次 exchange 把 head_ 换成新节点, 再把
+//     旧的 head_ 链接到新节点上, 没有重试循环
+//   - pop: 只由消费者调用. tail_ 是普通指针, 通常只读一次 next
+//     (acquire), 不做任何原子的读改写. 只剩最后一个元素时, 先把哑节点
+//     stub_ 重新入队, 这样取走最后一个元素之后链表也不会断开
+// 生产者在 exchange 之后、链接之前被挂起时, 它后面入队的元素都暂时不能
+// 出队, pop 返回 nullptr, 过一会再 pop 就能取到. 因此消费者不是无锁的,
+// 但 push 和 pop 都只有固定的几步.
+// Blocking 为 true 时提供 pop_wait, 队列为空时消费者睡眠, 生产者唤醒它
+template <typename T, bool Blocking = false>
+class mpsc_queue {
+  static_assert(std::is_base_of_v<mpsc_node, T>,
+                "elements are linked through their mpsc_node base");
+
+ public:
+  mpsc_queue() : head_(&stub_), tail_(&stub_) {}
+
+  mpsc_queue(mpsc_queue const&) = delete;
+  mpsc_queue& operator=(mpsc_queue const&) = delete;
+
+  void push(T* item) {
+    link(item);
+    waiter_.notify();
+  }
+
+  // 取出最早入队的元素, 没有可以取出的元素时返回 nullptr
+  T* pop() {
+    mpsc_node* tail = tail_;
+    mpsc_node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    // tail 是最后一个节点; 不是的话有生产者还没链接完
+    if (tail != head_.load()) {
+      return nullptr;
+    }
+    link(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return nullptr;
+    }
+    tail_ = next;
+    return static_cast<T*>(tail);
+  }
+
+  // 队列为空时睡眠直到有元素入队
+  T* pop_wait()
+    requires Blocking
+  {
+    for (;;) {
+      if (T* const item = pop()) {
+        return item;
+      }
+      if (!empty()) {
+        // 有生产者正在链接
+        std::this_thread::yield();
+        continue;
+      }
+      waiter_.wait([this] { return !empty(); });
+    }
+  }
+
+  // 只由消费者调用
+  bool empty() const { return tail_ == &stub_ && head_.load() == &stub_; }
+
+ private:
+  // exchange 是 seq_cst 的, 与 mpsc_waiter 里 sleeping_ 的读写一起保证
+  // 不丢失唤醒
+  void link(mpsc_node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    mpsc_node* const prev = head_.exchange(node);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // 生产者写的, 最后入队的节点
+  alignas(64) std::atomic<mpsc_node*> head_;
+  // 消费者写的, 最早入队的节点
+  alignas(64) mpsc_node* tail_;
+  mpsc_node stub_;
+  [[no_unique_address]] mpsc_waiter<Blocking> waiter_;
+
+  static_assert(std::atomic<mpsc_node*>::is_always_lock_free);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+
+#include "epoch.h"
+#include "hazard_pointer.h"
+
+// 节点回收策略, 作为 lock_free_stack/lock_free_queue 的 Reclaimer 模板参数
+//   split_reference_count    默认. 用分离引用计数决定何时删除节点, 不需要
+//                            额外的回收机制, 但每次读 head/tail 都要对共享
+//                            的计数做一次 CAS
+//   hazard_pointer_reclaimer 风险指针, 每读一个共享指针写一次槽位
+//   epoch_reclaimer          纪元, 每次操作进出一次临界区, 读指针没有开销
+// 后两种策略用普通指针链接节点, 容器的每次操作在栈上持有一个 guard:
+//   T* guard.protect(std::atomic<T*> const& src, unsigned slot)
+//       读取 src. 返回的节点在 guard 析构、或者同一个 slot 再次 protect
+//       之前不会被删除; slot 取 [0, guard::slots)
+//   void guard.reset(unsigned slot)   不再需要 slot 保护的节点
+//   static void Reclaimer::retire(T* ptr)
+//       节点已经从容器中摘下, 之后没有线程再使用时删除
+struct split_reference_count {};
+
+struct hazard_pointer_reclaimer {
+  class guard {
+   public:
+    static constexpr unsigned slots = 2;
+
+    template <typename T>
+    T* protect(std::atomic<T*> const& src, unsigned slot) {
+      return hazards_[slot].protect(src);
+    }
+
+    void reset(unsigned slot) { hazards_[slot].reset(); }
+
+   private:
+    hazard_pointer hazards_[slots];
+  };
+
+  template <typename T>
+  static void retire(T* ptr) {
+    hazard_pointer_domain::instance().retire(ptr);
+  }
+};
+
+struct epoch_reclaimer {
+  class guard {
+   public:
+    static constexpr unsigned slots = 2;
+
+    template <typename T>
+    T* protect(std::atomic<T*> const& src, unsigned) {
+      return src.load(std::memory_order_acquire);
+    }
+
+    void reset(unsigned) {}
+
+   private:
+    epoch_guard critical_section_;
+  };
+
+  template <typename T>
+  static void retire(T* ptr) {
+    epoch_domain::instance().retire(ptr);
+  }
+};
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+
+// 指针加一个计数(或 ABA 标签), 整体用一次 CAS 读写
+// 有两种表示, 编译时选择:
+//   - 压缩(默认): 64 位平台上用户态地址只用到低 48 位(x86-64 四级页表,
+//     AArch64 的默认配置), 高 16 位放计数, 整体是一个 uint64_t.
+//     开启五级页表并且会拿到 48 位以上地址的程序定义
+//     TAGGED_PTR_ADDRESS_BITS=57, 计数只剩 7 位. 32 位平台上是 32 位指针
+//     加 32 位计数. 计数超出位数时回绕, 使用者要保证它不会溢出
+//   - 双字: 定义 TAGGED_PTR_DWCAS, 或者是不认识的 64 位平台. 指针和计数
+//     各占 8 字节, 用 16 字节的 CAS. 编译器保证内联这条指令时
+//     (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16, x86-64 上要加 -mcx16) 直接用
+//     cmpxchg16b; 否则只能退回 std::atomic, 它会调用 libatomic, 可能加锁
+// atomic_tagged_ptr<T>::is_always_lock_free 表示选中的实现是否一定无锁,
+// 容器用 static_assert 检查它, 退回加锁实现时编译失败
+#if !defined(TAGGED_PTR_DWCAS) && UINTPTR_MAX == UINT64_MAX && \
+    !defined(__x86_64__) && !defined(__aarch64__)
+#define TAGGED_PTR_DWCAS
+#endif
+
+#ifndef TAGGED_PTR_ADDRESS_BITS
+#define TAGGED_PTR_ADDRESS_BITS 48
+#endif
+
+#ifndef TAGGED_PTR_DWCAS
+
+template <typename T>
+class tagged_ptr {
+ public:
+  static constexpr unsigned address_bits =
+      sizeof(T*) == 4 ? 32 : TAGGED_PTR_ADDRESS_BITS;
+  static constexpr unsigned tag_bits = 64 - address_bits;
+
+  tagged_ptr() = default;
+  tagged_ptr(T* ptr, std::uint64_t tag)
+      : bits_(address(ptr) | (tag << address_bits)) {
+    assert((address(ptr) >> address_bits) == 0);
+  }
+
+  T* ptr() const {
+    return reinterpret_cast<T*>(
+        static_cast<std::uintptr_t>(bits_ & address_mask));
+  }
+  std::uint64_t tag() const { return bits_ >> address_bits; }
+
+  // 压缩后的 64 位值
+  std::uint64_t bits() const { return bits_; }
+  static tagged_ptr from_bits(std::uint64_t bits) {
+    tagged_ptr value;
+    value.bits_ = bits;
+    return value;
+  }
+
+  bool operator==(tagged_ptr const&) const = default;
+
+ private:
+  static constexpr std::uint64_t address_mask =
+      (std::uint64_t{1} << address_bits) - 1;
+
+  static std::uint64_t address(T* ptr) {
+    return reinterpret_cast<std::uintptr_t>(ptr);
+  }
+
+  std::uint64_t bits_ = 0;
+};
+
+#else
+
+template <typename T>
+class tagged_ptr {
+ public:
+  static constexpr unsigned tag_bits = 64;
+
+  tagged_ptr() = default;
+  tagged_ptr(T* ptr, std::uint64_t tag) : ptr_(ptr), tag_(tag) {}
+
+  T* ptr() const { return ptr_; }
+  std::uint64_t tag() const { return tag_; }
+
+  bool operator==(tagged_ptr const&) const = default;
+
+ private:
+  // 两个成员都是 8 字节, 没有填充字节参与比较
+  T* ptr_ = nullptr;
+  std::uint64_t tag_ = 0;
+};
+
+#endif
+
+namespace tagged_ptr_detail {
+
+// 与 std::atomic 的单参数版本一样, 由成功时的内存序推出失败时的内存序
+constexpr std::memory_order failure_order(std::memory_order order) {
+  if (order == std::memory_order_acq_rel) {
+    return std::memory_order_acquire;
+  }
+  if (order == std::memory_order_release) {
+    return std::memory_order_relaxed;
+  }
+  return order;
+}
+
+#ifndef TAGGED_PTR_DWCAS
+
+template <typename T>
+class atomic_storage {
+ public:
+  static constexpr bool is_always_lock_free =
+      std::atomic<std::uint64_t>::is_always_lock_free;
+
+  atomic_storage() = default;
+  atomic_storage(tagged_ptr<T> value) : bits_(value.bits()) {}
+
+  tagged_ptr<T> load(
+      std::memory_order order = std::memory_order_seq_cst) const {
+    return tagged_ptr<T>::from_bits(bits_.load(order));
+  }
+
+  void store(tagged_ptr<T> value,
+             std::memory_order order = std::memory_order_seq_cst) {
+    bits_.store(value.bits(), order);
+  }
+
+  tagged_ptr<T> exchange(tagged_ptr<T> value,
+                         std::memory_order order = std::memory_order_seq_cst) {
+    return tagged_ptr<T>::from_bits(bits_.exchange(value.bits(), order));
+  }
+
+  // 成功时不写 expected: 它可能就是刚发布出去的节点里的成员
+  bool compare_exchange_weak(tagged_ptr<T>& expected, tagged_ptr<T> desired,
+                             std::memory_order success,
+                             std::memory_order failure) {
+    std::uint64_t bits = expected.bits();
+    if (bits_.compare_exchange_weak(bits, desired.bits(), success, failure)) {
+      return true;
+    }
+    expected = tagged_ptr<T>::from_bits(bits);
+    return false;
+  }
+
+  bool compare_exchange_strong(tagged_ptr<T>& expected, tagged_ptr<T> desired,
+                               std::memory_order success,
+                               std::memory_order failure) {
+    std::uint64_t bits = expected.bits();
+    if (bits_.compare_exchange_strong(bits, desired.bits(), success, failure)) {
+      return true;
+    }
+    expected = tagged_ptr<T>::from_bits(bits);
+    return false;
+  }
+
+ private:
+  std::atomic<std::uint64_t> bits_{0};
+};
+
+#elif defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+
+// __sync 系列在定义了这个宏时内联成 cmpxchg16b, 并且是完整的内存屏障,
+// 传入的内存序只会更强. 读也用一次比较交换, 避免 16 字节的读被撕裂
+template <typename T>
+class atomic_storage {
+ public:
+  static constexpr bool is_always_lock_free = true;
+
+  atomic_storage() = default;
+  atomic_storage(tagged_ptr<T> value) : word_(to_word(value)) {}
+
+  tagged_ptr<T> load(std::memory_order = std::memory_order_seq_cst) const {
+    return from_word(__sync_val_compare_and_swap(&word_, word(0), word(0)));
+  }
+
+  void store(tagged_ptr<T> value,
+             std::memory_order = std::memory_order_seq_cst) {
+    exchange(value);
+  }
+
+  tagged_ptr<T> exchange(tagged_ptr<T> value,
+                         std::memory_order = std::memory_order_seq_cst) {
+    tagged_ptr<T> expected = load();
+    while (!compare_exchange_strong(expected, value,
+                                    std::memory_order_seq_cst,
+                                    std::memory_order_seq_cst)) {
+    }
+    return expected;
+  }
+
+  bool compare_exchange_weak(tagged_ptr<T>& expected, tagged_ptr<T> desired,
+                             std::memory_order success,
+                             std::memory_order failure) {
+    return compare_exchange_strong(expected, desired, success, failure);
+  }
+
+  bool compare_exchange_strong(tagged_ptr<T>& expected, tagged_ptr<T> desired,
+                               std::memory_order, std::memory_order) {
+    word const old_word = to_word(expected);
+    word const previous =
+        __sync_val_compare_and_swap(&word_, old_word, to_word(desired));
+    if (previous == old_word) {
+      return true;
+    }
+    expected = from_word(previous);
+    return false;
+  }
+
+ private:
+  __extension__ typedef unsigned __int128 word;
+
+  static word to_word(tagged_ptr<T> value) {
+    return std::bit_cast<word>(value);
+  }
+  static tagged_ptr<T> from_word(word w) {
+    return std::bit_cast<tagged_ptr<T>>(w);
+  }
+
+  alignas(16) mutable word word_ = 0;
+};
+
+#else
+
+// 没有内联的 16 字节 CAS, is_always_lock_free 为 false
+template <typename T>
+class atomic_storage {
+ public:
+  static constexpr bool is_always_lock_free =
+      std::atomic<tagged_ptr<T>>::is_always_lock_free;
+
+  atomic_storage() = default;
+  atomic_storage(tagged_ptr<T> value) : value_(value) {}
+
+  tagged_ptr<T> load(
+      std::memory_order order = std::memory_order_seq_cst) const {
+    return value_.load(order);
+  }
+
+  void store(tagged_ptr<T> value,
+             std::memory_order order = std::memory_order_seq_cst) {
+    value_.store(value, order);
+  }
+
+  tagged_ptr<T> exchange(tagged_ptr<T> value,
+                         std::memory_order order = std::memory_order_seq_cst) {
+    return value_.exchange(value, order);
+  }
+
+  bool compare_exchange_weak(tagged_ptr<T>& expected, tagged_ptr<T> desired,
+                             std::memory_order success,
+                             std::memory_order failure) {
+    return value_.compare_exchange_weak(expected, desired, success, failure);
+  }
+
+  bool compare_exchange_strong(tagged_ptr<T>& expected, tagged_ptr<T> desired,
+                               std::memory_order success,
+                               std::memory_order failure) {
+    return value_.compare_exchange_strong(expected, desired, success,
+                                          failure);
+  }
+
+ private:
+  alignas(16) std::atomic<tagged_ptr<T>> value_;
+};
+
+#endif
+
+}  // namespace tagged_ptr_detail
+
+// 接口与 std::atomic<tagged_ptr<T>> 相同
+template <typename T>
+class atomic_tagged_ptr : public tagged_ptr_detail::atomic_storage<T> {
+  using base = tagged_ptr_detail::atomic_storage<T>;
+
+ public:
+  using base::base;
+  using base::compare_exchange_strong;
+  using base::compare_exchange_weak;
+
+  atomic_tagged_ptr(atomic_tagged_ptr const&) = delete;
+  atomic_tagged_ptr& operator=(atomic_tagged_ptr const&) = delete;
+
+  bool compare_exchange_weak(
+      tagged_ptr<T>& expected, tagged_ptr<T> desired,
+      std::memory_order order = std::memory_order_seq_cst) {
+    return base::compare_exchange_weak(
+        expected, desired, order, tagged_ptr_detail::failure_order(order));
+  }
+
+  bool compare_exchange_strong(
+      tagged_ptr<T>& expected, tagged_ptr<T> desired,
+      std::memory_order order = std::memory_order_seq_cst) {
+    return base::compare_exchange_strong(
+        expected, desired, order, tagged_ptr_detail::failure_order(order));
+  }
+};
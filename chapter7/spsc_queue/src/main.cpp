@@ -0,0 +1,302 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.h"
+
+// 基本功能: 容量取整, 满和空, FIFO 顺序
+void test_basic_operations() {
+  std::cout << "=== 基本功能测试 ===" << std::endl;
+
+  spsc_queue<int> queue(5);
+  assert(queue.capacity() == 8);
+  assert(queue.empty());
+
+  int value = 0;
+  assert(!queue.try_pop(value));
+  for (int i = 0; i < 8; ++i) {
+    assert(queue.try_push(i));
+  }
+  assert(!queue.try_push(8));
+  assert(queue.size_approx() == 8);
+  std::cout << "✓ 容量取整到 2 的幂, 满了之后 push 失败" << std::endl;
+
+  for (int i = 0; i < 8; ++i) {
+    assert(queue.try_pop(value) && value == i);
+  }
+  assert(!queue.try_pop(value));
+  assert(queue.empty());
+  std::cout << "✓ FIFO 顺序正确" << std::endl;
+
+  // 下标绕过缓冲区末尾很多圈
+  for (int i = 0; i < 1000; ++i) {
+    assert(queue.try_push(i) && queue.try_push(i + 1));
+    assert(queue.try_pop(value) && value == i);
+    assert(queue.try_pop(value) && value == i + 1);
+  }
+  std::cout << "✓ 环绕之后顺序正确" << std::endl;
+}
+
+// push_n / pop_n 只搬运放得下 / 取得到的部分
+void test_batch_operations() {
+  std::cout << "=== 批量操作测试 ===" << std::endl;
+
+  spsc_queue<int> queue(16);
+  std::vector<int> input(20);
+  for (int i = 0; i < 20; ++i) {
+    input[i] = i;
+  }
+  assert(queue.push_n(input.begin(), 10) == 10);
+  assert(queue.push_n(input.begin() + 10, 10) == 6);
+  assert(queue.push_n(input.begin(), 1) == 0);
+
+  std::vector<int> output(20, -1);
+  assert(queue.pop_n(output.begin(), 4) == 4);
+  assert(queue.pop_n(output.begin() + 4, 20) == 12);
+  assert(queue.pop_n(output.begin(), 1) == 0);
+  for (int i = 0; i < 16; ++i) {
+    assert(output[i] == i);
+  }
+  std::cout << "✓ 部分放入和部分取出的个数与顺序正确" << std::endl;
+
+  // 批量操作跨过缓冲区末尾
+  for (int round = 0; round < 100; ++round) {
+    assert(queue.push_n(input.begin() + round % 7, 11) == 11);
+    assert(queue.pop_n(output.begin(), 11) == 11);
+    for (int i = 0; i < 11; ++i) {
+      assert(output[i] == round % 7 + i);
+    }
+  }
+  std::cout << "✓ 跨过缓冲区末尾的批量操作正确" << std::endl;
+}
+
+// 统计存活的对象个数
+struct Tracked {
+  static inline std::atomic<int> alive{0};
+  int value;
+
+  explicit Tracked(int v = 0) : value(v) { ++alive; }
+  Tracked(Tracked const& other) : value(other.value) { ++alive; }
+  Tracked(Tracked&& other) noexcept : value(other.value) { ++alive; }
+  Tracked& operator=(Tracked const&) = default;
+  Tracked& operator=(Tracked&&) = default;
+  ~Tracked() { --alive; }
+};
+
+// 只能移动的元素, 以及出队和析构时元素都被销毁
+void test_element_lifetime() {
+  std::cout << "=== 元素的生命周期 ===" << std::endl;
+  {
+    spsc_queue<std::unique_ptr<int>> queue(4);
+    assert(queue.try_emplace(std::make_unique<int>(1)));
+    assert(queue.try_push(std::make_unique<int>(2)));
+    std::unique_ptr<int> out;
+    assert(queue.try_pop(out) && *out == 1);
+    assert(queue.try_pop(out) && *out == 2);
+  }
+  std::cout << "✓ 只能移动的元素可以放入和取出" << std::endl;
+
+  {
+    spsc_queue<Tracked> queue(64);
+    for (int i = 0; i < 50; ++i) {
+      assert(queue.try_emplace(i));
+    }
+    assert(Tracked::alive.load() == 50);
+    std::vector<Tracked> out(10);
+    assert(queue.pop_n(out.begin(), 10) == 10);
+    Tracked single;
+    assert(queue.try_pop(single) && single.value == 10);
+    assert(Tracked::alive.load() == 39 + 10 + 1);
+  }
+  assert(Tracked::alive.load() == 0);
+  std::cout << "✓ 出队和析构时元素都被销毁" << std::endl;
+}
+
+// 一个生产者和一个消费者, 消费者按顺序收到每一个值.
+// batch 为 0 时逐个操作, 否则用 push_n / pop_n 每次最多 batch 个
+bool run_pipeline(std::size_t capacity, long long items, std::size_t batch) {
+  spsc_queue<long long> queue(capacity);
+  std::atomic<bool> ordered{true};
+
+  std::thread producer([&] {
+    if (batch == 0) {
+      for (long long i = 0; i < items; ++i) {
+        while (!queue.try_push(i)) {
+          std::this_thread::yield();
+        }
+      }
+      return;
+    }
+    std::vector<long long> chunk(batch);
+    for (long long i = 0; i < items;) {
+      std::size_t const n =
+          static_cast<std::size_t>(std::min<long long>(batch, items - i));
+      for (std::size_t k = 0; k < n; ++k) {
+        chunk[k] = i + static_cast<long long>(k);
+      }
+      std::size_t sent = 0;
+      while (sent < n) {
+        std::size_t const pushed = queue.push_n(chunk.begin() + sent, n - sent);
+        if (pushed == 0) {
+          std::this_thread::yield();
+        }
+        sent += pushed;
+      }
+      i += static_cast<long long>(n);
+    }
+  });
+
+  std::thread consumer([&] {
+    long long expected = 0;
+    std::vector<long long> chunk(batch == 0 ? 1 : batch);
+    while (expected < items) {
+      std::size_t n = 0;
+      if (batch == 0) {
+        n = queue.try_pop(chunk[0]) ? 1 : 0;
+      } else {
+        n = queue.pop_n(chunk.begin(), batch);
+      }
+      if (n == 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (std::size_t k = 0; k < n; ++k) {
+        if (chunk[k] != expected++) {
+          ordered.store(false);
+        }
+      }
+    }
+  });
+
+  producer.join();
+  consumer.join();
+  return ordered.load() && queue.empty();
+}
+
+void test_single_producer_single_consumer() {
+  std::cout << "=== 单生产者单消费者测试 ===" << std::endl;
+  const long long items = 200000;
+  assert(run_pipeline(2, items, 0));
+  assert(run_pipeline(1024, items, 0));
+  std::cout << "✓ 逐个操作时每个值按顺序收到" << std::endl;
+  assert(run_pipeline(8, items, 3));
+  assert(run_pipeline(1024, items, 64));
+  std::cout << "✓ 批量操作时每个值按顺序收到" << std::endl;
+}
+
+// 对比用: 互斥量保护的 std::queue, 代表 MPMC 队列在 SPSC 场景下的开销
+template <typename T>
+class locked_queue {
+ public:
+  bool try_push(T value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push(std::move(value));
+    return true;
+  }
+
+  bool try_pop(T& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty()) {
+      return false;
+    }
+    value = std::move(queue_.front());
+    queue_.pop();
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::queue<T> queue_;
+};
+
+// 一个生产者和一个消费者传递 items 个值, 返回每秒传递的个数
+template <typename Run>
+double transfer_rate(long long items, Run run) {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  run();
+  auto end_time = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      end_time - start_time);
+  return items * 1000000.0 / std::max<long long>(duration.count(), 1);
+}
+
+void test_performance() {
+  std::cout << "=== 性能测试(单生产者单消费者, 值/秒) ===" << std::endl;
+  const long long items = 2000000;
+  const std::size_t capacity = 4096;
+
+  double const locked = transfer_rate(items, [&] {
+    locked_queue<long long> queue;
+    std::thread producer([&] {
+      for (long long i = 0; i < items; ++i) {
+        queue.try_push(i);
+      }
+    });
+    long long value = 0;
+    for (long long received = 0; received < items;) {
+      if (queue.try_pop(value)) {
+        ++received;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    producer.join();
+  });
+
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << "  互斥量 + std::queue: " << locked << std::endl;
+  for (std::size_t batch : {0, 16, 256}) {
+    bool ok = false;
+    double const rate = transfer_rate(
+        items, [&] { ok = run_pipeline(capacity, items, batch); });
+    assert(ok);
+    if (batch == 0) {
+      std::cout << "  spsc_queue 逐个操作: ";
+    } else {
+      std::cout << "  spsc_queue 每批 " << batch << " 个: ";
+    }
+    std::cout << rate << " (x" << std::setprecision(2) << rate / locked << ")"
+              << std::setprecision(0) << std::endl;
+  }
+  std::cout.unsetf(std::ios::fixed);
+  std::cout << std::setprecision(6);
+}
+
+int main() {
+  std::cout << "开始 spsc_queue 测试..." << std::endl;
+  std::cout << "硬件并发数: " << std::thread::hardware_concurrency()
+            << std::endl;
+  std::cout << std::endl;
+
+  try {
+    test_basic_operations();
+    std::cout << std::endl;
+
+    test_batch_operations();
+    std::cout << std::endl;
+
+    test_element_lifetime();
+    std::cout << std::endl;
+
+    test_single_producer_single_consumer();
+    std::cout << std::endl;
+
+    test_performance();
+    std::cout << std::endl;
+
+    std::cout << "🎉 所有测试通过！spsc_queue 工作正常。" << std::endl;
+
+  } catch (const std::exception& e) {
+    std::cerr << "❌ 测试失败: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+// 单生产者单消费者的有界环形缓冲区, 每个操作都在有限步内完成(wait-free)
+// 只有一个线程 push, 一个线程 pop 时, 不需要 CAS 也不需要锁:
+//   - tail_ 只由生产者写, head_ 只由消费者写. 写入方用 release 发布,
+//     另一方用 acquire 读取, 元素的构造和销毁都在发布之前完成
+//   - 下标一直递增, 用 & mask_ 取槽位; tail_ - head_ 就是元素个数,
+//     容量的每个槽位都可以用上
+//   - 生产者缓存一份 head_(cached_head_), 只有缓存显示队列满了才重新
+//     读 head_; 消费者同样缓存 tail_. 大多数操作不读对方的缓存行
+//   - head_ 和 tail_ 以及各自的缓存分别独占缓存行, 两个线程不会互相
+//     让对方的缓存行失效. 对象本身也按缓存行对齐, 后面的对象不会和
+//     head_ 共用缓存行
+// push_n / pop_n 一次搬运多个元素, 只发布一次下标.
+// 多个生产者或者多个消费者同时使用是未定义的
+template <typename T>
+class alignas(64) spsc_queue {
+ public:
+  // 容量向上取整到 2 的幂
+  explicit spsc_queue(std::size_t capacity)
+      : mask_(std::bit_ceil(capacity < 2 ? 2 : capacity) - 1),
+        buffer_(static_cast<T*>(::operator new(
+            (mask_ + 1) * sizeof(T), std::align_val_t{alignof(T)}))) {}
+
+  spsc_queue(spsc_queue const&) = delete;
+  spsc_queue& operator=(spsc_queue const&) = delete;
+
+  ~spsc_queue() {
+    std::size_t const tail = tail_.load(std::memory_order_acquire);
+    for (std::size_t i = head_.load(std::memory_order_relaxed); i != tail;
+         ++i) {
+      std::destroy_at(&buffer_[i & mask_]);
+    }
+    ::operator delete(buffer_, std::align_val_t{alignof(T)});
+  }
+
+  std::size_t capacity() const { return mask_ + 1; }
+
+  // 只由生产者调用. 队列满时返回 false
+  bool try_push(T const& value) { return try_emplace(value); }
+  bool try_push(T&& value) { return try_emplace(std::move(value)); }
+
+  template <typename... Args>
+  bool try_emplace(Args&&... args) {
+    std::size_t const tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == capacity()) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == capacity()) {
+        return false;
+      }
+    }
+    std::construct_at(&buffer_[tail & mask_], std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 只由生产者调用. 从 first 开始复制最多 count 个元素, 返回放入的个数.
+  // 复制抛出异常时, 已经放入的元素保留在队列里
+  template <typename InputIt>
+  std::size_t push_n(InputIt first, std::size_t count) {
+    std::size_t const tail = tail_.load(std::memory_order_relaxed);
+    if (capacity() - (tail - cached_head_) < count) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+    }
+    std::size_t const n =
+        std::min(count, capacity() - (tail - cached_head_));
+    std::size_t i = 0;
+    try {
+      for (; i < n; ++i, ++first) {
+        std::construct_at(&buffer_[(tail + i) & mask_], *first);
+      }
+    } catch (...) {
+      tail_.store(tail + i, std::memory_order_release);
+      throw;
+    }
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // 只由消费者调用. 把队首元素移动赋值给 value, 队列为空时返回 false.
+  // 移动赋值抛出异常时元素留在队列里
+  bool try_pop(T& value) {
+    std::size_t const head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    T& front = buffer_[head & mask_];
+    value = std::move(front);
+    std::destroy_at(&front);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 只由消费者调用. 最多取出 count 个元素依次移动赋值给 *out++,
+  // 返回取出的个数. 移动赋值抛出异常时, 已经取出的元素出队
+  template <typename OutputIt>
+  std::size_t pop_n(OutputIt out, std::size_t count) {
+    std::size_t const head = head_.load(std::memory_order_relaxed);
+    if (cached_tail_ - head < count) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+    }
+    std::size_t const n = std::min(count, cached_tail_ - head);
+    std::size_t i = 0;
+    try {
+      for (; i < n; ++i, ++out) {
+        T& front = buffer_[(head + i) & mask_];
+        *out = std::move(front);
+        std::destroy_at(&front);
+      }
+    } catch (...) {
+      head_.store(head + i, std::memory_order_release);
+      throw;
+    }
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // 另一方同时在操作时只是一个近似值. 先读 head_, 结果不会是负数
+  std::size_t size_approx() const {
+    std::size_t const head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+  bool empty() const { return size_approx() == 0; }
+
+ private:
+  // 两个线程都只读
+  std::size_t const mask_;
+  T* const buffer_;
+
+  // 生产者写的
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::size_t cached_head_ = 0;
+
+  // 消费者写的
+  alignas(64) std::atomic<std::size_t> head_{0};
+  std::size_t cached_tail_ = 0;
+
+  static_assert(std::atomic<std::size_t>::is_always_lock_free);
+};
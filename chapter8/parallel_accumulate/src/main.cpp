@@ -3,41 +3,70 @@
 #include <exception>
 #include <future>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <memory>
 #include <numeric>
 #include <system_error>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
-// 使用RAII来管理线程的join
-class join_threads {
- public:
-  explicit join_threads(std::vector<std::thread>& threads_)
-      : threads(threads_) {}
-  ~join_threads() {
-    for (unsigned long i = 0; i < threads.size(); ++i) {
-      if (threads[i].joinable()) threads[i].join();
-    }
-  }
+#include "executor.h"
+#include "grain_controller.h"
+#include "join_threads.h"  // 使用RAII来管理线程的join
+#include "simd_kernels.h"
+#include "thread_pool.h"
 
- private:
-  std::vector<std::thread>& threads;
-};
+// 连续内存上的 int/float/double 可以直接交给向量化内核
+template <typename Iterator, typename T>
+inline constexpr bool use_simd_kernel_v =
+    std::contiguous_iterator<Iterator> && simd::is_vectorizable_v<T> &&
+    std::is_same_v<std::iter_value_t<Iterator>, T>;
 
 // 使用函数对象可以获得更好的复用性
 template <typename Iterator, typename T>
 struct accumulate_block {
   T operator()(Iterator first, Iterator last) {
-    return std::accumulate(first, last, T());
+    if constexpr (use_simd_kernel_v<Iterator, T>) {
+      return simd::sum(std::to_address(first),
+                       static_cast<std::size_t>(last - first), T());
+    } else {
+      return std::accumulate(first, last, T());
+    }
+  }
+};
+
+template <typename Iterator1, typename Iterator2, typename T>
+struct inner_product_block {
+  T operator()(Iterator1 first1, Iterator1 last1, Iterator2 first2) {
+    if constexpr (use_simd_kernel_v<Iterator1, T> &&
+                  use_simd_kernel_v<Iterator2, T>) {
+      return simd::dot(std::to_address(first1), std::to_address(first2),
+                       static_cast<std::size_t>(last1 - first1), T());
+    } else {
+      return std::inner_product(first1, last1, first2, T());
+    }
   }
 };
 
 template <typename Iterator, typename T>
 T parallel_accumulate(Iterator first, Iterator last, T init) {
-  unsigned long const length = std::distance(first, last);
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_accumulate",
+                           accumulate_block<Iterator, T>>();
+  // 第一次使用时先在调用线程上累加一段前缀, 测量每个元素的开销
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        init += accumulate_block<Iterator, T>()(begin, end);
+      });
+  std::advance(first, sampled);
+  length -= sampled;
   if (length == 0) {
     return init;
   }
-  unsigned long const min_per_thread = 25;
+  unsigned long const min_per_thread = grains.grain();
   unsigned long const max_threads =
       (length + min_per_thread - 1) / min_per_thread;
   unsigned long const hardware_threads = std::thread::hardware_concurrency();
@@ -61,7 +90,9 @@ T parallel_accumulate(Iterator first, Iterator last, T init) {
     threads[i] = std::thread(std::move(task), block_start, block_end);
     block_start = block_end;
   }
+  chunk_timer timer(grains, length - (num_threads - 1) * block_size);
   T last_result = accumulate_block<Iterator, T>()(block_start, last);
+  timer.stop();
 
   T result = init;
   for (unsigned long i = 0; i < (num_threads - 1); ++i) {
@@ -72,6 +103,180 @@ T parallel_accumulate(Iterator first, Iterator last, T init) {
   return result;
 }  // join_threads RAII对象会在函数结束时自动join所有线程，无需手动join
 
+template <typename Iterator1, typename Iterator2, typename T>
+T parallel_inner_product(Iterator1 first1, Iterator1 last1, Iterator2 first2,
+                         T init) {
+  unsigned long length = std::distance(first1, last1);
+  grain_controller& grains =
+      grain_controller_for<"parallel_inner_product",
+                           inner_product_block<Iterator1, Iterator2, T>>();
+  unsigned long const sampled =
+      grains.calibrate(first1, length, [&](Iterator1 begin, Iterator1 end) {
+        init += inner_product_block<Iterator1, Iterator2, T>()(begin, end,
+                                                               first2);
+        std::advance(first2, std::distance(begin, end));
+      });
+  std::advance(first1, sampled);
+  length -= sampled;
+  if (length == 0) {
+    return init;
+  }
+  unsigned long const min_per_thread = grains.grain();
+  unsigned long const max_threads =
+      (length + min_per_thread - 1) / min_per_thread;
+  unsigned long const hardware_threads = std::thread::hardware_concurrency();
+  unsigned long const num_threads =
+      std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
+  unsigned long const block_size = length / num_threads;
+
+  std::vector<std::future<T>> futures(num_threads - 1);
+  std::vector<std::thread> threads(num_threads - 1);
+  join_threads joiner(threads);
+
+  Iterator1 block_start = first1;
+  Iterator2 block_start2 = first2;
+  for (unsigned long i = 0; i < (num_threads - 1); ++i) {
+    Iterator1 block_end = block_start;
+    std::advance(block_end, block_size);
+    std::packaged_task<T(Iterator1, Iterator1, Iterator2)> task{
+        inner_product_block<Iterator1, Iterator2, T>()};
+    futures[i] = task.get_future();
+    threads[i] =
+        std::thread(std::move(task), block_start, block_end, block_start2);
+    block_start = block_end;
+    std::advance(block_start2, block_size);
+  }
+  chunk_timer timer(grains, length - (num_threads - 1) * block_size);
+  T last_result = inner_product_block<Iterator1, Iterator2, T>()(
+      block_start, last1, block_start2);
+  timer.stop();
+
+  T result = init;
+  for (unsigned long i = 0; i < (num_threads - 1); ++i) {
+    result += futures[i].get();
+  }
+  result += last_result;
+
+  return result;
+}
+
+// 执行器版本: 块交给常驻线程执行, 调用线程也处理其中一块, 不创建任何线程
+template <typename Executor, typename Iterator, typename T>
+T parallel_accumulate(Executor& executor, Iterator first, Iterator last,
+                      T init) {
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_accumulate",
+                           accumulate_block<Iterator, T>>();
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        init += accumulate_block<Iterator, T>()(begin, end);
+      });
+  std::advance(first, sampled);
+  length -= sampled;
+  if (length == 0) {
+    return init;
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  std::vector<Iterator> const bounds = block_bounds(first, length, num_blocks);
+  std::vector<T> results(num_blocks);
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    chunk_timer timer(grains, block_length(length, num_blocks, i));
+    results[i] = accumulate_block<Iterator, T>()(bounds[i], bounds[i + 1]);
+  });
+
+  T result = init;
+  for (T const& block_result : results) {
+    result += block_result;
+  }
+  return result;
+}
+
+// 前向/双向迭代器: 不预先计算长度, 遍历区间的同时把切好的块交给执行器
+template <typename Executor, typename Iterator, typename T>
+  requires(!std::random_access_iterator<Iterator>)
+T parallel_accumulate(Executor& executor, Iterator first, Iterator last,
+                      T init) {
+  grain_controller& grains =
+      grain_controller_for<"parallel_accumulate",
+                           accumulate_block<Iterator, T>>();
+  unsigned long const sampled =
+      grains.calibrate(first, last, [&](Iterator begin, Iterator end) {
+        init += accumulate_block<Iterator, T>()(begin, end);
+      });
+  std::advance(first, sampled);
+  std::vector<T> const results = run_forward_blocks(
+      executor, first, last, grains.grain(),
+      [&](Iterator begin, Iterator end, unsigned long n) {
+        chunk_timer timer(grains, n);
+        return accumulate_block<Iterator, T>()(begin, end);
+      });
+
+  T result = init;
+  for (T const& block_result : results) {
+    result += block_result;
+  }
+  return result;
+}
+
+template <typename Executor, typename Iterator1, typename Iterator2,
+          typename T>
+T parallel_inner_product(Executor& executor, Iterator1 first1,
+                         Iterator1 last1, Iterator2 first2, T init) {
+  unsigned long length = std::distance(first1, last1);
+  grain_controller& grains =
+      grain_controller_for<"parallel_inner_product",
+                           inner_product_block<Iterator1, Iterator2, T>>();
+  unsigned long const sampled =
+      grains.calibrate(first1, length, [&](Iterator1 begin, Iterator1 end) {
+        init += inner_product_block<Iterator1, Iterator2, T>()(begin, end,
+                                                               first2);
+        std::advance(first2, std::distance(begin, end));
+      });
+  std::advance(first1, sampled);
+  length -= sampled;
+  if (length == 0) {
+    return init;
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  std::vector<Iterator1> const bounds1 =
+      block_bounds(first1, length, num_blocks);
+  std::vector<Iterator2> const bounds2 =
+      block_bounds(first2, length, num_blocks);
+  std::vector<T> results(num_blocks);
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    chunk_timer timer(grains, block_length(length, num_blocks, i));
+    results[i] = inner_product_block<Iterator1, Iterator2, T>()(
+        bounds1[i], bounds1[i + 1], bounds2[i]);
+  });
+
+  T result = init;
+  for (T const& block_result : results) {
+    result += block_result;
+  }
+  return result;
+}
+
+// 单线程对比各 ISA 内核, 以 GB/s 衡量是否达到内存带宽
+template <typename T, typename Kernel>
+void benchmark_kernel(const char* name, std::size_t bytes, Kernel kernel) {
+  for (simd::isa level :
+       {simd::isa::scalar, simd::isa::avx2, simd::isa::avx512}) {
+    if (level > simd::detect_isa()) {
+      continue;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    T result = kernel(level);
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "  " << name << " [" << simd::isa_name(level)
+              << "]: result " << result << ", "
+              << bytes / seconds / 1e9 << " GB/s" << std::endl;
+  }
+}
+
 int main() {
   try {
     std::vector<int> data(10000000, 1);  // 1000万个元素，每个都是1
@@ -106,6 +311,131 @@ int main() {
       std::cout << "result validation: incorrect" << std::endl;
     }
 
+    // 请求处理中常见的大量小调用: 每次创建线程 vs 复用常驻线程
+    std::cout << "\n--- Many small calls (10000 x 10000 elements) ---"
+              << std::endl;
+    thread_pool pool;
+    pool_executor<thread_pool> pool_exec(pool);
+    inline_executor inline_exec;
+    std::vector<int> small(10000, 1);
+    auto time_calls = [&](const char* name, auto call) {
+      int checksum = 0;
+      auto call_start = std::chrono::high_resolution_clock::now();
+      for (int i = 0; i < 10000; ++i) {
+        checksum += call();
+      }
+      auto call_end = std::chrono::high_resolution_clock::now();
+      std::cout << name << ": "
+                << std::chrono::duration_cast<std::chrono::microseconds>(
+                       call_end - call_start)
+                       .count()
+                << " microseconds, "
+                << (checksum == 10000 * 10000 ? "correct" : "incorrect")
+                << std::endl;
+    };
+    time_calls("thread per call", [&] {
+      return parallel_accumulate(small.begin(), small.end(), 0);
+    });
+    time_calls("pool_executor", [&] {
+      return parallel_accumulate(pool_exec, small.begin(), small.end(), 0);
+    });
+    time_calls("inline_executor", [&] {
+      return parallel_accumulate(inline_exec, small.begin(), small.end(), 0);
+    });
+
+    // 链表上的单遍切分: 调用线程遍历的同时工作线程已经开始累加
+    std::cout << "\n--- std::list (2000000 elements) ---" << std::endl;
+    std::list<int> list(2000000, 1);
+    auto list_start = std::chrono::high_resolution_clock::now();
+    int list_std = std::accumulate(list.begin(), list.end(), 0);
+    auto list_end = std::chrono::high_resolution_clock::now();
+    std::cout << "std::accumulate time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     list_end - list_start)
+                     .count()
+              << " microseconds" << std::endl;
+    list_start = std::chrono::high_resolution_clock::now();
+    int list_parallel =
+        parallel_accumulate(pool_exec, list.begin(), list.end(), 0);
+    list_end = std::chrono::high_resolution_clock::now();
+    std::cout << "parallel_accumulate (pool_executor) time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     list_end - list_start)
+                     .count()
+              << " microseconds, "
+              << (list_std == list_parallel ? "correct" : "incorrect")
+              << std::endl;
+    // 没有帮手时调用线程在遍历的同时执行每一块
+    int const list_inline =
+        parallel_accumulate(inline_exec, list.begin(), list.end(), 0);
+    std::cout << "parallel_accumulate (inline_executor): "
+              << (list_std == list_inline ? "correct" : "incorrect")
+              << std::endl;
+
+    std::cout << "\n--- SIMD kernels (detected: "
+              << simd::isa_name(simd::detect_isa()) << ") ---" << std::endl;
+    std::vector<float> fdata(data.size());
+    std::vector<double> ddata(data.size());
+    for (std::size_t i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<int>(i % 1000) - 500;
+      fdata[i] = static_cast<float>(i % 1000) * 0.5f;
+      ddata[i] = static_cast<double>(i % 1000) * 0.25;
+    }
+    std::size_t const n = data.size();
+    benchmark_kernel<int>("sum<int>", n * sizeof(int), [&](simd::isa l) {
+      return simd::sum(data.data(), n, 0, l);
+    });
+    benchmark_kernel<float>("sum<float>", n * sizeof(float),
+                            [&](simd::isa l) {
+                              return simd::sum(fdata.data(), n, 0.0f, l);
+                            });
+    benchmark_kernel<double>("sum<double>", n * sizeof(double),
+                             [&](simd::isa l) {
+                               return simd::sum(ddata.data(), n, 0.0, l);
+                             });
+    benchmark_kernel<int>("min<int>", n * sizeof(int), [&](simd::isa l) {
+      return simd::reduce_min(data.data(), n, l);
+    });
+    benchmark_kernel<double>("max<double>", n * sizeof(double),
+                             [&](simd::isa l) {
+                               return simd::reduce_max(ddata.data(), n, l);
+                             });
+    benchmark_kernel<double>("dot<double>", 2 * n * sizeof(double),
+                             [&](simd::isa l) {
+                               return simd::dot(ddata.data(), ddata.data(), n,
+                                                0.0, l);
+                             });
+
+    int expected_sum = std::accumulate(data.begin(), data.end(), 0);
+    int expected_min = *std::min_element(data.begin(), data.end());
+    double expected_max = *std::max_element(ddata.begin(), ddata.end());
+    // 全部元素的平方和约 8.3e11, 超出 int, 用 long long 累加(标量路径);
+    // int 的向量化内核只在前 20000 个元素上检查, 平方和约 1.7e9
+    long long const expected_dot =
+        std::inner_product(data.begin(), data.end(), data.begin(), 0LL);
+    auto const dot_end = data.begin() + 20000;
+    int const expected_int_dot =
+        std::inner_product(data.begin(), dot_end, data.begin(), 0);
+    bool kernels_correct =
+        parallel_accumulate(data.begin(), data.end(), 0) == expected_sum &&
+        simd::reduce_min(data.data(), n) == expected_min &&
+        simd::reduce_max(ddata.data(), n) == expected_max &&
+        parallel_inner_product(data.begin(), data.end(), data.begin(), 0LL) ==
+            expected_dot &&
+        parallel_inner_product(data.begin(), dot_end, data.begin(), 0) ==
+            expected_int_dot &&
+        parallel_accumulate(pool_exec, data.begin(), data.end(), 0) ==
+            expected_sum &&
+        parallel_inner_product(pool_exec, data.begin(), data.end(),
+                               data.begin(), 0LL) == expected_dot &&
+        parallel_inner_product(pool_exec, data.begin(), dot_end, data.begin(),
+                               0) == expected_int_dot;
+    std::cout << "kernel validation: "
+              << (kernels_correct ? "correct" : "incorrect") << std::endl;
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
+
   } catch (const std::system_error& e) {
     std::cerr << "thread create failed, " << e.what() << std::endl;
     return 1;
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+
+// 并行流压缩(stream compaction): parallel_copy_if, parallel_partition_copy,
+// parallel_remove_if, parallel_unique. 输出顺序与标准库一样是稳定的
+// 三遍完成:
+//   1. 计数: 每块对每个元素求一次谓词, 把结果存进标志数组, 并统计保留的个数
+//   2. 前缀和: 对每块的计数求前缀和, 得到每块在输出中的起始位置
+//   3. 分散: 每块把保留的元素写到自己的位置上, 块之间的输出互不重叠
+// 谓词只求一次值, 开销大的谓词不用算两遍, 代价是每个元素一个字节的标志
+// 原地版本(remove_if/unique)不能直接分散: 后一块的目标位置可能还是前一块
+// 没读到的元素. 所以先分散到临时缓冲区, 再并行移回原处;
+// 开头一个元素都没删掉的块不用移动, 也不占用缓冲区
+namespace compaction_detail {
+
+struct compaction_plan {
+  std::vector<unsigned long> bounds;   // 每块在输入中的起始位置, 多一个结尾
+  std::vector<unsigned long> offsets;  // 每块在输出中的起始位置, 多一个结尾
+  std::vector<unsigned char> keep;     // 每个元素是否保留
+
+  std::size_t blocks() const { return bounds.size() - 1; }
+  unsigned long kept() const { return offsets.back(); }
+};
+
+// 第一遍和第二遍. keep(i) 返回第 i 个元素是否保留
+// 第一次使用时调用线程先计算一段前缀的标志来校准 grain, 前缀单独作为一块
+template <typename Executor, typename Iterator, typename Keep>
+compaction_plan plan_compaction(Executor& executor, grain_controller& grains,
+                                Iterator first, unsigned long length,
+                                Keep const& keep) {
+  compaction_plan plan;
+  plan.keep.resize(length);
+  auto mark = [&](unsigned long begin, unsigned long end) {
+    unsigned long count = 0;
+    for (unsigned long i = begin; i != end; ++i) {
+      plan.keep[i] = keep(i) ? 1 : 0;
+      count += plan.keep[i];
+    }
+    return count;
+  };
+
+  std::vector<unsigned long> counts;
+  plan.bounds.push_back(0);
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        unsigned long const b = begin - first;
+        unsigned long const n = mark(b, b + (end - begin));
+        if (counts.empty()) {
+          counts.push_back(0);
+        }
+        counts[0] += n;
+      });
+  if (sampled != 0) {
+    plan.bounds.push_back(sampled);
+  }
+  unsigned long const rest = length - sampled;
+  if (rest != 0) {
+    unsigned long const num_blocks =
+        block_count_for(executor, rest, grains.grain());
+    for (unsigned long i = 1; i <= num_blocks; ++i) {
+      plan.bounds.push_back(sampled + rest * i / num_blocks);
+    }
+    counts.resize(plan.blocks());
+    std::size_t const skip = sampled != 0 ? 1 : 0;
+    run_blocks(executor, num_blocks, [&](std::size_t i) {
+      unsigned long const begin = plan.bounds[skip + i];
+      unsigned long const end = plan.bounds[skip + i + 1];
+      chunk_timer timer(grains, end - begin);
+      counts[skip + i] = mark(begin, end);
+    });
+  }
+
+  plan.offsets.resize(plan.bounds.size());
+  plan.offsets[0] = 0;
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    plan.offsets[i + 1] = plan.offsets[i] + counts[i];
+  }
+  return plan;
+}
+
+// 原地压缩 [first, first + length), 返回保留部分的结尾
+template <typename Executor, typename Iterator>
+Iterator compact_in_place(Executor& executor, compaction_plan const& plan,
+                          Iterator first) {
+  using value_type = std::iter_value_t<Iterator>;
+  // 保留了全部元素的前几块已经就位
+  std::size_t start_block = 0;
+  while (start_block != plan.blocks() &&
+         plan.offsets[start_block + 1] == plan.bounds[start_block + 1]) {
+    ++start_block;
+  }
+  unsigned long const start = plan.offsets[start_block];
+  unsigned long const moved = plan.kept() - start;
+  if (moved == 0) {
+    return first + plan.kept();
+  }
+  // 平凡类型不会被初始化, 只是申请内存
+  std::unique_ptr<value_type[]> const buffer =
+      std::make_unique_for_overwrite<value_type[]>(moved);
+  std::size_t const blocks = plan.blocks() - start_block;
+  run_blocks(executor, blocks, [&](std::size_t b) {
+    std::size_t const i = start_block + b;
+    value_type* dest = buffer.get() + (plan.offsets[i] - start);
+    for (unsigned long j = plan.bounds[i]; j != plan.bounds[i + 1]; ++j) {
+      if (plan.keep[j]) {
+        *dest++ = std::move(first[j]);
+      }
+    }
+  });
+  run_blocks(executor, blocks, [&](std::size_t b) {
+    unsigned long const begin = moved * b / blocks;
+    unsigned long const end = moved * (b + 1) / blocks;
+    std::move(buffer.get() + begin, buffer.get() + end,
+              first + (start + begin));
+  });
+  return first + plan.kept();
+}
+
+}  // namespace compaction_detail
+
+template <typename Executor, typename Iterator, typename OutputIt,
+          typename Predicate>
+  requires(std::random_access_iterator<Iterator> &&
+           std::random_access_iterator<OutputIt>)
+OutputIt parallel_copy_if(Executor& executor, Iterator first, Iterator last,
+                          OutputIt d_first, Predicate pred) {
+  using namespace compaction_detail;
+  grain_controller& grains =
+      grain_controller_for<"parallel_copy_if", Iterator, Predicate>();
+  compaction_plan const plan = plan_compaction(
+      executor, grains, first, std::distance(first, last),
+      [&](unsigned long i) { return static_cast<bool>(pred(first[i])); });
+  // 分散时复制而不是移动, 输入保持不变
+  run_blocks(executor, plan.blocks(), [&](std::size_t i) {
+    OutputIt dest = d_first + plan.offsets[i];
+    for (unsigned long j = plan.bounds[i]; j != plan.bounds[i + 1]; ++j) {
+      if (plan.keep[j]) {
+        *dest++ = first[j];
+      }
+    }
+  });
+  return d_first + plan.kept();
+}
+
+// 满足 pred 的元素复制到 d_true, 其余复制到 d_false, 返回两个输出的结尾
+template <typename Executor, typename Iterator, typename OutputIt1,
+          typename OutputIt2, typename Predicate>
+  requires(std::random_access_iterator<Iterator> &&
+           std::random_access_iterator<OutputIt1> &&
+           std::random_access_iterator<OutputIt2>)
+std::pair<OutputIt1, OutputIt2> parallel_partition_copy(
+    Executor& executor, Iterator first, Iterator last, OutputIt1 d_true,
+    OutputIt2 d_false, Predicate pred) {
+  using namespace compaction_detail;
+  unsigned long const length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_partition_copy", Iterator, Predicate>();
+  compaction_plan const plan = plan_compaction(
+      executor, grains, first, length,
+      [&](unsigned long i) { return static_cast<bool>(pred(first[i])); });
+  // 第 i 块之前不满足 pred 的个数 = 块的起始位置 - 之前满足 pred 的个数
+  run_blocks(executor, plan.blocks(), [&](std::size_t i) {
+    OutputIt1 out_true = d_true + plan.offsets[i];
+    OutputIt2 out_false = d_false + (plan.bounds[i] - plan.offsets[i]);
+    for (unsigned long j = plan.bounds[i]; j != plan.bounds[i + 1]; ++j) {
+      if (plan.keep[j]) {
+        *out_true++ = first[j];
+      } else {
+        *out_false++ = first[j];
+      }
+    }
+  });
+  return {d_true + plan.kept(), d_false + (length - plan.kept())};
+}
+
+// 与 std::remove_if 相同, 返回保留部分的结尾, 之后的元素处于有效但未指定的状态
+// 元素类型需要可以默认构造(临时缓冲区)
+template <typename Executor, typename Iterator, typename Predicate>
+  requires std::random_access_iterator<Iterator>
+Iterator parallel_remove_if(Executor& executor, Iterator first, Iterator last,
+                            Predicate pred) {
+  using namespace compaction_detail;
+  grain_controller& grains =
+      grain_controller_for<"parallel_remove_if", Iterator, Predicate>();
+  compaction_plan const plan = plan_compaction(
+      executor, grains, first, std::distance(first, last),
+      [&](unsigned long i) { return !pred(first[i]); });
+  return compact_in_place(executor, plan, first);
+}
+
+// 与 std::unique 相同, 每组连续的等价元素只保留第一个; pred 必须是等价关系
+// 每个元素只与它在原序列中的前一个元素比较, 所以各块可以独立计算标志
+template <typename Executor, typename Iterator,
+          typename BinaryPredicate = std::equal_to<>>
+  requires std::random_access_iterator<Iterator>
+Iterator parallel_unique(Executor& executor, Iterator first, Iterator last,
+                         BinaryPredicate pred = BinaryPredicate()) {
+  using namespace compaction_detail;
+  grain_controller& grains =
+      grain_controller_for<"parallel_unique", Iterator, BinaryPredicate>();
+  compaction_plan const plan = plan_compaction(
+      executor, grains, first, std::distance(first, last),
+      [&](unsigned long i) {
+        return i == 0 || !pred(first[i - 1], first[i]);
+      });
+  return compact_in_place(executor, plan, first);
+}
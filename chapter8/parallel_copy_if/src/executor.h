@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 执行器: 并行算法通过它把工作交给常驻线程, 每次调用不再创建线程
+// 一个执行器只需提供两个接口:
+//   execute(f)    把无参任务 f 交给某个线程执行(也可以直接在当前线程执行)
+//   concurrency() 最多有多少个线程能同时帮忙
+// 下面给出三种: 当前线程直接执行, chapter9 的 thread_pool(submit 接口),
+// 以及 cyber_rt 的 ThreadPool(enqueue 接口)
+
+// 全部工作都在调用线程完成, 适合很小的输入或者调试
+class inline_executor {
+ public:
+  template <typename Function>
+  void execute(Function&& f) {
+    std::forward<Function>(f)();
+  }
+  std::size_t concurrency() const { return 0; }
+};
+
+// 适配 chapter9 的 thread_pool / thread_pool_steal, 返回的 future 直接丢弃,
+// 任务的完成由 run_blocks 自己跟踪
+template <typename Pool>
+class pool_executor {
+ public:
+  explicit pool_executor(Pool& pool, std::size_t concurrency =
+                                         std::thread::hardware_concurrency())
+      : pool_(pool), concurrency_(concurrency) {}
+
+  template <typename Function>
+  void execute(Function f) {
+    pool_.submit(std::move(f));
+  }
+  std::size_t concurrency() const { return concurrency_; }
+
+ private:
+  Pool& pool_;
+  std::size_t concurrency_;
+};
+
+// 适配 cyber_rt 的 dm::utils::ThreadPool; 任务队列满时 enqueue 会丢弃任务,
+// 这不影响正确性, 没被执行的块会由调用线程完成
+template <typename Pool>
+class enqueue_executor {
+ public:
+  enqueue_executor(Pool& pool, std::size_t concurrency)
+      : pool_(pool), concurrency_(concurrency) {}
+
+  template <typename Function>
+  void execute(Function f) {
+    pool_.enqueue(std::move(f));
+  }
+  std::size_t concurrency() const { return concurrency_; }
+
+ private:
+  Pool& pool_;
+  std::size_t concurrency_;
+};
+
+// 在执行器上执行 block_count 个块, 调用线程也参与执行
+// 块的下标通过原子计数器领取, 所以提交给执行器的只是 "帮手" 任务:
+// 帮手晚到时发现所有块都已被领取就直接返回, 不会访问调用方栈上的数据;
+// 调用线程在自己领不到块之后, 只需等待已领取的块全部完成即可.
+// 因此即使在线程池的工作线程里嵌套调用, 或者执行器丢弃了任务, 也不会死锁
+class block_runner {
+ public:
+  explicit block_runner(std::size_t block_count) : block_count_(block_count) {}
+
+  // 领取并执行块, 直到没有剩余的块
+  void run(std::function<void(std::size_t)> const& body) {
+    for (;;) {
+      std::size_t const block = next_.fetch_add(1);
+      if (block >= block_count_) {
+        return;
+      }
+      if (!failed_.load(std::memory_order_relaxed)) {
+        try {
+          body(block);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mtx_);
+          if (!error_) {
+            error_ = std::current_exception();
+          }
+          failed_.store(true);
+        }
+      }
+      if (completed_.fetch_add(1) + 1 == block_count_) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        cond_.notify_all();
+      }
+    }
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cond_.wait(lock, [this] { return completed_.load() == block_count_; });
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+ private:
+  std::size_t const block_count_;
+  std::atomic<std::size_t> next_{0};
+  std::atomic<std::size_t> completed_{0};
+  std::atomic<bool> failed_{false};
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  std::exception_ptr error_;
+};
+
+template <typename Executor, typename Body>
+void run_blocks(Executor& executor, std::size_t block_count, Body const& body) {
+  if (block_count == 0) {
+    return;
+  }
+  auto runner = std::make_shared<block_runner>(block_count);
+  // 帮手任务持有 runner 的共享所有权, body 只在领到块时才会被调用,
+  // 而调用线程会等到所有块完成才返回, 因此 body 的生命周期是安全的
+  auto const job = std::make_shared<std::function<void(std::size_t)>>(
+      std::cref(body));
+  std::size_t const helpers =
+      std::min<std::size_t>(block_count - 1, executor.concurrency());
+  for (std::size_t i = 0; i < helpers; ++i) {
+    executor.execute([runner, job] { runner->run(*job); });
+  }
+  runner->run(*job);
+  runner->wait();
+}
+
+// 前向/双向迭代器(std::list, std::map 等)的单遍切分
+// 先 std::distance 再逐块 std::advance, 意味着调用线程要把整个区间走完一遍
+// 工作线程才能开始. 这里调用线程每走过 block_size 个元素就把这一块交给执行器,
+// 工作线程处理前面的块时调用线程继续向后遍历.
+// 每块带一个 claimed 标志, 执行器上的任务和调用线程谁先领取谁执行:
+// 遍历结束后调用线程从后往前执行还没被领取的块(刚遍历过, 还在缓存里),
+// 再等待被任务领取的块完成. 与 block_runner 一样, 晚到的任务发现块已被领取
+// 就直接返回, 所以执行器丢弃任务或在工作线程里嵌套调用都不会死锁
+template <typename Iterator, typename Result>
+class forward_block_runner {
+ public:
+  using body_type = std::function<Result(Iterator, Iterator, unsigned long)>;
+  using slot_type = std::conditional_t<std::is_void_v<Result>, char, Result>;
+
+  struct block {
+    block(Iterator b, Iterator e, unsigned long n)
+        : begin(b), end(e), count(n) {}
+    Iterator const begin;
+    Iterator const end;
+    unsigned long const count;
+    std::atomic<bool> claimed{false};
+    slot_type result{};
+  };
+
+  // 只由调用线程调用; deque 追加元素不会使已有元素的引用失效,
+  // 任务只通过引用访问自己的块, 所以可以与正在执行的任务并发
+  block& add(Iterator begin, Iterator end, unsigned long count) {
+    return blocks_.emplace_back(begin, end, count);
+  }
+
+  // 领取到块就执行它并返回 true
+  bool try_run(block& b, body_type const& body) {
+    if (b.claimed.exchange(true)) {
+      return false;
+    }
+    if (!failed_.load(std::memory_order_relaxed)) {
+      try {
+        if constexpr (std::is_void_v<Result>) {
+          body(b.begin, b.end, b.count);
+        } else {
+          b.result = body(b.begin, b.end, b.count);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+        failed_.store(true);
+      }
+    }
+    return true;
+  }
+
+  // 只由调用线程调用: 执行一块并记录调用线程自己执行的块数,
+  // 其余的块都由执行器上的任务执行, finish 只等待这些块
+  void run_inline(block& b, body_type const& body) {
+    if (try_run(b, body)) {
+      ++ran_inline_;
+    }
+  }
+
+  // 执行器上的任务执行完一块后调用
+  void task_done() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    ++task_completed_;
+    cond_.notify_all();
+  }
+
+  // 调用线程执行剩下的块, 等待其余的块完成, 按顺序返回每块的结果
+  auto finish(body_type const& body) {
+    for (auto it = blocks_.rbegin(); it != blocks_.rend(); ++it) {
+      run_inline(*it, body);
+    }
+    std::size_t const claimed_by_tasks = blocks_.size() - ran_inline_;
+    std::unique_lock<std::mutex> lock(mtx_);
+    cond_.wait(lock, [&] { return task_completed_ == claimed_by_tasks; });
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    if constexpr (!std::is_void_v<Result>) {
+      std::vector<Result> results;
+      results.reserve(blocks_.size());
+      for (block& b : blocks_) {
+        results.push_back(std::move(b.result));
+      }
+      return results;
+    }
+  }
+
+ private:
+  std::deque<block> blocks_;
+  std::size_t ran_inline_ = 0;
+  std::atomic<bool> failed_{false};
+  std::size_t task_completed_ = 0;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  std::exception_ptr error_;
+};
+
+// body(begin, end, n) 处理一块(n 个元素)并返回该块的结果;
+// 返回每块结果组成的 vector(按区间顺序), body 返回 void 时没有返回值
+template <typename Executor, typename Iterator, typename Body>
+auto run_forward_blocks(Executor& executor, Iterator first, Iterator last,
+                        unsigned long block_size, Body const& body) {
+  using result_type =
+      std::invoke_result_t<Body const&, Iterator, Iterator, unsigned long>;
+  using runner_type = forward_block_runner<Iterator, result_type>;
+  auto runner = std::make_shared<runner_type>();
+  auto const job =
+      std::make_shared<typename runner_type::body_type>(std::cref(body));
+  bool const has_helpers = executor.concurrency() != 0;
+  while (first != last) {
+    Iterator block_end = first;
+    unsigned long n = 0;
+    for (; n != block_size && block_end != last; ++n) {
+      ++block_end;
+    }
+    auto& b = runner->add(first, block_end, n);
+    if (has_helpers) {
+      executor.execute([runner, job, &b] {
+        if (runner->try_run(b, *job)) {
+          runner->task_done();
+        }
+      });
+    } else {
+      runner->run_inline(b, *job);
+    }
+    first = block_end;
+  }
+  return runner->finish(*job);
+}
+
+// 每个线程最多分到的块数: 块数多于线程数时, 先做完的线程会继续领取剩下的块,
+// 块的耗时不均匀时也能保持负载均衡
+constexpr unsigned long max_blocks_per_worker = 8;
+
+// 每块至少 grain 个元素(见 grain_controller.h), 块数不超过
+// (调用线程 + 执行器的帮手数) * max_blocks_per_worker; 没有帮手时只分一块
+template <typename Executor>
+unsigned long block_count_for(Executor const& executor, unsigned long length,
+                              unsigned long grain) {
+  unsigned long const max_blocks = (length + grain - 1) / grain;
+  unsigned long const workers = executor.concurrency() + 1;
+  return std::min<unsigned long>(
+      workers == 1 ? 1 : workers * max_blocks_per_worker, max_blocks);
+}
+
+// 把 [first, first + length) 切成 num_blocks 块, 返回 num_blocks + 1 个边界,
+// 最后一块包含除不尽的余数
+template <typename Iterator>
+std::vector<Iterator> block_bounds(Iterator first, unsigned long length,
+                                   unsigned long num_blocks) {
+  unsigned long const block_size = length / num_blocks;
+  std::vector<Iterator> bounds(num_blocks + 1, first);
+  for (unsigned long i = 1; i < num_blocks; ++i) {
+    bounds[i] = bounds[i - 1];
+    std::advance(bounds[i], block_size);
+  }
+  bounds[num_blocks] = std::next(bounds[num_blocks - 1],
+                                 length - (num_blocks - 1) * block_size);
+  return bounds;
+}
+
+// 第 i 块的元素个数, 与 block_bounds 的划分一致
+inline unsigned long block_length(unsigned long length,
+                                  unsigned long num_blocks, std::size_t i) {
+  unsigned long const block_size = length / num_blocks;
+  return i + 1 == num_blocks ? length - i * block_size : block_size;
+}
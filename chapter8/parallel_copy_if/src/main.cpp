@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "compaction.h"
+#include "executor.h"
+#include "grain_controller.h"
+#include "thread_pool.h"
+
+// 传感器上报的一条事件, id 递增, 用来检查输出顺序是否稳定
+struct event {
+  std::uint64_t id;
+  std::uint32_t sensor;
+  float value;
+  bool operator==(event const&) const = default;
+};
+
+template <typename F>
+void timed(char const* name, F&& f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  f();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << name << ": "
+            << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                     start)
+                   .count()
+            << " microseconds" << std::endl;
+}
+
+int main() {
+  try {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::uint32_t> sensor_dist(0, 999);
+    std::normal_distribution<float> value_dist(0.0f, 1.0f);
+    std::vector<event> events(4000000);
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      events[i] = {i, sensor_dist(gen), value_dist(gen)};
+    }
+    // 约 10% 的事件是异常值
+    auto outlier = [](event const& e) {
+      return e.value > 1.645f || e.value < -1.645f;
+    };
+
+    thread_pool pool;
+    pool_executor<thread_pool> pool_exec(pool);
+    inline_executor inline_exec;
+    bool correct = true;
+
+    // 1. 挑出异常值; 与 std::copy_if 的结果相同就说明顺序是稳定的
+    std::cout << "--- copy_if (about 10% kept) ---" << std::endl;
+    std::vector<event> expected, result(events.size());
+    timed("std::copy_if", [&] {
+      std::copy_if(events.begin(), events.end(),
+                   std::back_inserter(expected), outlier);
+    });
+    timed("parallel_copy_if, pool_executor", [&] {
+      auto end = parallel_copy_if(pool_exec, events.begin(), events.end(),
+                                  result.begin(), outlier);
+      result.erase(end, result.end());
+    });
+    correct = correct && result == expected;
+    result.assign(events.size(), event());
+    auto end = parallel_copy_if(inline_exec, events.begin(), events.end(),
+                                result.begin(), outlier);
+    correct = correct && std::equal(result.begin(), end, expected.begin(),
+                                    expected.end());
+
+    // 2. 按异常值划分到两个输出
+    std::cout << "\n--- partition_copy ---" << std::endl;
+    std::vector<event> expected_true, expected_false;
+    timed("std::partition_copy", [&] {
+      std::partition_copy(events.begin(), events.end(),
+                          std::back_inserter(expected_true),
+                          std::back_inserter(expected_false), outlier);
+    });
+    std::vector<event> out_true(events.size()), out_false(events.size());
+    timed("parallel_partition_copy, pool_executor", [&] {
+      auto [true_end, false_end] =
+          parallel_partition_copy(pool_exec, events.begin(), events.end(),
+                                  out_true.begin(), out_false.begin(),
+                                  outlier);
+      out_true.erase(true_end, out_true.end());
+      out_false.erase(false_end, out_false.end());
+    });
+    correct = correct && out_true == expected_true &&
+              out_false == expected_false;
+
+    // 3. 原地删除异常值
+    std::cout << "\n--- remove_if (about 90% kept) ---" << std::endl;
+    std::vector<event> data = events;
+    timed("std::remove_if", [&] {
+      expected.assign(events.begin(), events.end());
+      expected.erase(
+          std::remove_if(expected.begin(), expected.end(), outlier),
+          expected.end());
+    });
+    timed("parallel_remove_if, pool_executor", [&] {
+      data.erase(
+          parallel_remove_if(pool_exec, data.begin(), data.end(), outlier),
+          data.end());
+    });
+    correct = correct && data == expected;
+
+    // 4. 已排序的传感器编号去重, 每个编号约 4000 个重复
+    std::cout << "\n--- unique (1000 distinct values) ---" << std::endl;
+    std::vector<std::uint32_t> sensors(events.size());
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      sensors[i] = events[i].sensor;
+    }
+    std::sort(sensors.begin(), sensors.end());
+    std::vector<std::uint32_t> unique_expected = sensors;
+    timed("std::unique", [&] {
+      unique_expected.erase(
+          std::unique(unique_expected.begin(), unique_expected.end()),
+          unique_expected.end());
+    });
+    timed("parallel_unique, pool_executor", [&] {
+      sensors.erase(parallel_unique(pool_exec, sensors.begin(), sensors.end()),
+                    sensors.end());
+    });
+    correct = correct && sensors == unique_expected;
+
+    // 非平凡的元素类型, 以及什么都不删/全部删除/空输入
+    std::vector<std::string> words;
+    for (int i = 0; i < 100000; ++i) {
+      words.push_back(std::to_string(i / 3));
+    }
+    std::vector<std::string> words_expected = words;
+    words_expected.erase(
+        std::unique(words_expected.begin(), words_expected.end()),
+        words_expected.end());
+    words.erase(parallel_unique(pool_exec, words.begin(), words.end()),
+                words.end());
+    correct = correct && words == words_expected;
+
+    data = events;
+    auto none = [](event const&) { return false; };
+    auto all = [](event const&) { return true; };
+    correct =
+        correct &&
+        parallel_remove_if(pool_exec, data.begin(), data.end(), none) ==
+            data.end() &&
+        data == events &&
+        parallel_remove_if(pool_exec, data.begin(), data.end(), all) ==
+            data.begin() &&
+        parallel_remove_if(pool_exec, data.end(), data.end(), all) ==
+            data.end();
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
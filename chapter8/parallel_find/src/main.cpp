@@ -1,54 +1,244 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <concepts>
 #include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <memory>
 #include <numeric>
 #include <system_error>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
-class join_threads {
- public:
-  explicit join_threads(std::vector<std::thread>& threads)
-      : threads_(threads) {}
-  ~join_threads() {
-    for (unsigned long i = 0; i < threads_.size(); ++i) {
-      if (threads_[i].joinable()) threads_[i].join();
+#include "executor.h"
+#include "grain_controller.h"
+#include "join_threads.h"
+#include "simd_find.h"
+#include "thread_pool.h"
+
+// 匹配器: operator() 逐元素判断, 可选的 scan() 在连续内存上做向量化扫描,
+// 返回 [p, p + n) 中第一个匹配的下标, 没有匹配时返回 n
+template <typename ValueType, typename MatchType>
+struct equal_matcher {
+  MatchType value;
+
+  bool operator()(ValueType const& v) const { return v == value; }
+
+  std::size_t scan(ValueType const* p, std::size_t n) const
+    requires(std::is_same_v<ValueType, MatchType> &&
+             simd::is_searchable_v<ValueType>)
+  {
+    return simd::find_eq(p, n, value);
+  }
+};
+
+// 与 std::find_first_of 一样按 元素 == 值 比较. 值的类型与元素类型相同时
+// 可以用向量化扫描
+template <typename ValueType, typename NeedleType = ValueType>
+struct any_of_matcher {
+  std::vector<NeedleType> values;
+
+  bool operator()(ValueType const& v) const {
+    return std::any_of(values.begin(), values.end(),
+                       [&](NeedleType const& needle) { return v == needle; });
+  }
+
+  std::size_t scan(ValueType const* p, std::size_t n) const
+    requires(std::is_same_v<ValueType, NeedleType> &&
+             simd::is_searchable_v<ValueType>)
+  {
+    return simd::find_any_eq(p, n, values.data(), values.size());
+  }
+};
+
+// 要查找的值能否先转换成元素类型再比较, 而比较结果不变. 数值的 == 在两者
+// 的公共类型里进行: 公共类型就是元素类型时转换正是 == 自己做的; 公共类型
+// 更宽时, 元素转换过去不丢精度才行. 例如 int64 元素与 double 值在 double
+// 里比较, 多个元素可能等于同一个值, 这时保留原来的类型逐个比较
+template <typename ValueType, typename NeedleType>
+constexpr bool needles_convertible() {
+  if constexpr (std::is_same_v<ValueType, NeedleType>) {
+    return true;
+  } else if constexpr (!std::is_arithmetic_v<ValueType> ||
+                       !std::is_arithmetic_v<NeedleType>) {
+    return false;
+  } else {
+    using common = std::common_type_t<ValueType, NeedleType>;
+    return std::is_same_v<common, ValueType> ||
+           !std::is_floating_point_v<common> ||
+           std::numeric_limits<ValueType>::digits <=
+               std::numeric_limits<common>::digits;
+  }
+}
+
+// 把 needle 转换成元素类型存入 value, 返回转换之后是否仍然 == needle.
+// 不相等的值不会等于任何元素(例如 int 的 65537 转换成 short 是 1), 不能
+// 让它产生错误的匹配. 浮点数超出目标类型范围时的转换是未定义行为, 先检查
+template <typename ValueType, typename NeedleType>
+bool convert_needle(NeedleType const& needle, ValueType& value) {
+  using common = std::common_type_t<ValueType, NeedleType>;
+  if constexpr (std::is_same_v<common, ValueType>) {
+    value = static_cast<ValueType>(needle);
+    return true;
+  } else {
+    if constexpr (std::is_floating_point_v<NeedleType>) {
+      if (std::isnan(needle)) {
+        return false;
+      }
+      if constexpr (std::is_integral_v<ValueType>) {
+        // 整数类型的下界和上界 + 1 都是 2 的幂, 转换成浮点数没有误差
+        using limits = std::numeric_limits<ValueType>;
+        NeedleType const whole = std::trunc(needle);
+        if (whole < static_cast<NeedleType>(limits::min()) ||
+            whole >= static_cast<NeedleType>(limits::max() / 2 + 1) * 2) {
+          return false;
+        }
+      } else if (std::isfinite(needle) &&
+                 std::abs(needle) > std::numeric_limits<ValueType>::max()) {
+        return false;
+      }
+    }
+    value = static_cast<ValueType>(needle);
+    return static_cast<common>(value) == static_cast<common>(needle);
+  }
+}
+
+template <typename ValueType, typename ForwardIterator>
+auto make_any_of_matcher(ForwardIterator s_first, ForwardIterator s_last) {
+  using needle_type = std::iter_value_t<ForwardIterator>;
+  if constexpr (needles_convertible<ValueType, needle_type>()) {
+    std::vector<ValueType> values;
+    for (; s_first != s_last; ++s_first) {
+      ValueType value{};
+      if (convert_needle(needle_type(*s_first), value)) {
+        values.push_back(std::move(value));
+      }
     }
+    return any_of_matcher<ValueType>{std::move(values)};
+  } else {
+    return any_of_matcher<ValueType, needle_type>{
+        std::vector<needle_type>(s_first, s_last)};
   }
+}
 
- private:
-  std::vector<std::thread>& threads_;
+template <typename ValueType, typename Predicate>
+struct predicate_matcher {
+  Predicate pred;
+
+  bool operator()(ValueType const& v) const { return pred(v); }
 };
 
-template <typename Iterator, typename MatchType>
+template <typename Matcher, typename Iterator>
+inline constexpr bool is_vector_scannable_v =
+    std::contiguous_iterator<Iterator> &&
+    requires(Matcher const& m, std::iter_value_t<Iterator> const* p) {
+      { m.scan(p, std::size_t()) } -> std::same_as<std::size_t>;
+    };
+
+// 多个线程可能同时找到匹配, 只保留下标最小的那个
+inline void update_first_match(std::atomic<std::size_t>& first_match,
+                               std::size_t index) {
+  std::size_t current = first_match.load(std::memory_order_relaxed);
+  while (index < current &&
+         !first_match.compare_exchange_weak(current, index,
+                                            std::memory_order_relaxed)) {
+  }
+}
+
+// 顺序查找 [begin, end) 中的第一个匹配, 用于校准 grain 时扫描前缀
+template <typename Iterator, typename Matcher>
+Iterator find_block(Iterator begin, Iterator end, Matcher const& matcher) {
+  if constexpr (is_vector_scannable_v<Matcher, Iterator>) {
+    return begin + matcher.scan(std::to_address(begin), end - begin);
+  } else {
+    return std::find_if(begin, end, std::cref(matcher));
+  }
+}
+
+// 校准 grain 时顺便扫描的前缀中如果已有匹配, 直接返回它, 否则返回 last;
+// first 和 length 被调整为剩余部分
+template <typename Iterator, typename Matcher>
+Iterator calibrate_find(grain_controller& grains, Iterator& first,
+                        Iterator last, unsigned long& length,
+                        Matcher const& matcher) {
+  Iterator match = last;
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        Iterator const it = find_block(begin, end, matcher);
+        if (it != end) {
+          match = it;
+          return true;
+        }
+        return false;
+      });
+  std::advance(first, sampled);
+  length -= sampled;
+  return match;
+}
+
+template <typename Iterator, typename Matcher>
 struct find_element {
-  void operator()(Iterator begin, Iterator end, MatchType match,
-                  std::promise<Iterator>& result, std::atomic<bool>& done) {
+  // 扫描下标区间 [begin_index, end_index), begin 指向 begin_index 处的元素
+  // 每个 cache line 大小的 chunk 只检查一次已知的最小匹配位置:
+  // 如果更靠前的位置已经匹配, 本块剩下的部分不可能是第一个匹配, 直接退出;
+  // 而位于已知匹配之前的块必须继续扫描完, 这样才能保证返回最靠前的匹配
+  void operator()(Iterator begin, std::size_t begin_index,
+                  std::size_t end_index, Matcher const& matcher,
+                  std::atomic<std::size_t>& first_match,
+                  std::promise<void>& error) {
+    using value_type = std::iter_value_t<Iterator>;
+    constexpr std::size_t chunk_size = simd::cache_line_elements<value_type>;
     try {
-      for (; (begin != end) && !done.load(); ++begin) {
-        if (*begin == match) {
-          // 即使多个线程同时找到匹配元素，promise只会接受第一个值
-          // 后续的 set_value() 调用会抛出异常，被catch块处理
-          result.set_value(begin);
-          done.store(true);
+      std::size_t index = begin_index;
+      while (index < end_index &&
+             index < first_match.load(std::memory_order_relaxed)) {
+        std::size_t const chunk_end = std::min(index + chunk_size, end_index);
+        std::size_t found = chunk_end;
+        if constexpr (is_vector_scannable_v<Matcher, Iterator>) {
+          value_type const* chunk =
+              std::to_address(begin) + (index - begin_index);
+          found = index + matcher.scan(chunk, chunk_end - index);
+        } else {
+          for (std::size_t i = index; i < chunk_end; ++i, ++begin) {
+            if (matcher(*begin)) {
+              found = i;
+              break;
+            }
+          }
+        }
+        if (found < chunk_end) {
+          update_first_match(first_match, found);
           return;
         }
+        index = chunk_end;
       }
     } catch (...) {
+      // 只有第一个异常会被记录, 后续的 set_exception() 调用会抛出异常被忽略
       try {
-        result.set_exception(std::current_exception());
-        done.store(true);
+        error.set_exception(std::current_exception());
       } catch (...) {
       }
+      first_match.store(0);  // 让所有线程尽快退出
     }
-  };
+  }
 };
 
-template <typename Iterator, typename MatchType>
-Iterator parallel_find(Iterator first, Iterator last, MatchType match) {
-  unsigned long const length = std::distance(first, last);
+template <typename Iterator, typename Matcher>
+Iterator parallel_find_impl(Iterator first, Iterator last,
+                            Matcher const& matcher) {
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_find", Iterator, Matcher>();
+  Iterator const prefix_match =
+      calibrate_find(grains, first, last, length, matcher);
+  if (prefix_match != last) return prefix_match;
   if (!length) return last;
-  unsigned long const min_per_thread = 25;
+  unsigned long const min_per_thread = grains.grain();
   unsigned long const max_threads =
       (length + min_per_thread - 1) / min_per_thread;
   unsigned long const hardware_threads = std::thread::hardware_concurrency();
@@ -56,8 +246,9 @@ Iterator parallel_find(Iterator first, Iterator last, MatchType match) {
       std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
   unsigned long const block_size = length / num_threads;
 
-  std::promise<Iterator> result;  // 使用std::promise实现多个线程返回一个结果
-  std::atomic<bool> done(false);  // 使用std::atomic实现多线程控制
+  std::atomic<std::size_t> first_match(length);  // 目前已知的最小匹配下标
+  std::promise<void> error;  // 使用std::promise把工作线程的异常带回调用线程
+  std::future<void> error_future = error.get_future();
   std::vector<std::thread> threads(num_threads - 1);
   {
     join_threads joiner(threads);
@@ -65,18 +256,119 @@ Iterator parallel_find(Iterator first, Iterator last, MatchType match) {
     for (unsigned long i = 0; i < (num_threads - 1); ++i) {
       Iterator block_end = block_start;
       std::advance(block_end, block_size);
-      threads[i] =
-          std::thread(find_element<Iterator, MatchType>(), block_start,
-                      block_end, match, std::ref(result), std::ref(done));
+      threads[i] = std::thread(find_element<Iterator, Matcher>(), block_start,
+                               i * block_size, (i + 1) * block_size,
+                               std::cref(matcher), std::ref(first_match),
+                               std::ref(error));
+      block_start = block_end;
+    }
+    chunk_timer timer(grains, length - (num_threads - 1) * block_size);
+    find_element<Iterator, Matcher>()(block_start,
+                                      (num_threads - 1) * block_size, length,
+                                      matcher, first_match, error);
+    // 提前退出的块不能反映每个元素的开销
+    if (first_match.load() != length) {
+      timer.cancel();
     }
-    find_element<Iterator, MatchType>()(block_start, last, match,
-                                        std::ref(result), std::ref(done));
   }
 
-  if (!done) {
+  if (error_future.wait_for(std::chrono::seconds(0)) ==
+      std::future_status::ready) {
+    error_future.get();
+  }
+  std::size_t const index = first_match.load();
+  if (index == length) {
+    return last;
+  }
+  return std::next(first, index);
+}
+
+// 执行器版本: 块交给常驻线程执行, 调用线程也处理其中一块, 不创建任何线程
+template <typename Executor, typename Iterator, typename Matcher>
+Iterator parallel_find_impl(Executor& executor, Iterator first, Iterator last,
+                            Matcher const& matcher) {
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_find", Iterator, Matcher>();
+  Iterator const prefix_match =
+      calibrate_find(grains, first, last, length, matcher);
+  if (prefix_match != last) return prefix_match;
+  if (!length) return last;
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  unsigned long const block_size = length / num_blocks;
+  std::vector<Iterator> const bounds = block_bounds(first, length, num_blocks);
+
+  std::atomic<std::size_t> first_match(length);
+  std::promise<void> error;
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    std::size_t const end_index =
+        i + 1 == num_blocks ? length : (i + 1) * block_size;
+    chunk_timer timer(grains, end_index - i * block_size);
+    find_element<Iterator, Matcher>()(bounds[i], i * block_size, end_index,
+                                      matcher, first_match, error);
+    if (first_match.load() < end_index) {
+      timer.cancel();
+    }
+  });
+  std::future<void> error_future = error.get_future();
+  if (error_future.wait_for(std::chrono::seconds(0)) ==
+      std::future_status::ready) {
+    error_future.get();
+  }
+  std::size_t const index = first_match.load();
+  if (index == length) {
     return last;
   }
-  return result.get_future().get();
+  return std::next(first, index);
+}
+
+template <typename Executor, typename Iterator, typename MatchType>
+Iterator parallel_find(Executor& executor, Iterator first, Iterator last,
+                       MatchType match) {
+  return parallel_find_impl(
+      executor, first, last,
+      equal_matcher<std::iter_value_t<Iterator>, MatchType>{match});
+}
+
+template <typename Executor, typename Iterator, typename Predicate>
+Iterator parallel_find_if(Executor& executor, Iterator first, Iterator last,
+                          Predicate pred) {
+  return parallel_find_impl(
+      executor, first, last,
+      predicate_matcher<std::iter_value_t<Iterator>, Predicate>{pred});
+}
+
+template <typename Executor, typename Iterator, typename ForwardIterator>
+Iterator parallel_find_first_of(Executor& executor, Iterator first,
+                                Iterator last, ForwardIterator s_first,
+                                ForwardIterator s_last) {
+  return parallel_find_impl(
+      executor, first, last,
+      make_any_of_matcher<std::iter_value_t<Iterator>>(s_first, s_last));
+}
+
+template <typename Iterator, typename MatchType>
+Iterator parallel_find(Iterator first, Iterator last, MatchType match) {
+  return parallel_find_impl(
+      first, last,
+      equal_matcher<std::iter_value_t<Iterator>, MatchType>{match});
+}
+
+template <typename Iterator, typename Predicate>
+Iterator parallel_find_if(Iterator first, Iterator last, Predicate pred) {
+  return parallel_find_impl(
+      first, last,
+      predicate_matcher<std::iter_value_t<Iterator>, Predicate>{pred});
+}
+
+template <typename Iterator, typename ForwardIterator>
+Iterator parallel_find_first_of(Iterator first, Iterator last,
+                                ForwardIterator s_first,
+                                ForwardIterator s_last) {
+  return parallel_find_impl(
+      first, last,
+      make_any_of_matcher<std::iter_value_t<Iterator>>(s_first, s_last));
 }
 
 template <typename Iterator, typename MatchType>
@@ -108,6 +400,51 @@ Iterator parallel_find_async(Iterator first, Iterator last, MatchType match,
   }
 }
 
+// 执行器版本: 后一半交给执行器, 前一半在当前线程递归查找. 两半是
+// run_blocks 的两块, 帮手没来得及领取的那一半由当前线程自己处理, 整个
+// 递归不创建线程, 在线程池的工作线程里嵌套等待也不会死锁
+template <typename Executor, typename Iterator, typename MatchType>
+Iterator parallel_find_async(Executor& executor, Iterator first, Iterator last,
+                             MatchType match, std::atomic<bool>& done,
+                             unsigned long min_per_block) {
+  try {
+    unsigned long const length = std::distance(first, last);
+    if (length < (2 * min_per_block)) {
+      for (; (first != last) && !done.load(); ++first) {
+        if (*first == match) {
+          done = true;
+          return first;
+        }
+      }
+      return last;
+    }
+    Iterator const mid_point = first + (length / 2);
+    Iterator results[2];
+    run_blocks(executor, 2, [&](std::size_t i) {
+      results[i] = (i == 0) ? parallel_find_async(executor, first, mid_point,
+                                                  match, done, min_per_block)
+                            : parallel_find_async(executor, mid_point, last,
+                                                  match, done, min_per_block);
+    });
+    return (results[0] == mid_point) ? results[1] : results[0];
+  } catch (...) {
+    done = true;
+    throw;
+  }
+}
+
+// 切分到每段不少于 25 个元素, 段数不超过 block_count_for 的上限
+template <typename Executor, typename Iterator, typename MatchType>
+Iterator parallel_find_async(Executor& executor, Iterator first, Iterator last,
+                             MatchType match) {
+  std::atomic<bool> done(false);
+  unsigned long const length = std::distance(first, last);
+  unsigned long const max_blocks =
+      (executor.concurrency() + 1) * max_blocks_per_worker;
+  return parallel_find_async(executor, first, last, match, done,
+                             std::max(25ul, length / max_blocks));
+}
+
 int main() {
   try {
     std::vector<int> data(10000000);         // 1000万个元素
@@ -175,6 +512,99 @@ int main() {
         static_cast<double>(std_duration.count()) / parallel_duration.count();
     std::cout << "speedup (not found): " << speedup << "x" << std::endl;
 
+    // 多处匹配时必须返回最靠前的一个
+    std::cout << "\n--- Testing first-occurrence semantics ---" << std::endl;
+    std::vector<int> dup(data.size(), 0);
+    for (std::size_t pos : {9000000u, 7000001u, 3000017u, 3000019u}) {
+      dup[pos] = 42;
+    }
+    bool first_correct =
+        parallel_find(dup.begin(), dup.end(), 42) ==
+            std::find(dup.begin(), dup.end(), 42) &&
+        parallel_find_if(dup.begin(), dup.end(),
+                         [](int v) { return v > 40; }) ==
+            std::find_if(dup.begin(), dup.end(),
+                         [](int v) { return v > 40; });
+    std::vector<int> needles = {-7, 42, 13};
+    first_correct =
+        first_correct &&
+        parallel_find_first_of(dup.begin(), dup.end(), needles.begin(),
+                               needles.end()) ==
+            std::find_first_of(dup.begin(), dup.end(), needles.begin(),
+                               needles.end());
+    // 65537 转换成 short 是 1, 不能匹配到值为 1 的元素; NaN 和超出范围的
+    // 浮点数不能转换成整数
+    std::vector<short> small(100000, 1);
+    std::vector<int> wide_needles = {65537, -65535};
+    std::vector<double> float_needles = {std::nan(""), 1e20, 1.5};
+    // int64 与 double 在 double 里比较: 2^53 + 1 转换成 double 是 2^53
+    std::vector<double> doubles(100000, 1.0);
+    doubles[77777] = 9007199254740992.0;
+    std::vector<long long> int64_needles = {9007199254740993LL};
+    // 2^53 + 1 转换成 double 等于 2^53, 两个元素都等于同一个值
+    std::vector<long long> int64s(100000, 1);
+    int64s[33333] = 9007199254740993LL;
+    int64s[55555] = 9007199254740992LL;
+    std::vector<double> double_needles = {9007199254740992.0};
+    auto same_as_std = [](auto const& haystack, auto const& needles) {
+      return parallel_find_first_of(haystack.begin(), haystack.end(),
+                                    needles.begin(), needles.end()) ==
+             std::find_first_of(haystack.begin(), haystack.end(),
+                                needles.begin(), needles.end());
+    };
+    first_correct = first_correct && same_as_std(small, wide_needles) &&
+                    same_as_std(small, float_needles) &&
+                    same_as_std(doubles, int64_needles) &&
+                    same_as_std(int64s, double_needles);
+    std::list<int> dup_list(dup.begin(), dup.begin() + 4000000);
+    first_correct =
+        first_correct && parallel_find(dup_list.begin(), dup_list.end(), 42) ==
+                             std::find(dup_list.begin(), dup_list.end(), 42);
+    thread_pool pool;
+    pool_executor<thread_pool> executor(pool);
+    first_correct =
+        first_correct &&
+        parallel_find(executor, dup.begin(), dup.end(), 42) ==
+            std::find(dup.begin(), dup.end(), 42) &&
+        parallel_find_if(executor, dup.begin(), dup.end(),
+                         [](int v) { return v > 40; }) ==
+            std::find_if(dup.begin(), dup.end(),
+                         [](int v) { return v > 40; }) &&
+        parallel_find_first_of(executor, dup.begin(), dup.end(),
+                               needles.begin(), needles.end()) ==
+            std::find_first_of(dup.begin(), dup.end(), needles.begin(),
+                               needles.end()) &&
+        parallel_find(executor, data.begin(), data.end(), -1) == data.end() &&
+        // 新的谓词类型第一次使用时会校准 grain, 匹配就在校准扫描的前缀里
+        parallel_find_if(executor, data.begin(), data.end(),
+                         [](int v) { return v == 20; }) == data.begin() + 19;
+    std::cout << "first occurrence validation: "
+              << (first_correct ? "correct" : "incorrect") << std::endl;
+    // 递归版本一找到匹配就让其他部分停下, 返回的是某一个匹配, 不一定是第一个
+    auto const any_match =
+        parallel_find_async(executor, dup.begin(), dup.end(), 42);
+    bool const async_correct =
+        any_match != dup.end() && *any_match == 42 &&
+        parallel_find_async(executor, data.begin(), data.end(), -1) ==
+            data.end();
+    std::cout << "async validation: "
+              << (async_correct ? "correct" : "incorrect") << std::endl;
+
+    std::vector<short> shorts(data.size(), 1);
+    shorts[shorts.size() - 10] = 2;
+    start = std::chrono::high_resolution_clock::now();
+    auto short_result = parallel_find(shorts.begin(), shorts.end(), short(2));
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "parallel_find<short> time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                       start)
+                     .count()
+              << " microseconds, position "
+              << (short_result - shorts.begin()) << std::endl;
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
+
   } catch (const std::system_error& e) {
     std::cerr << "thread create failed, " << e.what() << std::endl;
     return 1;
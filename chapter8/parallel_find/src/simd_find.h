@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SIMD_FIND_X86 1
+#endif
+
+// 向量化的相等比较 + movemask 查找
+// 每次比较一个向量宽度的元素, 把比较结果压成位掩码, 最低的置位就是第一个匹配
+// 只对 1/2/4/8 字节的整数类型启用: 浮点的 == 与按位比较语义不同(-0.0, NaN)
+namespace simd {
+
+template <typename T>
+inline constexpr bool is_searchable_v =
+    (std::is_integral_v<T> || std::is_enum_v<T>) &&
+    (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+// 一个 cache line 能容纳的元素个数, 并行查找按这个粒度检查取消标志
+template <typename T>
+inline constexpr std::size_t cache_line_elements =
+    sizeof(T) >= 64 ? 1 : 64 / sizeof(T);
+
+inline bool has_avx2() {
+#if defined(SIMD_FIND_X86)
+  static const bool supported = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+namespace detail {
+
+template <typename T>
+inline std::size_t find_any_eq_scalar(const T* p, std::size_t n,
+                                      const T* needles, std::size_t k) {
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t j = 0; j < k; ++j) {
+      if (p[i] == needles[j]) {
+        return i;
+      }
+    }
+  }
+  return n;
+}
+
+#if defined(SIMD_FIND_X86)
+
+#define SIMD_FIND_AVX2 __attribute__((target("avx2"), always_inline)) inline
+
+// SSE2 是 x86-64 的基线指令集, 无需运行时检测
+template <std::size_t Size>
+struct sse2_cmp;
+
+template <>
+struct sse2_cmp<1> {
+  static __m128i set1(const void* v) {
+    return _mm_set1_epi8(*static_cast<const char*>(v));
+  }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+};
+
+template <>
+struct sse2_cmp<2> {
+  static __m128i set1(const void* v) {
+    return _mm_set1_epi16(*static_cast<const short*>(v));
+  }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+};
+
+template <>
+struct sse2_cmp<4> {
+  static __m128i set1(const void* v) {
+    return _mm_set1_epi32(*static_cast<const int*>(v));
+  }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+};
+
+template <>
+struct sse2_cmp<8> {
+  static __m128i set1(const void* v) {
+    return _mm_set1_epi64x(*static_cast<const long long*>(v));
+  }
+  // SSE2 没有 64 位相等比较, 用两个 32 位比较结果按位与, 再在 64 位内广播
+  static __m128i eq(__m128i a, __m128i b) {
+    __m128i const e = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+};
+
+template <std::size_t Size>
+struct avx2_cmp;
+
+template <>
+struct avx2_cmp<1> {
+  SIMD_FIND_AVX2 static __m256i set1(const void* v) {
+    return _mm256_set1_epi8(*static_cast<const char*>(v));
+  }
+  SIMD_FIND_AVX2 static __m256i eq(__m256i a, __m256i b) {
+    return _mm256_cmpeq_epi8(a, b);
+  }
+};
+
+template <>
+struct avx2_cmp<2> {
+  SIMD_FIND_AVX2 static __m256i set1(const void* v) {
+    return _mm256_set1_epi16(*static_cast<const short*>(v));
+  }
+  SIMD_FIND_AVX2 static __m256i eq(__m256i a, __m256i b) {
+    return _mm256_cmpeq_epi16(a, b);
+  }
+};
+
+template <>
+struct avx2_cmp<4> {
+  SIMD_FIND_AVX2 static __m256i set1(const void* v) {
+    return _mm256_set1_epi32(*static_cast<const int*>(v));
+  }
+  SIMD_FIND_AVX2 static __m256i eq(__m256i a, __m256i b) {
+    return _mm256_cmpeq_epi32(a, b);
+  }
+};
+
+template <>
+struct avx2_cmp<8> {
+  SIMD_FIND_AVX2 static __m256i set1(const void* v) {
+    return _mm256_set1_epi64x(*static_cast<const long long*>(v));
+  }
+  SIMD_FIND_AVX2 static __m256i eq(__m256i a, __m256i b) {
+    return _mm256_cmpeq_epi64(a, b);
+  }
+};
+
+// 最多支持 max_vector_needles 个待匹配值, 每个值一个广播寄存器, 比较结果按位或
+constexpr std::size_t max_vector_needles = 8;
+
+template <typename T>
+std::size_t find_any_eq_sse2(const T* p, std::size_t n, const T* needles,
+                             std::size_t k) {
+  using C = sse2_cmp<sizeof(T)>;
+  constexpr std::size_t W = 16 / sizeof(T);
+  __m128i keys[max_vector_needles];
+  for (std::size_t j = 0; j < k; ++j) {
+    keys[j] = C::set1(needles + j);
+  }
+  std::size_t i = 0;
+  for (; i + W <= n; i += W) {
+    __m128i const v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    __m128i hit = C::eq(v, keys[0]);
+    for (std::size_t j = 1; j < k; ++j) {
+      hit = _mm_or_si128(hit, C::eq(v, keys[j]));
+    }
+    unsigned const mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask) / sizeof(T);
+    }
+  }
+  return i + find_any_eq_scalar(p + i, n - i, needles, k);
+}
+
+template <typename T>
+__attribute__((target("avx2"))) std::size_t find_any_eq_avx2(
+    const T* p, std::size_t n, const T* needles, std::size_t k) {
+  using C = avx2_cmp<sizeof(T)>;
+  constexpr std::size_t W = 32 / sizeof(T);
+  __m256i keys[max_vector_needles];
+  for (std::size_t j = 0; j < k; ++j) {
+    keys[j] = C::set1(needles + j);
+  }
+  std::size_t i = 0;
+  for (; i + W <= n; i += W) {
+    __m256i const v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    __m256i hit = C::eq(v, keys[0]);
+    for (std::size_t j = 1; j < k; ++j) {
+      hit = _mm256_or_si256(hit, C::eq(v, keys[j]));
+    }
+    unsigned const mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask) / sizeof(T);
+    }
+  }
+  return i + find_any_eq_scalar(p + i, n - i, needles, k);
+}
+
+#endif  // SIMD_FIND_X86
+
+}  // namespace detail
+
+// 返回 [p, p + n) 中第一个等于任一 needles[0..k) 的下标, 没有则返回 n
+template <typename T>
+std::size_t find_any_eq(const T* p, std::size_t n, const T* needles,
+                        std::size_t k) {
+  static_assert(is_searchable_v<T>, "simd::find supports 1/2/4/8-byte ints");
+  if (k == 0) {
+    return n;
+  }
+#if defined(SIMD_FIND_X86)
+  if (k <= detail::max_vector_needles) {
+    if (has_avx2()) {
+      return detail::find_any_eq_avx2(p, n, needles, k);
+    }
+    return detail::find_any_eq_sse2(p, n, needles, k);
+  }
+#endif
+  return detail::find_any_eq_scalar(p, n, needles, k);
+}
+
+template <typename T>
+std::size_t find_eq(const T* p, std::size_t n, T value) {
+  return find_any_eq(p, n, &value, 1);
+}
+
+}  // namespace simd
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// 把单遍的输入流切成固定大小的块交给多个消费者处理
+// 缓冲区总数有上限(max_chunks), 处理完的块清空后回到空闲池重复使用,
+// 填好的块排队等待消费者. 所有缓冲区都在使用中说明消费者跟不上,
+// 这时生产者不再读取新的输入(背压), 因此无论输入多长, 内存占用都有上界
+template <typename T>
+class chunk_stream {
+ public:
+  using buffer = std::vector<T>;
+  using buffer_ptr = std::unique_ptr<buffer>;
+
+  chunk_stream(std::size_t chunk_size, std::size_t max_chunks)
+      : chunk_size_(chunk_size), max_chunks_(max_chunks) {}
+
+  std::size_t chunk_size() const { return chunk_size_; }
+
+  // 生产者取一个空闲缓冲区(second 为 false)
+  // 所有缓冲区都在使用时, 如果队列里有填好的块, 就把它交给生产者自己处理
+  // (second 为 true), 生产者在背压期间也在干活; 否则等待有缓冲区被归还
+  std::pair<buffer_ptr, bool> acquire() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (;;) {
+      if (!free_.empty()) {
+        buffer_ptr b = std::move(free_.back());
+        free_.pop_back();
+        return {std::move(b), false};
+      }
+      if (allocated_ < max_chunks_) {
+        ++allocated_;
+        lock.unlock();
+        buffer_ptr b = std::make_unique<buffer>();
+        b->reserve(chunk_size_);
+        return {std::move(b), false};
+      }
+      if (!full_.empty()) {
+        return {take_front(), true};
+      }
+      free_cond_.wait(lock);
+    }
+  }
+
+  void push(buffer_ptr b) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    full_.push_back(std::move(b));
+    full_cond_.notify_one();
+  }
+
+  // 消费者取一个填好的块, 流已关闭且队列为空时返回 nullptr
+  buffer_ptr pop() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    full_cond_.wait(lock, [this] { return !full_.empty() || closed_; });
+    return full_.empty() ? nullptr : take_front();
+  }
+
+  // 不阻塞的 pop, 队列为空时返回 nullptr
+  buffer_ptr try_pop() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return full_.empty() ? nullptr : take_front();
+  }
+
+  // 对取到的块执行 body, 然后清空缓冲区放回空闲池
+  // body 的第一个异常会取消整个流, 之后的块不再执行 body
+  template <typename Body>
+  void consume(buffer_ptr b, Body const& body) {
+    if (!cancelled()) {
+      try {
+        body(*b);
+      } catch (...) {
+        cancel(std::current_exception());
+      }
+    }
+    b->clear();
+    std::lock_guard<std::mutex> lock(mtx_);
+    free_.push_back(std::move(b));
+    --in_progress_;
+    free_cond_.notify_all();
+  }
+
+  // 生产者读完输入后调用, 消费者取完剩余的块后退出
+  void close() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    closed_ = true;
+    full_cond_.notify_all();
+  }
+
+  void cancel(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!error_) {
+      error_ = error;
+    }
+    closed_ = true;
+    full_cond_.notify_all();
+  }
+
+  bool cancelled() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return error_ != nullptr;
+  }
+
+  // 等待所有已被取走的块处理完, 然后重新抛出第一个异常
+  void wait() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    free_cond_.wait(lock, [this] { return in_progress_ == 0; });
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+  // 创建过的缓冲区个数, 不超过 max_chunks
+  std::size_t allocated() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return allocated_;
+  }
+
+ private:
+  buffer_ptr take_front() {
+    buffer_ptr b = std::move(full_.front());
+    full_.pop_front();
+    ++in_progress_;
+    return b;
+  }
+
+  std::size_t const chunk_size_;
+  std::size_t const max_chunks_;
+  mutable std::mutex mtx_;
+  std::condition_variable free_cond_;  // 有缓冲区归还
+  std::condition_variable full_cond_;  // 有块入队或流关闭
+  std::vector<buffer_ptr> free_;
+  std::deque<buffer_ptr> full_;
+  std::size_t allocated_ = 0;
+  std::size_t in_progress_ = 0;
+  bool closed_ = false;
+  std::exception_ptr error_;
+};
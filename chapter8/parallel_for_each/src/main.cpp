@@ -1,35 +1,42 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <exception>
+#include <functional>
 #include <future>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <stdexcept>
 #include <system_error>
 #include <thread>
 #include <vector>
 
-class join_threads {
- public:
-  explicit join_threads(std::vector<std::thread>& threads_)
-      : threads(threads_) {}
-  ~join_threads() {
-    for (unsigned long i = 0; i < threads.size(); ++i) {
-      if (threads[i].joinable()) threads[i].join();
-    }
-  }
-
- private:
-  std::vector<std::thread>& threads;
-};
+#include "chunk_stream.h"
+#include "executor.h"
+#include "grain_controller.h"
+#include "join_threads.h"
+#include "thread_pool.h"
 
 template <typename Iterator, typename Function>
 void parallel_for_each(Iterator first, Iterator last, Function f) {
-  unsigned long const length = std::distance(first, last);
+  unsigned long length = std::distance(first, last);
+  // 函数对象的开销差别很大, grain 按函数对象类型分别测量
+  grain_controller& grains =
+      grain_controller_for<"parallel_for_each", Iterator, Function>();
+  unsigned long const sampled = grains.calibrate(
+      first, length,
+      [&](Iterator begin, Iterator end) { std::for_each(begin, end, f); });
+  std::advance(first, sampled);
+  length -= sampled;
 
   if (length == 0) {
     return;
   }
 
-  unsigned long const min_per_thread = 25;
+  unsigned long const min_per_thread = grains.grain();
   unsigned long const max_threads =
       (length + min_per_thread - 1) / min_per_thread;
   unsigned long const hardware_threads = std::thread::hardware_concurrency();
@@ -51,13 +58,113 @@ void parallel_for_each(Iterator first, Iterator last, Function f) {
     threads[i] = std::thread(std::move(task));
     block_start = block_end;
   }
+  chunk_timer timer(grains, length - (num_threads - 1) * block_size);
   std::for_each(block_start, last, f);
+  timer.stop();
 
   for (unsigned long i = 0; i < (num_threads - 1); ++i) {
     futures[i].get();  // 检查工作线程是否有异常
   }
 }
 
+// 执行器版本: 块交给常驻线程执行, 调用线程也处理其中一块, 不创建任何线程
+template <typename Executor, typename Iterator, typename Function>
+void parallel_for_each(Executor& executor, Iterator first, Iterator last,
+                       Function f) {
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_for_each", Iterator, Function>();
+  unsigned long const sampled = grains.calibrate(
+      first, length,
+      [&](Iterator begin, Iterator end) { std::for_each(begin, end, f); });
+  std::advance(first, sampled);
+  length -= sampled;
+  if (length == 0) {
+    return;
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  std::vector<Iterator> const bounds = block_bounds(first, length, num_blocks);
+  // 工作线程的异常由 run_blocks 带回调用线程重新抛出
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    chunk_timer timer(grains, block_length(length, num_blocks, i));
+    std::for_each(bounds[i], bounds[i + 1], f);
+  });
+}
+
+// 前向/双向迭代器: 不预先计算长度, 遍历区间的同时把切好的块交给执行器
+template <typename Executor, typename Iterator, typename Function>
+  requires(std::forward_iterator<Iterator> &&
+           !std::random_access_iterator<Iterator>)
+void parallel_for_each(Executor& executor, Iterator first, Iterator last,
+                       Function f) {
+  grain_controller& grains =
+      grain_controller_for<"parallel_for_each", Iterator, Function>();
+  unsigned long const sampled = grains.calibrate(
+      first, last,
+      [&](Iterator begin, Iterator end) { std::for_each(begin, end, f); });
+  std::advance(first, sampled);
+  run_forward_blocks(executor, first, last, grains.grain(),
+                     [&](Iterator begin, Iterator end, unsigned long n) {
+                       chunk_timer timer(grains, n);
+                       std::for_each(begin, end, f);
+                     });
+}
+
+// 单遍输入迭代器(std::istream_iterator, 生成器, 从网络读取的序列):
+// 调用线程把元素读入固定大小的块, 执行器上的帮手从有界队列里取块处理.
+// 帮手跟不上时调用线程停止读取, 转而自己处理队列里的块, 内存占用与输入长度无关.
+// 块的大小取自 grain_controller, 第一次调用时还没有测量值, 使用 1024
+template <typename Executor, typename Iterator, typename Function>
+  requires(!std::forward_iterator<Iterator>)
+void parallel_for_each(Executor& executor, Iterator first, Iterator last,
+                       Function f) {
+  using value_type = std::iter_value_t<Iterator>;
+  using stream_type = chunk_stream<value_type>;
+  grain_controller& grains =
+      grain_controller_for<"parallel_for_each", Iterator, Function>();
+  std::size_t const chunk_size = grains.calibrated() ? grains.grain() : 1024;
+  std::size_t const helpers = executor.concurrency();
+  // 每个线程一块正在处理, 再为每个线程多准备一块, 读取和处理可以重叠
+  auto stream = std::make_shared<stream_type>(chunk_size, 2 * (helpers + 1));
+  // 帮手只在取到块时才调用 job, 而调用线程返回前会等待所有块处理完,
+  // 所以 job 引用调用方栈上的 f 和 grains 是安全的
+  auto const job =
+      std::make_shared<std::function<void(typename stream_type::buffer&)>>(
+          [&](typename stream_type::buffer& chunk) {
+            chunk_timer timer(grains, chunk.size());
+            std::for_each(chunk.begin(), chunk.end(), f);
+          });
+  for (std::size_t i = 0; i < helpers; ++i) {
+    executor.execute([stream, job] {
+      while (auto chunk = stream->pop()) {
+        stream->consume(std::move(chunk), *job);
+      }
+    });
+  }
+
+  try {
+    while (first != last && !stream->cancelled()) {
+      auto [chunk, is_full] = stream->acquire();
+      if (is_full) {
+        stream->consume(std::move(chunk), *job);
+        continue;
+      }
+      for (; first != last && chunk->size() != chunk_size; ++first) {
+        chunk->push_back(*first);
+      }
+      stream->push(std::move(chunk));
+    }
+  } catch (...) {
+    stream->cancel(std::current_exception());  // 读取输入时抛出的异常
+  }
+  stream->close();
+  while (auto chunk = stream->try_pop()) {
+    stream->consume(std::move(chunk), *job);
+  }
+  stream->wait();
+}
+
 template <typename Iterator, typename Func>
 void parallel_for_each_async(Iterator first, Iterator last, Func f) {
   unsigned long const length = std::distance(first, last);
@@ -74,6 +181,39 @@ void parallel_for_each_async(Iterator first, Iterator last, Func f) {
   }
 }
 
+// 执行器版本: 前一半交给执行器, 后一半在当前线程递归处理. 两半是
+// run_blocks 的两块, 帮手没来得及领取的那一半由当前线程自己处理, 整个
+// 递归不创建线程, 在线程池的工作线程里嵌套等待也不会死锁
+template <typename Executor, typename Iterator, typename Func>
+void parallel_for_each_async(Executor& executor, Iterator first, Iterator last,
+                             Func f, unsigned long min_per_block) {
+  unsigned long const length = std::distance(first, last);
+  if (!length) return;
+  if (length < (2 * min_per_block)) {
+    std::for_each(first, last, f);
+  } else {
+    Iterator const mid_point = first + length / 2;
+    run_blocks(executor, 2, [&](std::size_t i) {
+      if (i == 0) {
+        parallel_for_each_async(executor, first, mid_point, f, min_per_block);
+      } else {
+        parallel_for_each_async(executor, mid_point, last, f, min_per_block);
+      }
+    });
+  }
+}
+
+// 切分到每段不少于 25 个元素, 段数不超过 block_count_for 的上限
+template <typename Executor, typename Iterator, typename Func>
+void parallel_for_each_async(Executor& executor, Iterator first, Iterator last,
+                             Func f) {
+  unsigned long const length = std::distance(first, last);
+  unsigned long const max_blocks =
+      (executor.concurrency() + 1) * max_blocks_per_worker;
+  parallel_for_each_async(executor, first, last, f,
+                          std::max(25ul, length / max_blocks));
+}
+
 int main() {
   try {
     std::vector<int> data(10000000, 1);  // 1000万个元素，每个都是1
@@ -102,8 +242,105 @@ int main() {
         static_cast<double>(std_duration.count()) / parallel_duration.count();
     std::cout << "speedup: " << speedup << "x" << std::endl;
 
+    std::fill(data.begin(), data.end(), 1);
+    thread_pool pool;
+    pool_executor<thread_pool> executor(pool);
+
+    start = std::chrono::high_resolution_clock::now();
+    parallel_for_each(executor, data.begin(), data.end(),
+                      [](int& value) { value *= 2; });
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "parallel_for_each (pool_executor) time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                       start)
+                     .count()
+              << " microseconds" << std::endl;
+
     bool all_correct = std::all_of(data.begin(), data.end(),
                                    [](int value) { return value == 2; });
+
+    parallel_for_each_async(executor, data.begin(), data.end(),
+                            [](int& value) { value += 1; });
+    all_correct &= std::all_of(data.begin(), data.end(),
+                               [](int value) { return value == 3; });
+
+    // 每个元素开销很大的函数对象会得到小得多的 grain
+    std::vector<double> values(20000, 2.0);
+    parallel_for_each(executor, values.begin(), values.end(),
+                      [](double& value) {
+                        for (int i = 0; i < 1000; ++i) {
+                          value = std::sqrt(value + 2.0);
+                        }
+                      });
+    all_correct &= std::all_of(values.begin(), values.end(), [](double v) {
+      return std::abs(v - 2.0) < 1e-9;
+    });
+
+    // 链表上的单遍切分: 调用线程遍历的同时工作线程已经开始处理前面的块
+    std::list<int> list(2000000, 1);
+    start = std::chrono::high_resolution_clock::now();
+    std::for_each(list.begin(), list.end(), [](int& value) { value *= 2; });
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "std::for_each (std::list) time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                       start)
+                     .count()
+              << " microseconds" << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    parallel_for_each(executor, list.begin(), list.end(),
+                      [](int& value) { value *= 2; });
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "parallel_for_each (std::list, pool_executor) time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                       start)
+                     .count()
+              << " microseconds" << std::endl;
+    all_correct &= std::all_of(list.begin(), list.end(),
+                               [](int value) { return value == 4; });
+    // 没有帮手时调用线程在遍历的同时执行每一块
+    inline_executor inline_exec;
+    parallel_for_each(inline_exec, list.begin(), list.end(),
+                      [](int& value) { value += 1; });
+    all_correct &= std::all_of(list.begin(), list.end(),
+                               [](int value) { return value == 5; });
+
+    // 输入迭代器只能遍历一次: 一边解析文本一边并行处理
+    std::ostringstream text;
+    for (int i = 1; i <= 1000000; ++i) {
+      text << i << ' ';
+    }
+    std::istringstream input(text.str());
+    std::atomic<long long> stream_sum(0);
+    start = std::chrono::high_resolution_clock::now();
+    parallel_for_each(executor, std::istream_iterator<int>(input),
+                      std::istream_iterator<int>(), [&](int value) {
+                        stream_sum.fetch_add(value, std::memory_order_relaxed);
+                      });
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "parallel_for_each (std::istream_iterator) time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                       start)
+                     .count()
+              << " microseconds" << std::endl;
+    all_correct &= stream_sum.load() == 1000000LL * 1000001 / 2;
+
+    // 处理函数抛出的异常会取消整个流, 并在调用线程重新抛出
+    std::istringstream failing_input(text.str());
+    bool rethrown = false;
+    try {
+      parallel_for_each(executor, std::istream_iterator<int>(failing_input),
+                        std::istream_iterator<int>(), [](int value) {
+                          if (value == 500000) {
+                            throw std::runtime_error("bad record");
+                          }
+                        });
+    } catch (const std::runtime_error&) {
+      rethrown = true;
+    }
+    all_correct &= rethrown;
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
     if (all_correct) {
       std::cout << "result validation: correct" << std::endl;
     } else {
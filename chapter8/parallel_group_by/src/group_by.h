@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+#include "group_table.h"
+
+// 并行分组聚合("count by key", "sum by key")
+// 所有线程共用一个加锁的 map(或 threadsafe_lookup_table)时, 每个元素都要
+// 加一次锁, 热门的键所在的桶会被反复争用. 这里每个线程先在自己的局部表里
+// 聚合, 最后再合并:
+//   - 键是 [0, key_count) 内的整数且 key_count 不大时, 局部表是数组,
+//     合并时把键的范围切成几段, 每段由一个任务把所有局部数组加到第一个上
+//   - 否则局部表是开放寻址哈希表, 插入时按哈希值的最高几位分成 P 个分区;
+//     合并时每个任务负责一个分区, 把所有线程的同一分区合并到一起,
+//     不同分区的键不会相同, 所以任务之间不需要同步
+// 聚合方式由 Aggregate 决定, 它需要提供:
+//   using state_type;                                   每个键的聚合状态
+//   state_type init() const;                            空状态
+//   void add(state_type&, Element const&) const;        累加一个元素
+//   void merge(state_type&, state_type const&) const;   合并两个局部状态
+// 结果是 (键, 状态) 的数组; 数组版本按键的大小排列, 哈希表版本的顺序不确定
+
+// 计数
+struct count_aggregate {
+  using state_type = std::size_t;
+  state_type init() const { return 0; }
+  template <typename Element>
+  void add(state_type& state, Element const&) const {
+    ++state;
+  }
+  void merge(state_type& state, state_type const& other) const {
+    state += other;
+  }
+};
+
+// 对 project(元素) 求和
+template <typename T, typename Projection>
+struct sum_aggregate {
+  using state_type = T;
+  Projection project;
+  state_type init() const { return T(); }
+  template <typename Element>
+  void add(state_type& state, Element const& e) const {
+    state += project(e);
+  }
+  void merge(state_type& state, state_type const& other) const {
+    state += other;
+  }
+};
+
+template <typename T, typename Projection>
+sum_aggregate<T, Projection> sum_by(Projection project) {
+  return {project};
+}
+
+namespace group_by_detail {
+
+// 每个线程的哈希表分成的分区数是线程数的这么多倍, 合并时负载更均匀
+constexpr std::size_t partitions_per_worker = 4;
+// 合并数组时每段至少这么多个键
+constexpr std::size_t min_keys_per_range = 4096;
+
+// 在执行器上用 lanes 个局部结果聚合 [first, first + length)
+// 每个 lane 反复从原子计数器领取 grain 个元素, 先做完的 lane 多领几次;
+// 局部结果与 lane 一一对应, 而不是与块对应, 所以局部结果的个数不超过线程数
+// 每次领取都重新读取 grain, 校准的估计偏差很大时(例如哈希表扩容),
+// 块的大小在这一次调用中就能被修正
+// partials[0] 已经包含校准时处理的前缀
+template <typename Executor, typename Iterator, typename Partial,
+          typename MakePartial, typename AddRange>
+void aggregate_lanes(Executor& executor, Iterator first, unsigned long length,
+                     grain_controller& grains, std::vector<Partial>& partials,
+                     MakePartial const& make_partial,
+                     AddRange const& add_range) {
+  unsigned long const grain = grains.grain();
+  std::size_t const lanes = std::min<unsigned long>(
+      executor.concurrency() + 1, (length + grain - 1) / grain);
+  while (partials.size() < lanes) {
+    partials.push_back(make_partial());
+  }
+  std::atomic<unsigned long> next{0};
+  run_blocks(executor, lanes, [&](std::size_t lane) {
+    for (;;) {
+      unsigned long const wanted = grains.grain();
+      unsigned long const begin = next.fetch_add(wanted);
+      if (begin >= length) {
+        return;
+      }
+      unsigned long const n = std::min(wanted, length - begin);
+      chunk_timer timer(grains, n);
+      add_range(partials[lane], first + begin, first + (begin + n));
+    }
+  });
+}
+
+template <typename Key, typename State>
+struct partitioned_table {
+  explicit partitioned_table(std::size_t partitions)
+      : parts(partitions), shift(64 - std::countr_zero(partitions)) {}
+
+  group_table<Key, State>& partition_for(std::uint64_t hash) {
+    return parts[shift == 64 ? 0 : hash >> shift];
+  }
+
+  std::vector<group_table<Key, State>> parts;
+  int shift;  // 哈希值右移 shift 位得到分区号
+};
+
+}  // namespace group_by_detail
+
+// 数组版本: key_fn(元素) 必须在 [0, key_count) 内, 否则抛出 std::out_of_range
+// 每个线程占用 key_count 个状态, key_count 应当与缓存大小相当
+template <typename Executor, typename Iterator, typename KeyFn,
+          typename Aggregate>
+  requires std::random_access_iterator<Iterator>
+auto parallel_group_by(Executor& executor, Iterator first, Iterator last,
+                       std::size_t key_count, KeyFn key_fn, Aggregate agg) {
+  using namespace group_by_detail;
+  using key_type = std::decay_t<decltype(key_fn(*first))>;
+  using state_type = typename Aggregate::state_type;
+  struct dense_partial {
+    std::vector<state_type> states;
+    std::vector<unsigned char> seen;
+  };
+
+  auto make_partial = [&] {
+    return dense_partial{std::vector<state_type>(key_count, agg.init()),
+                         std::vector<unsigned char>(key_count, 0)};
+  };
+  auto add_range = [&](dense_partial& p, Iterator begin, Iterator end) {
+    for (; begin != end; ++begin) {
+      std::size_t const key = static_cast<std::size_t>(key_fn(*begin));
+      if (key >= key_count) {
+        throw std::out_of_range("parallel_group_by: key out of range");
+      }
+      agg.add(p.states[key], *begin);
+      p.seen[key] = 1;
+    }
+  };
+
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_group_by (dense)", Iterator, KeyFn,
+                           Aggregate>();
+  std::vector<dense_partial> partials;
+  partials.push_back(make_partial());
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        add_range(partials[0], begin, end);
+      });
+  first += sampled;
+  length -= sampled;
+  if (length != 0) {
+    aggregate_lanes(executor, first, length, grains, partials, make_partial,
+                    add_range);
+  }
+
+  // 按键的范围分段合并, 每段的结果单独输出, 最后按顺序拼接
+  std::size_t const ranges = std::max<std::size_t>(
+      std::min<std::size_t>(
+          (executor.concurrency() + 1) * max_blocks_per_worker,
+          key_count / min_keys_per_range),
+      1);
+  std::vector<std::vector<std::pair<key_type, state_type>>> outputs(ranges);
+  run_blocks(executor, ranges, [&](std::size_t r) {
+    std::size_t const begin = key_count * r / ranges;
+    std::size_t const end = key_count * (r + 1) / ranges;
+    dense_partial& target = partials[0];
+    for (std::size_t lane = 1; lane < partials.size(); ++lane) {
+      dense_partial const& p = partials[lane];
+      for (std::size_t key = begin; key != end; ++key) {
+        if (p.seen[key]) {
+          agg.merge(target.states[key], p.states[key]);
+          target.seen[key] = 1;
+        }
+      }
+    }
+    for (std::size_t key = begin; key != end; ++key) {
+      if (target.seen[key]) {
+        outputs[r].emplace_back(static_cast<key_type>(key),
+                                std::move(target.states[key]));
+      }
+    }
+  });
+
+  std::vector<std::pair<key_type, state_type>> result;
+  for (auto& output : outputs) {
+    std::move(output.begin(), output.end(), std::back_inserter(result));
+  }
+  return result;
+}
+
+// 哈希表版本: 键可以是任意可哈希, 可比较相等并且可默认构造的类型
+template <typename Executor, typename Iterator, typename KeyFn,
+          typename Aggregate>
+  requires std::random_access_iterator<Iterator>
+auto parallel_group_by(Executor& executor, Iterator first, Iterator last,
+                       KeyFn key_fn, Aggregate agg) {
+  using namespace group_by_detail;
+  using key_type = std::decay_t<decltype(key_fn(*first))>;
+  using state_type = typename Aggregate::state_type;
+  using partial = partitioned_table<key_type, state_type>;
+
+  // 只有调用线程时不需要分区
+  std::size_t const partitions =
+      executor.concurrency() == 0
+          ? 1
+          : std::bit_ceil((executor.concurrency() + 1) * partitions_per_worker);
+  auto make_partial = [&] { return partial(partitions); };
+  auto init = [&] { return agg.init(); };
+  auto add_range = [&](partial& p, Iterator begin, Iterator end) {
+    for (; begin != end; ++begin) {
+      key_type const key = key_fn(*begin);
+      std::uint64_t const hash = group_hash(key);
+      agg.add(p.partition_for(hash).find_or_insert(key, hash, init), *begin);
+    }
+  };
+
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_group_by", Iterator, KeyFn, Aggregate>();
+  std::vector<partial> partials;
+  partials.push_back(make_partial());
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        add_range(partials[0], begin, end);
+      });
+  first += sampled;
+  length -= sampled;
+  if (length != 0) {
+    aggregate_lanes(executor, first, length, grains, partials, make_partial,
+                    add_range);
+  }
+
+  // 按分区合并: 第 p 个任务把所有线程的第 p 个分区合并到第一个线程的表里
+  std::vector<std::vector<std::pair<key_type, state_type>>> outputs(
+      partitions);
+  run_blocks(executor, partitions, [&](std::size_t part) {
+    group_table<key_type, state_type>& target = partials[0].parts[part];
+    std::size_t total = 0;
+    for (partial const& p : partials) {
+      total += p.parts[part].size();
+    }
+    target.reserve(total);
+    for (std::size_t lane = 1; lane < partials.size(); ++lane) {
+      partials[lane].parts[part].for_each(
+          [&](key_type const& key, std::uint64_t hash,
+              state_type const& state) {
+            agg.merge(target.find_or_insert(key, hash, init), state);
+          });
+    }
+    outputs[part].reserve(target.size());
+    target.for_each(
+        [&](key_type const& key, std::uint64_t, state_type const& state) {
+          outputs[part].emplace_back(key, state);
+        });
+  });
+
+  std::vector<std::pair<key_type, state_type>> result;
+  for (auto& output : outputs) {
+    std::move(output.begin(), output.end(), std::back_inserter(result));
+  }
+  return result;
+}
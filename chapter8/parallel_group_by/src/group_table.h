@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// 把 std::hash 的结果再混合一次(murmur3 的 fmix64)
+// libstdc++ 对整数的 std::hash 是恒等映射, 直接取低位做下标时
+// 有规律的键(例如都是 64 的倍数)会挤在少数几个槽里
+template <typename Key>
+std::uint64_t group_hash(Key const& key) {
+  std::uint64_t h = std::hash<Key>()(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+// 分组聚合用的开放寻址哈希表(线性探测)
+// 每个槽保存键, 聚合状态和哈希值; 哈希值的最低位总是 1, 0 表示空槽,
+// 探测时先比较哈希值, 不相等就不用比较键. 下标取哈希值的 [1, 64) 位,
+// 最高的几位留给 parallel_group_by 做分区, 两者互不影响
+// 只插入不删除, 装载率超过 1/2 时容量翻倍, 重新插入时不用再计算哈希
+// Key 和 State 需要可以默认构造
+template <typename Key, typename State>
+class group_table {
+ public:
+  struct slot {
+    std::uint64_t tag = 0;
+    Key key{};
+    State state{};
+  };
+
+  explicit group_table(std::size_t capacity = 16) : slots_(capacity) {}
+
+  std::size_t size() const { return size_; }
+
+  // 预留至少能放下 n 个键而不扩容的空间
+  void reserve(std::size_t n) {
+    std::size_t capacity = slots_.size();
+    while (capacity < 2 * n) {
+      capacity *= 2;
+    }
+    if (capacity != slots_.size()) {
+      rehash(capacity);
+    }
+  }
+
+  // 返回 key 的聚合状态, 键不存在时先插入 init()
+  template <typename Init>
+  State& find_or_insert(Key const& key, std::uint64_t hash, Init const& init) {
+    std::uint64_t const tag = hash | 1;
+    std::size_t const mask = slots_.size() - 1;
+    for (std::size_t i = (hash >> 1) & mask;; i = (i + 1) & mask) {
+      slot& s = slots_[i];
+      if (s.tag == tag && s.key == key) {
+        return s.state;
+      }
+      if (s.tag == 0) {
+        if (2 * (size_ + 1) > slots_.size()) {
+          rehash(slots_.size() * 2);
+          return find_or_insert(key, hash, init);
+        }
+        s.tag = tag;
+        s.key = key;
+        s.state = init();
+        ++size_;
+        return s.state;
+      }
+    }
+  }
+
+  // f(key, hash, state) 访问每个已插入的键
+  template <typename Function>
+  void for_each(Function&& f) const {
+    for (slot const& s : slots_) {
+      if (s.tag != 0) {
+        f(s.key, s.tag, s.state);
+      }
+    }
+  }
+
+ private:
+  void rehash(std::size_t capacity) {
+    std::vector<slot> old(capacity);
+    old.swap(slots_);
+    std::size_t const mask = capacity - 1;
+    for (slot& s : old) {
+      if (s.tag != 0) {
+        std::size_t i = (s.tag >> 1) & mask;
+        while (slots_[i].tag != 0) {
+          i = (i + 1) & mask;
+        }
+        slots_[i] = std::move(s);
+      }
+    }
+  }
+
+  std::vector<slot> slots_;  // 容量总是 2 的幂
+  std::size_t size_ = 0;
+};
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+#include "group_by.h"
+#include "thread_pool.h"
+
+// 访问日志中的一条记录
+struct request {
+  std::uint64_t user;
+  std::uint32_t status;  // 0 ~ 599
+  std::uint32_t bytes;
+};
+
+// 用户自定义的聚合: 每个键的最小, 最大和总字节数
+struct bytes_stats {
+  std::uint32_t min = std::numeric_limits<std::uint32_t>::max();
+  std::uint32_t max = 0;
+  std::uint64_t total = 0;
+  std::size_t count = 0;
+
+  bool operator==(bytes_stats const&) const = default;
+};
+
+struct bytes_stats_aggregate {
+  using state_type = bytes_stats;
+  state_type init() const { return {}; }
+  void add(state_type& s, request const& r) const {
+    s.min = std::min(s.min, r.bytes);
+    s.max = std::max(s.max, r.bytes);
+    s.total += r.bytes;
+    ++s.count;
+  }
+  void merge(state_type& s, state_type const& other) const {
+    s.min = std::min(s.min, other.min);
+    s.max = std::max(s.max, other.max);
+    s.total += other.total;
+    s.count += other.count;
+  }
+};
+
+template <typename F>
+auto timed(char const* name, F&& f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto result = f();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << name << ": "
+            << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                     start)
+                   .count()
+            << " microseconds" << std::endl;
+  return result;
+}
+
+// 结果与单线程的 unordered_map 比较, 与顺序无关
+template <typename Key, typename State>
+bool same_groups(std::vector<std::pair<Key, State>> const& result,
+                 std::unordered_map<Key, State> const& expected) {
+  if (result.size() != expected.size()) {
+    return false;
+  }
+  for (auto const& [key, state] : result) {
+    auto it = expected.find(key);
+    if (it == expected.end() || !(it->second == state)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  try {
+    std::mt19937_64 gen(42);
+    std::uniform_int_distribution<std::uint64_t> user_dist(0, 199999);
+    std::uniform_int_distribution<std::uint32_t> status_dist(0, 599);
+    std::uniform_int_distribution<std::uint32_t> bytes_dist(0, 1 << 20);
+    std::vector<request> requests(4000000);
+    for (request& r : requests) {
+      r = {user_dist(gen) * 64, status_dist(gen), bytes_dist(gen)};
+    }
+
+    thread_pool pool;
+    pool_executor<thread_pool> pool_exec(pool);
+    inline_executor inline_exec;
+    auto status_of = [](request const& r) { return r.status; };
+    auto user_of = [](request const& r) { return r.user; };
+    auto bytes_of = [](request const& r) { return std::uint64_t(r.bytes); };
+
+    // 1. 按状态码计数: 键空间小而稠密, 用数组
+    std::cout << "--- count by status (600 keys) ---" << std::endl;
+    auto status_expected = timed("single-threaded unordered_map", [&] {
+      std::unordered_map<std::uint32_t, std::size_t> counts;
+      for (request const& r : requests) {
+        ++counts[r.status];
+      }
+      return counts;
+    });
+    auto status_counts = timed("parallel_group_by (dense)", [&] {
+      return parallel_group_by(pool_exec, requests.begin(), requests.end(),
+                               600, status_of, count_aggregate());
+    });
+    bool correct = same_groups(status_counts, status_expected) &&
+                   std::is_sorted(status_counts.begin(), status_counts.end());
+
+    // 2. 按用户求和: 20 万个稀疏的 64 位键, 用开放寻址哈希表
+    std::cout << "\n--- sum bytes by user (200000 keys) ---" << std::endl;
+    auto user_expected = timed("single-threaded unordered_map", [&] {
+      std::unordered_map<std::uint64_t, std::uint64_t> sums;
+      for (request const& r : requests) {
+        sums[r.user] += r.bytes;
+      }
+      return sums;
+    });
+    timed("mutex + unordered_map, pool_executor", [&] {
+      std::unordered_map<std::uint64_t, std::uint64_t> sums;
+      std::mutex mtx;
+      std::size_t const blocks = 64;
+      run_blocks(pool_exec, blocks, [&](std::size_t i) {
+        auto begin = requests.begin() + requests.size() * i / blocks;
+        auto end = requests.begin() + requests.size() * (i + 1) / blocks;
+        for (; begin != end; ++begin) {
+          std::lock_guard<std::mutex> lock(mtx);
+          sums[begin->user] += begin->bytes;
+        }
+      });
+      return sums.size();
+    });
+    auto user_sums = timed("parallel_group_by (hash)", [&] {
+      return parallel_group_by(pool_exec, requests.begin(), requests.end(),
+                               user_of, sum_by<std::uint64_t>(bytes_of));
+    });
+    correct = correct && same_groups(user_sums, user_expected);
+    auto inline_sums = parallel_group_by(inline_exec, requests.begin(),
+                                         requests.end(), user_of,
+                                         sum_by<std::uint64_t>(bytes_of));
+    correct = correct && same_groups(inline_sums, user_expected);
+
+    // 3. 用户自定义的聚合
+    std::cout << "\n--- bytes stats by status ---" << std::endl;
+    std::unordered_map<std::uint32_t, bytes_stats> stats_expected;
+    for (request const& r : requests) {
+      bytes_stats_aggregate().add(stats_expected[r.status], r);
+    }
+    auto stats = timed("parallel_group_by (hash)", [&] {
+      return parallel_group_by(pool_exec, requests.begin(), requests.end(),
+                               status_of, bytes_stats_aggregate());
+    });
+    correct = correct && same_groups(stats, stats_expected);
+
+    // 键超出数组范围
+    try {
+      parallel_group_by(pool_exec, requests.begin(), requests.end(), 100,
+                        status_of, count_aggregate());
+      correct = false;
+    } catch (std::out_of_range const&) {
+    }
+
+    // 空输入
+    std::vector<request> empty;
+    correct = correct &&
+              parallel_group_by(pool_exec, empty.begin(), empty.end(), 600,
+                                status_of, count_aggregate())
+                  .empty() &&
+              parallel_group_by(pool_exec, empty.begin(), empty.end(),
+                                user_of, count_aggregate())
+                  .empty();
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+#include "thread_pool.h"
+
+// 每处理这么多个元素检查一次共享的 done 标志, 与 parallel_find 的 chunk 粒度一致
+template <typename Iterator>
+constexpr std::size_t check_interval() {
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
+  return sizeof(value_type) >= 64 ? 1 : 64 / sizeof(value_type);
+}
+
+template <typename Executor, typename Iterator, typename Predicate>
+typename std::iterator_traits<Iterator>::difference_type parallel_count_if(
+    Executor& executor, Iterator first, Iterator last, Predicate pred) {
+  using difference_type =
+      typename std::iterator_traits<Iterator>::difference_type;
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_count_if", Iterator, Predicate>();
+  difference_type prefix_count = 0;
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        prefix_count += std::count_if(begin, end, pred);
+      });
+  std::advance(first, sampled);
+  length -= sampled;
+  if (length == 0) {
+    return prefix_count;
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  std::vector<Iterator> const bounds = block_bounds(first, length, num_blocks);
+  std::vector<difference_type> counts(num_blocks);
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    chunk_timer timer(grains, block_length(length, num_blocks, i));
+    counts[i] = std::count_if(bounds[i], bounds[i + 1], pred);
+  });
+  return std::accumulate(counts.begin(), counts.end(), prefix_count);
+}
+
+// any_of 是整个家族的核心: 任意线程找到匹配后设置 done, 所有线程在下一个
+// chunk 边界退出, 与 parallel_find 中 find_element 的提前退出方式相同
+template <typename Executor, typename Iterator, typename Predicate>
+bool parallel_any_of(Executor& executor, Iterator first, Iterator last,
+                     Predicate pred) {
+  unsigned long length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_any_of", Iterator, Predicate>();
+  bool prefix_match = false;
+  unsigned long const sampled =
+      grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+        return prefix_match = std::any_of(begin, end, pred);
+      });
+  std::advance(first, sampled);
+  length -= sampled;
+  if (prefix_match || length == 0) {
+    return prefix_match;
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  std::vector<Iterator> const bounds = block_bounds(first, length, num_blocks);
+  std::atomic<bool> done(false);
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    chunk_timer timer(grains, block_length(length, num_blocks, i));
+    Iterator it = bounds[i];
+    Iterator const end = bounds[i + 1];
+    while (it != end && !done.load(std::memory_order_relaxed)) {
+      for (std::size_t n = check_interval<Iterator>(); n != 0 && it != end;
+           --n, ++it) {
+        if (pred(*it)) {
+          done.store(true, std::memory_order_relaxed);
+          timer.cancel();
+          return;
+        }
+      }
+    }
+    // 因其他块找到匹配而提前退出的块不能反映每个元素的开销
+    if (it != end) {
+      timer.cancel();
+    }
+  });
+  return done.load();
+}
+
+template <typename Executor, typename Iterator, typename Predicate>
+bool parallel_all_of(Executor& executor, Iterator first, Iterator last,
+                     Predicate pred) {
+  return !parallel_any_of(executor, first, last,
+                          [&](auto const& value) { return !pred(value); });
+}
+
+template <typename Executor, typename Iterator, typename Predicate>
+bool parallel_none_of(Executor& executor, Iterator first, Iterator last,
+                      Predicate pred) {
+  return !parallel_any_of(executor, first, last, pred);
+}
+
+// mismatch 需要返回第一个不相等的位置, 所以共享的是已知最小的不匹配下标:
+// 位于它之后的块提前退出, 之前的块必须扫描完
+template <typename Executor, typename Iterator1, typename Iterator2,
+          typename BinaryPredicate = std::equal_to<>>
+std::pair<Iterator1, Iterator2> parallel_mismatch(
+    Executor& executor, Iterator1 first1, Iterator1 last1, Iterator2 first2,
+    BinaryPredicate pred = BinaryPredicate()) {
+  unsigned long length = std::distance(first1, last1);
+  grain_controller& grains =
+      grain_controller_for<"parallel_mismatch", Iterator1, Iterator2,
+                           BinaryPredicate>();
+  std::pair<Iterator1, Iterator2> prefix_mismatch{last1, first2};
+  unsigned long const sampled =
+      grains.calibrate(first1, length, [&](Iterator1 begin, Iterator1 end) {
+        auto const result = std::mismatch(begin, end, first2, pred);
+        first2 = result.second;
+        if (result.first != end) {
+          prefix_mismatch = result;
+          return true;
+        }
+        return false;
+      });
+  if (prefix_mismatch.first != last1) {
+    return prefix_mismatch;
+  }
+  std::advance(first1, sampled);
+  length -= sampled;
+  if (length == 0) {
+    return {first1, first2};
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  unsigned long const block_size = length / num_blocks;
+  std::vector<Iterator1> const bounds1 =
+      block_bounds(first1, length, num_blocks);
+  std::vector<Iterator2> const bounds2 =
+      block_bounds(first2, length, num_blocks);
+  std::atomic<std::size_t> first_mismatch(length);
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    Iterator1 it1 = bounds1[i];
+    Iterator2 it2 = bounds2[i];
+    Iterator1 const end = bounds1[i + 1];
+    std::size_t index = i * block_size;
+    chunk_timer timer(grains, block_length(length, num_blocks, i));
+    while (it1 != end &&
+           index < first_mismatch.load(std::memory_order_relaxed)) {
+      for (std::size_t n = check_interval<Iterator1>(); n != 0 && it1 != end;
+           --n, ++it1, ++it2, ++index) {
+        if (!pred(*it1, *it2)) {
+          std::size_t current = first_mismatch.load();
+          while (index < current &&
+                 !first_mismatch.compare_exchange_weak(current, index)) {
+          }
+          timer.cancel();
+          return;
+        }
+      }
+    }
+    if (it1 != end) {
+      timer.cancel();
+    }
+  });
+  std::size_t const index = first_mismatch.load();
+  return {std::next(first1, index), std::next(first2, index)};
+}
+
+// equal 只关心是否存在不匹配, 用 done 标志在找到任意一个时立即让所有线程退出
+template <typename Executor, typename Iterator1, typename Iterator2,
+          typename BinaryPredicate = std::equal_to<>>
+bool parallel_equal(Executor& executor, Iterator1 first1, Iterator1 last1,
+                    Iterator2 first2,
+                    BinaryPredicate pred = BinaryPredicate()) {
+  unsigned long length = std::distance(first1, last1);
+  grain_controller& grains =
+      grain_controller_for<"parallel_equal", Iterator1, Iterator2,
+                           BinaryPredicate>();
+  bool prefix_mismatch = false;
+  unsigned long const sampled =
+      grains.calibrate(first1, length, [&](Iterator1 begin, Iterator1 end) {
+        auto const result = std::mismatch(begin, end, first2, pred);
+        first2 = result.second;
+        return prefix_mismatch = result.first != end;
+      });
+  std::advance(first1, sampled);
+  length -= sampled;
+  if (prefix_mismatch || length == 0) {
+    return !prefix_mismatch;
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, length, grains.grain());
+  std::vector<Iterator1> const bounds1 =
+      block_bounds(first1, length, num_blocks);
+  std::vector<Iterator2> const bounds2 =
+      block_bounds(first2, length, num_blocks);
+  std::atomic<bool> done(false);
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    Iterator1 it1 = bounds1[i];
+    Iterator2 it2 = bounds2[i];
+    Iterator1 const end = bounds1[i + 1];
+    chunk_timer timer(grains, block_length(length, num_blocks, i));
+    while (it1 != end && !done.load(std::memory_order_relaxed)) {
+      for (std::size_t n = check_interval<Iterator1>(); n != 0 && it1 != end;
+           --n, ++it1, ++it2) {
+        if (!pred(*it1, *it2)) {
+          done.store(true, std::memory_order_relaxed);
+          timer.cancel();
+          return;
+        }
+      }
+    }
+    if (it1 != end) {
+      timer.cancel();
+    }
+  });
+  return !done.load();
+}
+
+template <typename Function>
+auto time_it(Function f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto result = f();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::make_pair(
+      result,
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start));
+}
+
+template <typename SeqFunction, typename ParFunction>
+bool benchmark(const char* name, std::size_t records, SeqFunction seq,
+               ParFunction par) {
+  auto [seq_result, seq_time] = time_it(seq);
+  auto [par_result, par_time] = time_it(par);
+  auto throughput = [records](std::chrono::microseconds t) {
+    return t.count() != 0 ? records / static_cast<double>(t.count()) : 0.0;
+  };
+  std::cout << name << ": std " << seq_time.count() << " us ("
+            << throughput(seq_time) << " M/s), parallel " << par_time.count()
+            << " us (" << throughput(par_time) << " M/s), "
+            << (seq_result == par_result ? "correct" : "incorrect")
+            << std::endl;
+  return seq_result == par_result;
+}
+
+int main() {
+  try {
+    thread_pool pool;
+    pool_executor<thread_pool> executor(pool);
+    std::vector<int> data(20000000);
+    std::iota(data.begin(), data.end(), 0);
+    std::vector<int> copy(data);
+    copy[15000000] = -1;  // 制造一个不匹配
+
+    auto is_negative = [](int v) { return v < 0; };
+    auto is_even = [](int v) { return v % 2 == 0; };
+    auto is_big = [](int v) { return v >= 1000; };  // 很早就能短路
+
+    bool ok = true;
+    ok &= benchmark(
+        "count_if", data.size(),
+        [&] { return std::count_if(data.begin(), data.end(), is_even); },
+        [&] {
+          return parallel_count_if(executor, data.begin(), data.end(), is_even);
+        });
+    ok &= benchmark(
+        "any_of (early exit)", data.size(),
+        [&] { return std::any_of(data.begin(), data.end(), is_big); },
+        [&] {
+          return parallel_any_of(executor, data.begin(), data.end(), is_big);
+        });
+    ok &= benchmark(
+        "all_of", data.size(),
+        [&] {
+          return std::all_of(data.begin(), data.end(),
+                             [](int v) { return v >= 0; });
+        },
+        [&] {
+          return parallel_all_of(executor, data.begin(), data.end(),
+                                 [](int v) { return v >= 0; });
+        });
+    ok &= benchmark(
+        "none_of", data.size(),
+        [&] { return std::none_of(data.begin(), data.end(), is_negative); },
+        [&] {
+          return parallel_none_of(executor, data.begin(), data.end(),
+                                  is_negative);
+        });
+    ok &= benchmark(
+        "mismatch", data.size(),
+        [&] {
+          return std::mismatch(data.begin(), data.end(), copy.begin()).first -
+                 data.begin();
+        },
+        [&] {
+          return parallel_mismatch(executor, data.begin(), data.end(),
+                                   copy.begin())
+                     .first -
+                 data.begin();
+        });
+    ok &= benchmark(
+        "equal", data.size(),
+        [&] { return std::equal(data.begin(), data.end(), copy.begin()); },
+        [&] {
+          return parallel_equal(executor, data.begin(), data.end(),
+                                copy.begin());
+        });
+    ok &= benchmark(
+        "equal (identical)", data.size(),
+        [&] { return std::equal(data.begin(), data.end(), data.begin()); },
+        [&] {
+          return parallel_equal(executor, data.begin(), data.end(),
+                                data.begin());
+        });
+
+    inline_executor inline_exec;
+    ok &= parallel_count_if(inline_exec, data.begin(), data.end(), is_even) ==
+              10000000 &&
+          parallel_mismatch(inline_exec, data.begin(), data.end(),
+                            copy.begin())
+                  .first == data.begin() + 15000000;
+
+    std::cout << "result validation: " << (ok ? "correct" : "incorrect")
+              << std::endl;
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,11 +1,22 @@
 #include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <future>
+#include <iostream>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <system_error>
 #include <thread>
 #include <vector>
 
-#include "threadsafe_stack.h"
+#include "executor.h"
+#include "thread_pool.h"
+#include "work_stealing_queue.h"
 
 template <typename T>
 struct sorter {
@@ -14,31 +25,96 @@ struct sorter {
     std::promise<std::list<T>> promise;
   };
 
-  threadsafe_stack<chunk_to_sort> chunks;
+  // 小于这个长度的块直接在当前线程排序, 不再划分和入队
+  static constexpr std::size_t sequential_cutoff = 1024;
+
+  // 队列 0 属于调用 do_sort 的线程, 队列 i 属于第 i 个排序线程
+  // 所有队列在构造时创建好, 之后 vector 不再变化, 各线程可以无锁地访问它
+  // 在执行器上排序时不创建线程(max_thread_count 为 0), 排序线程由执行器的
+  // 任务担任, 见 parallel_quick_sort(Executor&, ...)
+  std::vector<std::unique_ptr<work_stealing_queue<chunk_to_sort>>> queues;
   std::vector<std::thread> threads;
   unsigned const max_thread_count;
   std::atomic<bool> end_of_data;
 
+  // 没有块可做的线程在条件变量上睡眠, 而不是 yield 空转
+  // pending 是所有队列中块的总数, sleepers 是正在睡眠的线程数:
+  // 压入块的线程先增加 pending 再检查 sleepers, 睡眠的线程先增加 sleepers
+  // 再检查 pending, 两者都是 seq_cst, 所以至少有一方能看到对方, 不会丢失唤醒
+  std::atomic<std::size_t> pending;
+  std::atomic<unsigned> sleepers;
+  std::mutex wake_mtx;
+  std::condition_variable wake_cond;
+
   sorter()
-      : max_thread_count(std::thread::hardware_concurrency() - 1),
-        end_of_data(false) {}
+      : sorter(std::max(std::thread::hardware_concurrency(), 1u),
+               std::max(std::thread::hardware_concurrency(), 1u) - 1) {}
+  sorter(unsigned queue_count, unsigned max_threads)
+      : max_thread_count(max_threads),
+        end_of_data(false),
+        pending(0),
+        sleepers(0) {
+    for (unsigned i = 0; i < queue_count; ++i) {
+      queues.push_back(
+          std::make_unique<work_stealing_queue<chunk_to_sort>>());
+    }
+  }
   ~sorter() {
-    end_of_data = true;
+    stop();
     for (size_t i = 0; i < threads.size(); ++i) {
       threads[i].join();
     }
   }
 
-  void try_sort_chunk() {
-    std::shared_ptr<chunk_to_sort> chunk = chunks.pop();
-    if (chunk) {
-      sort_chunk(chunk);
+  // 让所有排序线程退出 sort_thread
+  void stop() {
+    end_of_data = true;
+    {
+      std::lock_guard<std::mutex> lock(wake_mtx);
+    }
+    wake_cond.notify_all();
+  }
+
+  void push_chunk(unsigned self, chunk_to_sort&& chunk) {
+    queues[self]->push(std::move(chunk));
+    pending.fetch_add(1);
+    if (sleepers.load() != 0) {
+      std::lock_guard<std::mutex> lock(wake_mtx);
+      wake_cond.notify_one();
     }
   }
 
-  std::list<T> do_sort(std::list<T>& chunk_data) {
-    if (chunk_data.empty()) {
-      return chunk_data;
+  // 先取自己队列里最新的块, 再从其他线程的队列窃取最早的块
+  // 只有取到块时才构造 chunk_to_sort(其中的 promise 要在堆上分配共享状态),
+  // 空闲线程反复检查时不分配内存
+  bool try_sort_chunk(unsigned self) {
+    std::optional<chunk_to_sort> chunk = queues[self]->try_pop();
+    for (std::size_t i = 1; !chunk && i < queues.size(); ++i) {
+      chunk = queues[(self + i) % queues.size()]->try_steal();
+    }
+    if (!chunk) {
+      return false;
+    }
+    pending.fetch_sub(1);
+    sort_chunk(*chunk, self);
+    return true;
+  }
+
+  // 睡眠直到有新的块入队, done() 成立或者排序器结束
+  template <typename Predicate>
+  void wait_for_work(Predicate done) {
+    std::unique_lock<std::mutex> lock(wake_mtx);
+    sleepers.fetch_add(1);
+    wake_cond.wait(lock, [&] {
+      return pending.load() != 0 || end_of_data.load() || done();
+    });
+    sleepers.fetch_sub(1);
+  }
+
+  std::list<T> do_sort(std::list<T>& chunk_data, unsigned self) {
+    if (chunk_data.size() < sequential_cutoff) {
+      chunk_data.sort();
+      return std::move(chunk_data);
     }
 
     std::list<T> result;
@@ -51,28 +127,47 @@ struct sorter {
     new_lower_chunk.data.splice(new_lower_chunk.data.end(), chunk_data,
                                 chunk_data.begin(), divide_point);
     std::future<std::list<T>> new_lower = new_lower_chunk.promise.get_future();
-    chunks.push(std::move(new_lower_chunk));
-    if (threads.size() < max_thread_count) {
-      threads.push_back(std::thread(&sorter<T>::sort_thread, this));
+    push_chunk(self, std::move(new_lower_chunk));
+    // threads 只由调用线程修改, 排序线程不会访问它
+    if (self == 0 && threads.size() < max_thread_count) {
+      threads.push_back(std::thread(&sorter<T>::sort_thread, this,
+                                    static_cast<unsigned>(threads.size() + 1)));
     }
-    std::list<T> new_higher(do_sort(chunk_data));
+    std::list<T> new_higher(do_sort(chunk_data, self));
     result.splice(result.end(), new_higher);
-    while (new_lower.wait_for(std::chrono::seconds(0)) !=
-           std::future_status::ready) {
-      try_sort_chunk();
+    auto lower_ready = [&] {
+      return new_lower.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+    };
+    // 等待较小的一半时帮忙处理其他块; 所有队列都空了说明它正在被别的线程排序,
+    // 这时睡眠到它完成(sort_chunk 完成后会唤醒)或者有新的块入队
+    while (!lower_ready()) {
+      if (!try_sort_chunk(self)) {
+        wait_for_work(lower_ready);
+      }
     }
     result.splice(result.begin(), new_lower.get());
     return result;
   }
 
-  void sort_chunk(const std::shared_ptr<chunk_to_sort>& chunk) {
-    chunk->promise.set_value(do_sort(chunk->data));
+  void sort_chunk(chunk_to_sort& chunk, unsigned self) {
+    try {
+      chunk.promise.set_value(do_sort(chunk.data, self));
+    } catch (...) {
+      chunk.promise.set_exception(std::current_exception());
+    }
+    // 可能有线程正在睡眠等待这个块; 在锁内通知保证等待方不会错过完成事件
+    {
+      std::lock_guard<std::mutex> lock(wake_mtx);
+    }
+    wake_cond.notify_all();
   }
 
-  void sort_thread() {
+  void sort_thread(unsigned self) {
     while (!end_of_data) {
-      try_sort_chunk();
-      std::this_thread::yield();
+      if (!try_sort_chunk(self)) {
+        wait_for_work([] { return false; });
+      }
     }
   }
 };
@@ -84,5 +179,112 @@ std::list<T> parallel_quick_sort(std::list<T> input) {
   }
 
   sorter<T> s;
-  return s.do_sort(input);
-}
\ No newline at end of file
+  return s.do_sort(input, 0);
+}
+
+// 在执行器上排序, 不创建线程: 块 0 是整个排序, 其余每块是一个排序线程的
+// 循环, 排序完成后这些循环退出. 调用线程也领取块, 执行器丢弃了任务或者
+// 没有空闲线程时, 调用线程独自完成排序, 晚到的循环块发现已经结束就返回
+template <typename Executor, typename T>
+std::list<T> parallel_quick_sort(Executor& executor, std::list<T> input) {
+  if (input.empty()) {
+    return input;
+  }
+
+  unsigned const workers = static_cast<unsigned>(executor.concurrency()) + 1;
+  sorter<T> s(workers, 0);
+  std::list<T> result;
+  run_blocks(executor, workers, [&](std::size_t i) {
+    unsigned const self = static_cast<unsigned>(i);
+    if (self != 0) {
+      s.sort_thread(self);
+      return;
+    }
+    try {
+      result = s.do_sort(input, 0);
+    } catch (...) {
+      s.stop();
+      throw;
+    }
+    s.stop();
+  });
+  return result;
+}
+
+int main() {
+  try {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 1000000000);
+    std::list<int> data;
+    for (int i = 0; i < 1000000; ++i) {
+      data.push_back(dist(gen));
+    }
+    std::list<int> expected = data;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    expected.sort();
+    auto end = std::chrono::high_resolution_clock::now();
+    auto std_duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    std::cout << "std::list::sort time: " << std_duration.count()
+              << " microseconds" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    std::list<int> result = parallel_quick_sort(data);
+    end = std::chrono::high_resolution_clock::now();
+    auto parallel_duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    std::cout << "parallel_quick_sort time: " << parallel_duration.count()
+              << " microseconds" << std::endl;
+
+    double speedup =
+        static_cast<double>(std_duration.count()) / parallel_duration.count();
+    std::cout << "speedup: " << speedup << "x" << std::endl;
+
+    // 在 cyber_rt 的线程池上排序, 每次调用不再创建线程
+    unsigned const pool_threads =
+        std::max(std::thread::hardware_concurrency(), 1u);
+    dm::utils::ThreadPool cyber_pool(pool_threads);
+    enqueue_executor<dm::utils::ThreadPool> cyber_exec(cyber_pool,
+                                                       pool_threads);
+    inline_executor inline_exec;
+
+    start = std::chrono::high_resolution_clock::now();
+    std::list<int> pool_result = parallel_quick_sort(cyber_exec, data);
+    end = std::chrono::high_resolution_clock::now();
+    auto pool_duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    std::cout << "parallel_quick_sort (enqueue_executor) time: "
+              << pool_duration.count() << " microseconds" << std::endl;
+
+    // 划分点取第一个元素, 已排序的大输入会退化成很深的递归, 这里只测随机输入
+    std::list<int> small = {3, 1, 2};
+    bool correct = result == expected && pool_result == expected &&
+                   parallel_quick_sort(inline_exec, data) == expected &&
+                   parallel_quick_sort(std::list<int>()).empty() &&
+                   parallel_quick_sort(cyber_exec, std::list<int>()).empty() &&
+                   parallel_quick_sort(small) == std::list<int>{1, 2, 3} &&
+                   parallel_quick_sort(cyber_exec, small) ==
+                       std::list<int>{1, 2, 3};
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
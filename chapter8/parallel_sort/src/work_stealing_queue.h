@@ -0,0 +1,52 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// 每个排序线程一个队列: 所有者在前端压入和弹出(后进先出, 刚划分的块还在缓存里),
+// 其他线程从后端窃取(最早压入的块, 通常也是最大的块)
+// 元素只移动不拷贝, 队列为空时 try_pop/try_steal 返回空的 optional 而不是
+// 抛出异常, 也不需要调用方先构造一个元素来接收
+template <typename T>
+class work_stealing_queue {
+ public:
+  work_stealing_queue() = default;
+  work_stealing_queue(const work_stealing_queue&) = delete;
+  work_stealing_queue& operator=(const work_stealing_queue&) = delete;
+
+  void push(T&& value) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    queue_.push_front(std::move(value));
+  }
+
+  std::optional<T> try_pop() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (queue_.empty()) {
+      return std::nullopt;
+    }
+    std::optional<T> value(std::move(queue_.front()));
+    queue_.pop_front();
+    return value;
+  }
+
+  std::optional<T> try_steal() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (queue_.empty()) {
+      return std::nullopt;
+    }
+    std::optional<T> value(std::move(queue_.back()));
+    queue_.pop_back();
+    return value;
+  }
+
+  bool empty() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return queue_.empty();
+  }
+
+ private:
+  std::deque<T> queue_;
+  mutable std::mutex mtx_;
+};
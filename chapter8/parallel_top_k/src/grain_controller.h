@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+// 自适应粒度(grain): 一个块至少包含多少个元素才值得交给另一个线程
+// 固定的 min_per_thread = 25 对 int 求和来说太小(线程开销远大于计算),
+// 对每个元素都很昂贵的函数又可能太大. grain_controller 为每个调用点测量
+// 每个元素的开销, 让每个块的耗时落在 10~50us:
+//   - 第一次使用时, 调用线程先处理一段逐步加倍的前缀并计时, 得到初始估计
+//   - 之后每个块完成时报告元素个数和耗时, 用指数移动平均修正估计
+//   - 按当前 grain 预测的块耗时超出 [10us, 50us] 时, 按 25us 重新计算 grain
+// 调用点由 "算法名 + 键类型" 确定; lambda 在每个调用点的类型都不同,
+// 所以以函数对象类型作为键时, 不同调用点会各自得到自己的 grain
+class grain_controller {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::nanoseconds min_chunk_time{10000};
+  static constexpr std::chrono::nanoseconds max_chunk_time{50000};
+  static constexpr std::chrono::nanoseconds target_chunk_time{25000};
+
+  grain_controller(std::string name, std::string key)
+      : name_(std::move(name)), key_(std::move(key)) {}
+
+  grain_controller(grain_controller const&) = delete;
+  grain_controller& operator=(grain_controller const&) = delete;
+
+  bool calibrated() const {
+    return grain_.load(std::memory_order_relaxed) != 0;
+  }
+
+  // 未校准时返回 1, 调用方应先调用 calibrate()
+  std::size_t grain() const {
+    return std::max<std::size_t>(grain_.load(std::memory_order_relaxed), 1);
+  }
+
+  // 未校准时在调用线程上处理 [first, first + length) 的一段前缀并计时,
+  // 样本从 16 个元素开始加倍, 直到单次耗时达到 min_chunk_time,
+  // 或者已处理的前缀达到 length 的 1/4(保证大部分工作仍然并行执行)
+  // body(begin, end) 处理一段连续区间; 如果返回 bool, true 表示可以提前结束
+  // (例如查找已经找到), 此时前缀不完整, 不用来估计开销
+  // 返回已处理的元素个数, 已校准时返回 0
+  template <typename Iterator, typename Body>
+  unsigned long calibrate(Iterator first, unsigned long length, Body&& body) {
+    if (length == 0) {
+      return 0;
+    }
+    return calibrate_prefix(
+        first, std::max(length / 4, 1ul),
+        [](Iterator& it, unsigned long n) {
+          std::advance(it, n);
+          return n;
+        },
+        body);
+  }
+
+  // 长度未知的前向区间(不想为了长度先遍历一遍): 样本在到达 last 时结束
+  template <typename Iterator, typename Body>
+  unsigned long calibrate(Iterator first, Iterator last, Body&& body) {
+    return calibrate_prefix(
+        first, ~0ul,
+        [last](Iterator& it, unsigned long n) {
+          unsigned long moved = 0;
+          for (; moved != n && it != last; ++moved) {
+            ++it;
+          }
+          return moved;
+        },
+        body);
+  }
+
+  // 报告一个块处理了多少个元素, 花了多长时间
+  // 多个线程同时更新时可能丢失一次样本, 对估计没有影响, 所以只用 relaxed
+  void observe(std::size_t elements, clock::duration elapsed) {
+    if (elements == 0) {
+      return;
+    }
+    double const sample = std::max(
+        std::chrono::duration<double, std::nano>(elapsed).count() / elements,
+        min_cost);
+    double cost = cost_.load(std::memory_order_relaxed);
+    cost = cost == 0 ? sample : cost + (sample - cost) / ewma_divisor;
+    cost_.store(cost, std::memory_order_relaxed);
+    chunks_.fetch_add(1, std::memory_order_relaxed);
+
+    std::size_t const grain = grain_.load(std::memory_order_relaxed);
+    double const predicted = cost * grain;
+    if (grain == 0 || predicted < min_chunk_time.count() ||
+        predicted > max_chunk_time.count()) {
+      grain_.store(grain_for(cost), std::memory_order_relaxed);
+    }
+  }
+
+  // 重新校准, 例如输入的特征发生了明显变化
+  void reset() {
+    grain_.store(0, std::memory_order_relaxed);
+    cost_.store(0, std::memory_order_relaxed);
+  }
+
+  std::string const& name() const { return name_; }
+  std::string const& key() const { return key_; }
+  double ns_per_element() const {
+    return cost_.load(std::memory_order_relaxed);
+  }
+  std::size_t chunks() const { return chunks_.load(std::memory_order_relaxed); }
+
+ private:
+  // next(it, n) 把 it 前进至多 n 个元素, 返回实际前进的个数
+  template <typename Iterator, typename Next, typename Body>
+  unsigned long calibrate_prefix(Iterator first, unsigned long limit,
+                                 Next next, Body& body) {
+    if (calibrated()) {
+      return 0;
+    }
+    unsigned long done = 0;
+    for (unsigned long probe = 16;; probe *= 2) {
+      Iterator last = first;
+      unsigned long const wanted = std::min(probe, limit - done);
+      unsigned long const n = next(last, wanted);
+      if (n == 0) {
+        return done;
+      }
+      auto const start = clock::now();
+      if constexpr (std::is_same_v<decltype(body(first, last)), bool>) {
+        if (body(first, last)) {
+          return done + n;
+        }
+      } else {
+        body(first, last);
+      }
+      auto const elapsed = clock::now() - start;
+      done += n;
+      first = last;
+      if (elapsed >= min_chunk_time || done == limit || n < wanted) {
+        observe(n, elapsed);
+        return done;
+      }
+    }
+  }
+
+  static constexpr double min_cost = 1e-3;  // 时钟精度之下的样本按 1ps 计
+  static constexpr double ewma_divisor = 8;
+  static constexpr double max_grain = 1ul << 32;
+
+  static std::size_t grain_for(double cost) {
+    return static_cast<std::size_t>(
+        std::clamp(target_chunk_time.count() / cost, 1.0, max_grain));
+  }
+
+  std::string const name_;
+  std::string const key_;
+  std::atomic<std::size_t> grain_{0};  // 0 表示尚未校准
+  std::atomic<double> cost_{0};        // 每个元素的开销(ns)
+  std::atomic<std::size_t> chunks_{0};
+};
+
+// 在作用域结束时把块的耗时报告给 grain_controller
+// 块因异常或提前退出而没有处理完时不报告, 调用 cancel() 即可
+class chunk_timer {
+ public:
+  chunk_timer(grain_controller& grains, std::size_t elements)
+      : grains_(grains),
+        elements_(elements),
+        exceptions_(std::uncaught_exceptions()),
+        start_(grain_controller::clock::now()) {}
+
+  chunk_timer(chunk_timer const&) = delete;
+  chunk_timer& operator=(chunk_timer const&) = delete;
+
+  ~chunk_timer() {
+    if (std::uncaught_exceptions() == exceptions_) {
+      stop();
+    }
+  }
+
+  // 立即报告, 用于块之后还有其他工作(例如等待其他线程)的场合
+  void stop() {
+    if (elements_ != 0) {
+      grains_.observe(elements_, grain_controller::clock::now() - start_);
+      elements_ = 0;
+    }
+  }
+
+  void cancel() { elements_ = 0; }
+
+ private:
+  grain_controller& grains_;
+  std::size_t elements_;
+  int const exceptions_;
+  grain_controller::clock::time_point const start_;
+};
+
+// 所有调用点的 grain_controller, 供查看每个调用点当前选择的 grain
+class grain_registry {
+ public:
+  static grain_registry& instance() {
+    static grain_registry registry;
+    return registry;
+  }
+
+  grain_controller& add(std::string name, std::string key) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    controllers_.push_back(
+        std::make_unique<grain_controller>(std::move(name), std::move(key)));
+    return *controllers_.back();
+  }
+
+  struct stats {
+    std::string name;
+    std::string key;
+    std::size_t grain;  // 0 表示尚未校准
+    double ns_per_element;
+    std::size_t chunks;  // 已观测的块数
+  };
+
+  std::vector<stats> snapshot() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<stats> result;
+    for (auto const& c : controllers_) {
+      result.push_back({c->name(), c->key(),
+                        c->calibrated() ? c->grain() : 0,
+                        c->ns_per_element(), c->chunks()});
+    }
+    return result;
+  }
+
+  void print(std::ostream& os) const {
+    for (stats const& s : snapshot()) {
+      os << s.name << " [" << s.key << "]: grain " << s.grain << ", "
+         << s.ns_per_element << " ns/element, " << s.chunks << " chunks"
+         << std::endl;
+    }
+  }
+
+ private:
+  grain_registry() = default;
+
+  mutable std::mutex mtx_;
+  std::vector<std::unique_ptr<grain_controller>> controllers_;
+};
+
+// 作为非类型模板参数的字符串字面量, 用来给调用点命名
+template <std::size_t N>
+struct grain_site_name {
+  constexpr grain_site_name(char const (&s)[N]) { std::copy_n(s, N, value); }
+  char value[N];
+};
+
+namespace detail {
+
+inline std::string demangle(char const* name) {
+  int status = 0;
+  std::unique_ptr<char, void (*)(void*)> demangled(
+      abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+  return status == 0 ? demangled.get() : name;
+}
+
+template <typename... Key>
+std::string key_name() {
+  std::string result;
+  ((result += (result.empty() ? "" : ", ") + demangle(typeid(Key).name())),
+   ...);
+  return result;
+}
+
+}  // namespace detail
+
+// 每个 (Name, Key...) 组合对应一个函数内的静态对象, 查找没有任何加锁开销
+template <grain_site_name Name, typename... Key>
+grain_controller& grain_controller_for() {
+  static grain_controller& controller = grain_registry::instance().add(
+      Name.value, detail::key_name<Key...>());
+  return controller;
+}
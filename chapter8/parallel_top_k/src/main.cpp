@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <system_error>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+#include "selection.h"
+#include "thread_pool.h"
+
+template <typename F>
+void timed(char const* name, F&& f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  f();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << name << ": "
+            << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                     start)
+                   .count()
+            << " microseconds" << std::endl;
+}
+
+// data[nth] 与排好序的 sorted[nth] 相同, 并且前后两段分别不大于/不小于它
+template <typename T, typename Compare = std::less<>>
+bool check_nth(std::vector<T> const& data, std::vector<T> const& sorted,
+               std::size_t nth, Compare comp = Compare()) {
+  T const& pivot = data[nth];
+  return !comp(pivot, sorted[nth]) && !comp(sorted[nth], pivot) &&
+         std::none_of(data.begin(), data.begin() + nth,
+                      [&](T const& x) { return comp(pivot, x); }) &&
+         std::none_of(data.begin() + nth, data.end(),
+                      [&](T const& x) { return comp(x, pivot); });
+}
+
+// 用几种输入和几个位置检查 parallel_nth_element, 包括大量重复值的情况
+template <typename Executor>
+bool check_nth_element(Executor& executor, std::vector<int> const& input) {
+  std::vector<int> sorted = input;
+  std::sort(sorted.begin(), sorted.end());
+  for (std::size_t nth : {std::size_t(0), input.size() / 3, input.size() / 2,
+                          input.size() - 1}) {
+    std::vector<int> data = input;
+    parallel_nth_element(executor, data.begin(), data.begin() + nth,
+                         data.end());
+    if (!check_nth(data, sorted, nth)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  try {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> score_dist(0.0f, 1.0f);
+    std::vector<float> scores(4000000);
+    for (float& s : scores) {
+      s = score_dist(gen);
+    }
+    std::vector<float> sorted = scores;
+    std::sort(sorted.begin(), sorted.end(), std::greater<>());
+
+    thread_pool pool;
+    pool_executor<thread_pool> pool_exec(pool);
+    inline_executor inline_exec;
+    std::size_t const k = 100;
+    std::size_t const mid = scores.size() / 2;
+    std::size_t const prefix = scores.size() / 100;
+    std::vector<float> data;
+    bool correct = true;
+
+    // 1. 得分最高的 100 个
+    std::cout << "--- top " << k << " of " << scores.size() << " scores ---"
+              << std::endl;
+    data = scores;
+    timed("std::partial_sort", [&] {
+      std::partial_sort(data.begin(), data.begin() + k, data.end(),
+                        std::greater<>());
+    });
+    std::vector<float> top;
+    timed("parallel_top_k, inline_executor", [&] {
+      top = parallel_top_k(inline_exec, scores.begin(), scores.end(), k,
+                           std::greater<>());
+    });
+    correct = correct && std::equal(top.begin(), top.end(), sorted.begin(),
+                                    sorted.begin() + k);
+    timed("parallel_top_k, pool_executor", [&] {
+      top = parallel_top_k(pool_exec, scores.begin(), scores.end(), k,
+                           std::greater<>());
+    });
+    correct = correct && top.size() == k &&
+              std::equal(top.begin(), top.end(), sorted.begin(),
+                         sorted.begin() + k);
+
+    // 2. 中位数
+    std::cout << "\n--- median ---" << std::endl;
+    data = scores;
+    timed("std::nth_element", [&] {
+      std::nth_element(data.begin(), data.begin() + mid, data.end(),
+                       std::greater<>());
+    });
+    data = scores;
+    timed("parallel_nth_element, pool_executor", [&] {
+      parallel_nth_element(pool_exec, data.begin(), data.begin() + mid,
+                           data.end(), std::greater<>());
+    });
+    correct = correct && check_nth(data, sorted, mid, std::greater<>());
+
+    // 3. 得分最高的 1% 排好序
+    std::cout << "\n--- partial sort of top " << prefix << " ---"
+              << std::endl;
+    data = scores;
+    timed("std::partial_sort", [&] {
+      std::partial_sort(data.begin(), data.begin() + prefix, data.end(),
+                        std::greater<>());
+    });
+    data = scores;
+    timed("parallel_partial_sort, pool_executor", [&] {
+      parallel_partial_sort(pool_exec, data.begin(), data.begin() + prefix,
+                            data.end(), std::greater<>());
+    });
+    correct = correct && std::equal(data.begin(), data.begin() + prefix,
+                                    sorted.begin());
+
+    // 已排序, 逆序, 只有 4 种取值, 全部相同的输入
+    std::vector<int> ints(1000000);
+    for (std::size_t i = 0; i < ints.size(); ++i) {
+      ints[i] = static_cast<int>(i);
+    }
+    correct = correct && check_nth_element(pool_exec, ints);
+    std::reverse(ints.begin(), ints.end());
+    correct = correct && check_nth_element(pool_exec, ints);
+    for (int& v : ints) {
+      v = static_cast<int>(gen() % 4);
+    }
+    correct = correct && check_nth_element(pool_exec, ints);
+    std::fill(ints.begin(), ints.end(), 7);
+    correct = correct && check_nth_element(pool_exec, ints);
+
+    // k 为 0, k 大于元素个数, 空输入
+    std::vector<float> few(scores.begin(), scores.begin() + 10);
+    std::vector<float> few_sorted = few;
+    std::sort(few_sorted.begin(), few_sorted.end());
+    correct = correct &&
+              parallel_top_k(pool_exec, scores.begin(), scores.end(), 0)
+                  .empty() &&
+              parallel_top_k(pool_exec, few.begin(), few.end(), 100) ==
+                  few_sorted &&
+              parallel_top_k(pool_exec, few.end(), few.end(), 5).empty();
+    parallel_partial_sort(pool_exec, few.begin(), few.end(), few.end());
+    correct = correct && few == few_sorted;
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
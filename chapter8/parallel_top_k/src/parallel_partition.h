@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "executor.h"
+
+// 分块并行的原地划分, 满足 pred 的元素放在前面, 与 std::partition 一样不稳定
+// 与 chapter9/quick_sort 的 parallel_partition 是同一个算法, 这里在执行器上
+// 运行: 区间从两端切成大小相同的块, 每个线程各领一个左块和一个右块,
+// 把左块中不满足 pred 的元素与右块中满足 pred 的元素成对交换, 哪一边的块
+// 处理完了就再领一个同侧的块. 每个线程退出时至多剩一个左块和一个右块
+// 没处理完, 最后把它们交换到紧挨中间的位置, 对这一小段顺序划分
+namespace partition_detail {
+
+// 每个块的元素个数, 每个线程至少分到 4 个块
+constexpr std::ptrdiff_t block_size = 1 << 10;
+constexpr std::ptrdiff_t min_blocks_per_thread = 4;
+
+template <typename Iterator, typename Predicate>
+class block_partitioner {
+ public:
+  static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+  // 一个线程退出时没处理完的左块和右块编号, none 表示没有
+  struct leftover {
+    std::size_t left = none;
+    std::size_t right = none;
+  };
+
+  block_partitioner(Iterator first, Iterator last, Predicate& pred)
+      : first_(first),
+        last_(last),
+        pred_(pred),
+        remaining_((last - first) / block_size) {}
+
+  block_partitioner(block_partitioner const&) = delete;
+  block_partitioner& operator=(block_partitioner const&) = delete;
+
+  leftover run() {
+    leftover result;
+    std::size_t left, right;
+    if (!claim(left_claimed_, left)) {
+      return result;
+    }
+    if (!claim(right_claimed_, right)) {
+      result.left = left;
+      return result;
+    }
+    Iterator l = left_block(left), l_end = l + block_size;
+    Iterator r = right_block(right), r_end = r + block_size;
+    for (;;) {
+      while (l != l_end && pred_(*l)) {
+        ++l;
+      }
+      while (r != r_end && !pred_(*r)) {
+        ++r;
+      }
+      if (l == l_end) {
+        if (!claim(left_claimed_, left)) {
+          break;
+        }
+        l = left_block(left);
+        l_end = l + block_size;
+        continue;
+      }
+      if (r == r_end) {
+        if (!claim(right_claimed_, right)) {
+          break;
+        }
+        r = right_block(right);
+        r_end = r + block_size;
+        continue;
+      }
+      std::iter_swap(l, r);
+      ++l;
+      ++r;
+    }
+    if (l != l_end) {
+      result.left = left;
+    }
+    if (r != r_end) {
+      result.right = right;
+    }
+    return result;
+  }
+
+  // 所有线程的 run() 都返回之后调用, 返回第一个不满足 pred 的位置
+  Iterator finish(std::vector<leftover> const& leftovers) {
+    std::vector<std::size_t> lefts, rights;
+    for (leftover const& l : leftovers) {
+      if (l.left != none) {
+        lefts.push_back(l.left);
+      }
+      if (l.right != none) {
+        rights.push_back(l.right);
+      }
+    }
+    std::size_t const left_count = left_claimed_.load();
+    std::size_t const right_count = right_claimed_.load();
+    pack(lefts, left_count, [this](std::size_t i) { return left_block(i); });
+    pack(rights, right_count,
+         [this](std::size_t i) { return right_block(i); });
+    // 混合区域: 未完成的左块 + 没有被领走的零头(不足一块) + 未完成的右块
+    Iterator const mixed_first =
+        first_ + (left_count - lefts.size()) * block_size;
+    Iterator const mixed_last =
+        last_ - (right_count - rights.size()) * block_size;
+    return std::partition(mixed_first, mixed_last, pred_);
+  }
+
+ private:
+  // 领取一个块; 两侧共用 remaining_ 计数, 所以左块和右块不会重叠
+  bool claim(std::atomic<std::size_t>& side, std::size_t& index) {
+    if (remaining_.fetch_sub(1) <= 0) {
+      return false;
+    }
+    index = side.fetch_add(1);
+    return true;
+  }
+
+  Iterator left_block(std::size_t i) const { return first_ + i * block_size; }
+  Iterator right_block(std::size_t i) const {
+    return last_ - (i + 1) * block_size;
+  }
+
+  // 把同侧 count 个块中未完成的块换到编号最大的位置(紧挨混合区域)
+  template <typename BlockAt>
+  static void pack(std::vector<std::size_t>& unfinished, std::size_t count,
+                   BlockAt block_at) {
+    std::sort(unfinished.begin(), unfinished.end());
+    std::size_t const target = count - unfinished.size();
+    std::vector<std::size_t> done_in_target;
+    for (std::size_t i = target; i != count; ++i) {
+      if (!std::binary_search(unfinished.begin(), unfinished.end(), i)) {
+        done_in_target.push_back(i);
+      }
+    }
+    auto next = done_in_target.begin();
+    for (std::size_t i : unfinished) {
+      if (i < target) {
+        std::swap_ranges(block_at(i), block_at(i) + block_size,
+                         block_at(*next++));
+      }
+    }
+  }
+
+  Iterator const first_;
+  Iterator const last_;
+  Predicate& pred_;
+  std::atomic<std::ptrdiff_t> remaining_;  // 还没被领走的块数
+  std::atomic<std::size_t> left_claimed_{0};
+  std::atomic<std::size_t> right_claimed_{0};
+};
+
+}  // namespace partition_detail
+
+template <typename Executor, typename Iterator, typename Predicate>
+  requires std::random_access_iterator<Iterator>
+Iterator parallel_partition(Executor& executor, Iterator first, Iterator last,
+                            Predicate pred) {
+  using namespace partition_detail;
+  std::ptrdiff_t const n = last - first;
+  std::size_t const threads = std::min<std::size_t>(
+      executor.concurrency() + 1, n / (block_size * min_blocks_per_thread));
+  if (threads <= 1) {
+    return std::partition(first, last, pred);
+  }
+  block_partitioner<Iterator, Predicate> partitioner(first, last, pred);
+  using leftover = typename block_partitioner<Iterator, Predicate>::leftover;
+  std::vector<leftover> leftovers(threads);
+  // 晚到的帮手发现没有块可领就直接返回, 不会影响结果
+  run_blocks(executor, threads,
+             [&](std::size_t i) { leftovers[i] = partitioner.run(); });
+  return partitioner.finish(leftovers);
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+#include "parallel_partition.h"
+
+// 并行选择: parallel_top_k, parallel_nth_element 和 parallel_partial_sort
+// 三者的语义都与标准库一致: "前 k 个" 指按 comp 排序后排在最前面的 k 个,
+// 要取最大的 k 个时传入 std::greater<>()
+//   - parallel_top_k 不修改输入, 每个线程维护一个最多 k 个元素的堆,
+//     堆顶是目前第 k 小的元素, 比堆顶大的元素只需要比较一次就被丢弃;
+//     最后把所有堆合并, 排序后取前 k 个. k 远小于 n 时几乎只有一次顺序扫描
+//   - parallel_nth_element 每一轮从区间中均匀抽样, 按 nth 在区间中的相对
+//     位置从样本里取两个枢轴 lo <= hi, 用两次并行划分把区间分成
+//     < lo, [lo, hi], > hi 三段, 只保留 nth 所在的一段. 枢轴取在 nth 的
+//     估计位置两侧, nth 大概率落在中间一段, 每一轮区间缩小到原来的几分之一
+//   - parallel_partial_sort 先用 parallel_nth_element 把前 k 个元素换到前面,
+//     再对这 k 个元素分块排序, 两两归并
+namespace selection_detail {
+
+// 区间短于这个长度时直接调用 std::nth_element
+constexpr std::ptrdiff_t sequential_cutoff = 1 << 15;
+// 每一轮的样本个数约为 sqrt(n), 限制在这个范围内
+constexpr std::ptrdiff_t min_samples = 256;
+constexpr std::ptrdiff_t max_samples = 1 << 14;
+// 分块排序时每块至少这么多个元素
+constexpr std::ptrdiff_t min_sort_block = 1 << 14;
+
+// 把 x 放进最多 k 个元素的堆(comp 意义下的大顶堆)
+template <typename T, typename Compare>
+void push_bounded(std::vector<T>& heap, std::size_t k, T const& x,
+                  Compare& comp) {
+  if (heap.size() < k) {
+    heap.push_back(x);
+    std::push_heap(heap.begin(), heap.end(), comp);
+  } else if (comp(x, heap.front())) {
+    std::pop_heap(heap.begin(), heap.end(), comp);
+    heap.back() = x;
+    std::push_heap(heap.begin(), heap.end(), comp);
+  }
+}
+
+// 从 [first, last) 均匀抽样, 返回 nth 两侧的两个枢轴
+// spread 为 false 时两个枢轴相同, 用于两侧的枢轴没能缩小区间的情况
+template <typename Iterator, typename Compare>
+auto sample_pivots(Iterator first, Iterator nth, Iterator last, Compare& comp,
+                   bool spread) {
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
+  std::ptrdiff_t const n = last - first;
+  std::ptrdiff_t const count = std::clamp<std::ptrdiff_t>(
+      static_cast<std::ptrdiff_t>(std::sqrt(double(n))), min_samples,
+      max_samples);
+  std::vector<value_type> samples;
+  samples.reserve(count);
+  for (std::ptrdiff_t i = 0; i < count; ++i) {
+    samples.push_back(first[n * i / count + n / (2 * count)]);
+  }
+  // nth 在样本中的估计位置, 两侧各留出约 2 倍标准差 (sqrt(count)) 的余量
+  std::ptrdiff_t const rank = (nth - first) * count / n;
+  std::ptrdiff_t const margin =
+      spread ? static_cast<std::ptrdiff_t>(std::sqrt(double(count))) : 0;
+  std::ptrdiff_t const lo = std::max<std::ptrdiff_t>(rank - margin, 0);
+  std::ptrdiff_t const hi = std::min(rank + margin, count - 1);
+  std::nth_element(samples.begin(), samples.begin() + lo, samples.end(),
+                   comp);
+  std::nth_element(samples.begin() + lo, samples.begin() + hi, samples.end(),
+                   comp);
+  return std::pair<value_type, value_type>(samples[lo], samples[hi]);
+}
+
+// 对 [first, last) 分块排序后逐轮两两归并, 块数是 2 的幂
+template <typename Executor, typename Iterator, typename Compare>
+void parallel_sort(Executor& executor, Iterator first, Iterator last,
+                   Compare& comp) {
+  std::ptrdiff_t const n = last - first;
+  std::size_t const blocks = std::bit_floor(std::max<std::size_t>(
+      std::min<std::size_t>(executor.concurrency() + 1, n / min_sort_block),
+      1));
+  auto bound = [&](std::size_t i) { return first + n * i / blocks; };
+  run_blocks(executor, blocks, [&](std::size_t i) {
+    std::sort(bound(i), bound(i + 1), comp);
+  });
+  for (std::size_t width = 1; width < blocks; width *= 2) {
+    run_blocks(executor, blocks / (2 * width), [&](std::size_t i) {
+      std::size_t const begin = 2 * width * i;
+      std::inplace_merge(bound(begin), bound(begin + width),
+                         bound(begin + 2 * width), comp);
+    });
+  }
+}
+
+}  // namespace selection_detail
+
+// 返回按 comp 排序后最前面的 min(k, n) 个元素, 已排好序; 输入不会被修改
+template <typename Executor, typename Iterator,
+          typename Compare = std::less<>>
+  requires std::random_access_iterator<Iterator>
+auto parallel_top_k(Executor& executor, Iterator first, Iterator last,
+                    std::size_t k, Compare comp = Compare()) {
+  using namespace selection_detail;
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
+  using heap_type = std::vector<value_type>;
+
+  auto add_range = [&](heap_type& heap, Iterator begin, Iterator end) {
+    for (; begin != end; ++begin) {
+      push_bounded(heap, k, *begin, comp);
+    }
+  };
+
+  unsigned long length = std::distance(first, last);
+  std::vector<heap_type> heaps(1);
+  if (k != 0 && length != 0) {
+    grain_controller& grains =
+        grain_controller_for<"parallel_top_k", Iterator, Compare>();
+    unsigned long const sampled =
+        grains.calibrate(first, length, [&](Iterator begin, Iterator end) {
+          add_range(heaps[0], begin, end);
+        });
+    first += sampled;
+    length -= sampled;
+    // 与 parallel_group_by 一样, 每个 lane 一个堆, 反复领取 grain 个元素
+    unsigned long const grain = grains.grain();
+    std::size_t const lanes = std::min<unsigned long>(
+        executor.concurrency() + 1, (length + grain - 1) / grain);
+    heaps.resize(std::max<std::size_t>(lanes, 1));
+    std::atomic<unsigned long> next{0};
+    run_blocks(executor, lanes, [&](std::size_t lane) {
+      for (;;) {
+        unsigned long const wanted = grains.grain();
+        unsigned long const begin = next.fetch_add(wanted);
+        if (begin >= length) {
+          return;
+        }
+        unsigned long const n = std::min(wanted, length - begin);
+        chunk_timer timer(grains, n);
+        add_range(heaps[lane], first + begin, first + (begin + n));
+      }
+    });
+  }
+
+  // 所有堆合计不超过 lanes * k 个元素, 顺序合并即可
+  heap_type result = std::move(heaps[0]);
+  for (std::size_t lane = 1; lane < heaps.size(); ++lane) {
+    for (value_type const& x : heaps[lane]) {
+      push_bounded(result, k, x, comp);
+    }
+  }
+  std::sort_heap(result.begin(), result.end(), comp);
+  return result;
+}
+
+// 与 std::nth_element 相同: nth 处是排序后应在该位置的元素,
+// 之前的元素都不大于它, 之后的元素都不小于它
+template <typename Executor, typename Iterator,
+          typename Compare = std::less<>>
+  requires std::random_access_iterator<Iterator>
+void parallel_nth_element(Executor& executor, Iterator first, Iterator nth,
+                          Iterator last, Compare comp = Compare()) {
+  using namespace selection_detail;
+  if (nth == last) {
+    return;
+  }
+  bool spread = true;
+  while (last - first > sequential_cutoff) {
+    auto const [lo, hi] = sample_pivots(first, nth, last, comp, spread);
+    // 两个枢轴都取自区间本身, 所以 < lo 的一段不会是整个区间,
+    // <= hi 的一段不会是空的; nth 落在两侧时区间一定会缩小
+    Iterator const lower = parallel_partition(
+        executor, first, last,
+        [&](auto const& x) { return comp(x, lo); });
+    if (nth < lower) {
+      last = lower;
+      spread = true;
+      continue;
+    }
+    Iterator const upper = parallel_partition(
+        executor, lower, last,
+        [&](auto const& x) { return !comp(hi, x); });
+    if (nth >= upper) {
+      first = upper;
+      spread = true;
+      continue;
+    }
+    // 中间一段都等于枢轴时 nth 已经就位
+    if (!comp(lo, hi)) {
+      return;
+    }
+    // 整个区间都在 [lo, hi] 内(例如只有少数几种取值)时, 下一轮改用单个枢轴,
+    // 等于枢轴的元素至少有一个, 区间一定会缩小
+    spread = lower != first || upper != last;
+    first = lower;
+    last = upper;
+  }
+  std::nth_element(first, nth, last, comp);
+}
+
+// 与 std::partial_sort 相同: [first, middle) 是排好序的前 k 个元素,
+// [middle, last) 的顺序不确定
+template <typename Executor, typename Iterator,
+          typename Compare = std::less<>>
+  requires std::random_access_iterator<Iterator>
+void parallel_partial_sort(Executor& executor, Iterator first, Iterator middle,
+                           Iterator last, Compare comp = Compare()) {
+  using namespace selection_detail;
+  if (first == middle) {
+    return;
+  }
+  parallel_nth_element(executor, first, middle, last, comp);
+  parallel_sort(executor, first, middle, comp);
+}
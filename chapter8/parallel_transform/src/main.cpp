@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <random>
+#include <system_error>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+#include "streaming_store.h"
+#include "thread_pool.h"
+#include "transform.h"
+#include "uninitialized_buffer.h"
+
+template <typename F>
+void timed(char const* name, F&& f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  f();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << name << ": "
+            << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                     start)
+                   .count()
+            << " microseconds" << std::endl;
+}
+
+// 12 字节的元素: 块边界和 16 字节对齐的边界都会落在元素中间
+struct point {
+  float x, y, z;
+  bool operator==(point const&) const = default;
+};
+
+// 小规模输入上检查各种写入方式的结果是否一致, 包括非连续的输出
+template <typename Executor>
+bool check_small(Executor& executor) {
+  std::vector<point> points(100003);
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    float const f = static_cast<float>(i);
+    points[i] = {f, -f, 2 * f};
+  }
+  auto scale = [](point const& p) { return point{p.x * 2, p.y * 2, 0}; };
+  std::vector<point> expected(points.size());
+  std::transform(points.begin(), points.end(), expected.begin(), scale);
+
+  bool correct = true;
+  for (store_policy policy :
+       {store_policy::temporal, store_policy::streaming}) {
+    // 偏移一个元素, 输出的起始地址不是 16 字节对齐的
+    std::vector<point> out(points.size() + 1);
+    auto end = parallel_transform(executor, points.begin(), points.end(),
+                                  out.begin() + 1, scale, policy);
+    correct = correct && end == out.end() &&
+              std::equal(expected.begin(), expected.end(), out.begin() + 1);
+
+    std::vector<point> copied(points.size());
+    parallel_copy(executor, points.begin(), points.end(), copied.begin(),
+                  policy);
+    correct = correct && copied == points;
+
+    std::vector<std::uint16_t> shorts(12345);
+    parallel_fill(executor, shorts.begin() + 1, shorts.end(), 7, policy);
+    correct = correct && shorts[0] == 0 &&
+              std::all_of(shorts.begin() + 1, shorts.end(),
+                          [](std::uint16_t v) { return v == 7; });
+  }
+
+  std::deque<point> deque_out(points.size());
+  parallel_transform(executor, points.begin(), points.end(),
+                     deque_out.begin(), scale, store_policy::streaming);
+  correct = correct &&
+            std::equal(expected.begin(), expected.end(), deque_out.begin());
+
+  std::vector<point> empty;
+  correct = correct && parallel_transform(executor, empty.begin(),
+                                          empty.end(), empty.begin(),
+                                          scale) == empty.end();
+  return correct;
+}
+
+int main() {
+  try {
+    // 每个数组 128MB, 大于大多数机器的末级缓存
+    std::size_t const n = std::size_t(32) << 20;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> a(n), b(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      a[i] = dist(gen);
+      b[i] = dist(gen);
+    }
+    std::cout << "last level cache: " << streaming::last_level_cache_size()
+              << " bytes, output: " << n * sizeof(float) << " bytes"
+              << std::endl;
+
+    thread_pool pool;
+    pool_executor<thread_pool> pool_exec(pool);
+    auto axpb = [](float x) { return 2.0f * x + 1.0f; };
+    auto mul = [](float x, float y) { return x * y; };
+    std::vector<float> expected(n);
+    std::vector<float> out(n);
+    bool correct = true;
+
+    // 第一次写入 uninitialized_buffer 时由工作线程 first-touch
+    std::cout << "\n--- transform y = 2x + 1 ---" << std::endl;
+    timed("std::transform", [&] {
+      std::transform(a.begin(), a.end(), expected.begin(), axpb);
+    });
+    timed("parallel_transform, temporal", [&] {
+      parallel_transform(pool_exec, a.begin(), a.end(), out.begin(), axpb,
+                         store_policy::temporal);
+    });
+    correct = correct && out == expected;
+    {
+      uninitialized_buffer<float> fresh(n);
+      timed("parallel_transform, streaming + first-touch", [&] {
+        parallel_transform(pool_exec, a.begin(), a.end(), fresh.begin(),
+                           axpb);
+      });
+      correct = correct && std::equal(fresh.begin(), fresh.end(),
+                                      expected.begin());
+    }
+    timed("parallel_transform, streaming", [&] {
+      parallel_transform(pool_exec, a.begin(), a.end(), out.begin(), axpb);
+    });
+    correct = correct && out == expected;
+
+    std::cout << "\n--- transform z = x * y ---" << std::endl;
+    timed("std::transform", [&] {
+      std::transform(a.begin(), a.end(), b.begin(), expected.begin(), mul);
+    });
+    timed("parallel_transform, temporal", [&] {
+      parallel_transform(pool_exec, a.begin(), a.end(), b.begin(),
+                         out.begin(), mul, store_policy::temporal);
+    });
+    correct = correct && out == expected;
+    timed("parallel_transform, streaming", [&] {
+      parallel_transform(pool_exec, a.begin(), a.end(), b.begin(),
+                         out.begin(), mul);
+    });
+    correct = correct && out == expected;
+
+    std::cout << "\n--- copy ---" << std::endl;
+    timed("std::copy", [&] { std::copy(a.begin(), a.end(), out.begin()); });
+    timed("parallel_copy, temporal", [&] {
+      parallel_copy(pool_exec, a.begin(), a.end(), out.begin(),
+                    store_policy::temporal);
+    });
+    correct = correct && out == a;
+    std::fill(out.begin(), out.end(), 0.0f);
+    timed("parallel_copy, streaming", [&] {
+      parallel_copy(pool_exec, a.begin(), a.end(), out.begin());
+    });
+    correct = correct && out == a;
+
+    std::cout << "\n--- fill ---" << std::endl;
+    timed("std::fill", [&] { std::fill(out.begin(), out.end(), 1.0f); });
+    timed("parallel_fill, temporal", [&] {
+      parallel_fill(pool_exec, out.begin(), out.end(), 2.0f,
+                    store_policy::temporal);
+    });
+    correct = correct && std::all_of(out.begin(), out.end(),
+                                     [](float v) { return v == 2.0f; });
+    timed("parallel_fill, streaming", [&] {
+      parallel_fill(pool_exec, out.begin(), out.end(), 3.0f);
+    });
+    correct = correct && std::all_of(out.begin(), out.end(),
+                                     [](float v) { return v == 3.0f; });
+
+    correct = correct && check_small(pool_exec);
+
+    std::cout << "\n--- Grain sizes ---" << std::endl;
+    grain_registry::instance().print(std::cout);
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
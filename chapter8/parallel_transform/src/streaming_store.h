@@ -0,0 +1,99 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STREAMING_STORE_SSE2 1
+#endif
+
+// 非临时写入(non-temporal / streaming store)
+// 普通的写入要先把目标缓存行读进缓存(read-for-ownership), 写完后再写回内存.
+// 输出比末级缓存还大时, 这些缓存行不会再被读取, 却把输入和其他线程的数据
+// 挤出了缓存. movntdq 绕过缓存, 写合并缓冲区凑满一整行后直接写入内存,
+// 省掉了 RFO 的读流量, 也不污染缓存
+// 非临时写入是弱有序的: 一个线程写完之后必须先 fence(), 之后的同步
+// (例如 run_blocks 的原子计数)才能保证其他线程看到这些数据
+// 没有 SSE2 的平台上退化为 memcpy
+namespace streaming {
+
+inline constexpr bool supported() {
+#if defined(STREAMING_STORE_SSE2)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// 末级缓存的大小, 只在第一次调用时查询; 查不到时假定为 8MB
+inline std::size_t last_level_cache_size() {
+  static std::size_t const size = [] {
+    long bytes = -1;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+    bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (bytes <= 0) {
+      bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    }
+#endif
+    return bytes > 0 ? static_cast<std::size_t>(bytes) : std::size_t(8) << 20;
+  }();
+  return size;
+}
+
+inline std::size_t page_size() {
+  static std::size_t const size = [] {
+    long const bytes = sysconf(_SC_PAGESIZE);
+    return bytes > 0 ? static_cast<std::size_t>(bytes) : std::size_t(4096);
+  }();
+  return size;
+}
+
+// 把 bytes 个字节从 src 复制到 dst; dst 中 16 字节对齐的部分用非临时写入,
+// 首尾不对齐的零头用 memcpy. src 没有对齐要求
+inline void copy(void* dst, void const* src, std::size_t bytes) {
+#if defined(STREAMING_STORE_SSE2)
+  auto* d = static_cast<unsigned char*>(dst);
+  auto const* s = static_cast<unsigned char const*>(src);
+  std::size_t const head = std::min<std::size_t>(
+      bytes, (16 - reinterpret_cast<std::uintptr_t>(d) % 16) % 16);
+  std::memcpy(d, s, head);
+  d += head;
+  s += head;
+  bytes -= head;
+  // 每次写满一个 64 字节的缓存行, 写合并缓冲区可以整行提交
+  for (; bytes >= 64; d += 64, s += 64, bytes -= 64) {
+    __m128i const v0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+    __m128i const v1 =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 16));
+    __m128i const v2 =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 32));
+    __m128i const v3 =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d), v0);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), v1);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), v2);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), v3);
+  }
+  for (; bytes >= 16; d += 16, s += 16, bytes -= 16) {
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d),
+                     _mm_loadu_si128(reinterpret_cast<__m128i const*>(s)));
+  }
+  std::memcpy(d, s, bytes);
+#else
+  std::memcpy(dst, src, bytes);
+#endif
+}
+
+// 让本线程之前的非临时写入对其他线程可见
+inline void fence() {
+#if defined(STREAMING_STORE_SSE2)
+  _mm_sfence();
+#endif
+}
+
+}  // namespace streaming
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "executor.h"
+#include "grain_controller.h"
+#include "streaming_store.h"
+
+// 写入输出区间的并行算法: parallel_transform(一元/二元), parallel_copy,
+// parallel_fill. 语义与标准库相同, 输入和输出都要求随机访问迭代器
+//   - 输出是连续内存, 元素可平凡复制, 并且总大小超过末级缓存时, 改用
+//     非临时写入(见 streaming_store.h): 结果先写进栈上 4KB 的暂存区,
+//     再整块流式写出, 暂存区一直在 L1 里
+//   - 输出连续时块的边界对齐到页边界, 每一页只由一个块写入. 输出是
+//     uninitialized_buffer 这样尚未写入过的内存时, 每一页由写它的线程
+//     first-touch, 在 NUMA 机器上落在该线程所在的节点
+// store_policy 可以强制选择写入方式, 用于对比测试
+
+enum class store_policy {
+  automatic,  // 输出大于末级缓存时使用非临时写入
+  temporal,   // 总是普通写入
+  streaming,  // 只要输出满足条件就使用非临时写入
+};
+
+namespace transform_detail {
+
+constexpr std::size_t staging_bytes = 4096;
+
+// 输出可以流式写入: 连续内存, 可平凡复制, 一个元素放得进暂存区
+template <typename OutputIt>
+inline constexpr bool streamable_v =
+    std::contiguous_iterator<OutputIt> &&
+    std::is_trivially_copyable_v<std::iter_value_t<OutputIt>> &&
+    sizeof(std::iter_value_t<OutputIt>) <= staging_bytes;
+
+template <typename OutputIt>
+bool use_streaming(store_policy policy, unsigned long length) {
+  if constexpr (streamable_v<OutputIt> && streaming::supported()) {
+    switch (policy) {
+      case store_policy::temporal:
+        return false;
+      case store_policy::streaming:
+        return true;
+      default:
+        return length * sizeof(std::iter_value_t<OutputIt>) >
+               streaming::last_level_cache_size();
+    }
+  } else {
+    (void)policy;
+    (void)length;
+    return false;
+  }
+}
+
+// 把输出的 [0, length) 切成 num_blocks 块, 返回 num_blocks + 1 个偏移
+// 输出连续时中间的边界对齐到页边界: 后一块从页边界之后第一个完整的元素
+// 开始, 跨页的那个元素归前一块. 块比一页还小时可能是空的
+template <typename OutputIt>
+std::vector<unsigned long> output_bounds(OutputIt d_first,
+                                         unsigned long length,
+                                         unsigned long num_blocks) {
+  std::vector<unsigned long> bounds(num_blocks + 1);
+  for (unsigned long i = 0; i <= num_blocks; ++i) {
+    bounds[i] = length * i / num_blocks;
+  }
+  if constexpr (std::contiguous_iterator<OutputIt>) {
+    std::size_t const size = sizeof(std::iter_value_t<OutputIt>);
+    std::uintptr_t const base =
+        reinterpret_cast<std::uintptr_t>(std::to_address(d_first));
+    std::uintptr_t const page = streaming::page_size();
+    for (unsigned long i = 1; i < num_blocks; ++i) {
+      std::uintptr_t const boundary = (base + bounds[i] * size) / page * page;
+      unsigned long const aligned =
+          boundary <= base ? 0 : (boundary - base + size - 1) / size;
+      bounds[i] = std::max(bounds[i - 1], aligned);
+    }
+  }
+  return bounds;
+}
+
+// 流式写出 out[0, n), 第 j 个元素是 make(j)
+template <typename OutputIt, typename Make>
+void streaming_write(OutputIt out, unsigned long n, Make const& make) {
+  using T = std::iter_value_t<OutputIt>;
+  if constexpr (streamable_v<OutputIt>) {
+    constexpr unsigned long tile = staging_bytes / sizeof(T);
+    alignas(64) unsigned char staging[staging_bytes];
+    T* const dst = std::to_address(out);
+    for (unsigned long i = 0; i < n; i += tile) {
+      unsigned long const m = std::min(tile, n - i);
+      for (unsigned long j = 0; j < m; ++j) {
+        ::new (staging + j * sizeof(T)) T(make(i + j));
+      }
+      streaming::copy(dst + i, staging, m * sizeof(T));
+    }
+    streaming::fence();
+  } else {
+    for (unsigned long j = 0; j < n; ++j) {
+      out[j] = make(j);
+    }
+  }
+}
+
+// 流式写出 n 个 value: 暂存区只填一次, 之后反复从它复制
+template <typename T>
+void streaming_fill(T* dst, unsigned long n, T const& value) {
+  constexpr unsigned long tile = staging_bytes / sizeof(T);
+  alignas(64) unsigned char staging[staging_bytes];
+  unsigned long const filled = std::min(tile, n);
+  for (unsigned long j = 0; j < filled; ++j) {
+    ::new (staging + j * sizeof(T)) T(value);
+  }
+  for (unsigned long i = 0; i < n; i += tile) {
+    streaming::copy(dst + i, staging, std::min(tile, n - i) * sizeof(T));
+  }
+  streaming::fence();
+}
+
+// 公共驱动: 第一次使用时在调用线程上用普通写入处理一段前缀来校准 grain,
+// 其余部分按页对齐切块交给执行器. 校准的前缀不属于任何块, 它所在的页
+// 由调用线程首次触碰. 前缀最多是输出的 1/4, 而且只在这个调用点还没有
+// 校准时出现
+// write(offset, n, stream) 写出输出的 [offset, offset + n)
+template <typename Executor, typename OutputIt, typename Write>
+void run_output_blocks(Executor& executor, grain_controller& grains,
+                       OutputIt d_first, unsigned long length, bool stream,
+                       Write const& write) {
+  unsigned long const sampled =
+      grains.calibrate(d_first, length, [&](OutputIt begin, OutputIt end) {
+        write(begin - d_first, end - begin, false);
+      });
+  unsigned long const rest = length - sampled;
+  if (rest == 0) {
+    return;
+  }
+  unsigned long const num_blocks =
+      block_count_for(executor, rest, grains.grain());
+  std::vector<unsigned long> const bounds =
+      output_bounds(d_first + sampled, rest, num_blocks);
+  run_blocks(executor, num_blocks, [&](std::size_t i) {
+    unsigned long const n = bounds[i + 1] - bounds[i];
+    chunk_timer timer(grains, n);
+    write(sampled + bounds[i], n, stream);
+  });
+}
+
+}  // namespace transform_detail
+
+template <typename Executor, typename Iterator, typename OutputIt,
+          typename UnaryOp>
+  requires(std::random_access_iterator<Iterator> &&
+           std::random_access_iterator<OutputIt>)
+OutputIt parallel_transform(Executor& executor, Iterator first, Iterator last,
+                            OutputIt d_first, UnaryOp op,
+                            store_policy policy = store_policy::automatic) {
+  using namespace transform_detail;
+  unsigned long const length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_transform", Iterator, UnaryOp>();
+  run_output_blocks(
+      executor, grains, d_first, length,
+      use_streaming<OutputIt>(policy, length),
+      [&](unsigned long offset, unsigned long n, bool stream) {
+        Iterator const in = first + offset;
+        if (stream) {
+          streaming_write(d_first + offset, n,
+                          [&](unsigned long j) { return op(in[j]); });
+        } else {
+          std::transform(in, in + n, d_first + offset, op);
+        }
+      });
+  return d_first + length;
+}
+
+template <typename Executor, typename Iterator1, typename Iterator2,
+          typename OutputIt, typename BinaryOp>
+  requires(std::random_access_iterator<Iterator1> &&
+           std::random_access_iterator<Iterator2> &&
+           std::random_access_iterator<OutputIt>)
+OutputIt parallel_transform(Executor& executor, Iterator1 first1,
+                            Iterator1 last1, Iterator2 first2,
+                            OutputIt d_first, BinaryOp op,
+                            store_policy policy = store_policy::automatic) {
+  using namespace transform_detail;
+  unsigned long const length = std::distance(first1, last1);
+  grain_controller& grains =
+      grain_controller_for<"parallel_transform (binary)", Iterator1,
+                           BinaryOp>();
+  run_output_blocks(
+      executor, grains, d_first, length,
+      use_streaming<OutputIt>(policy, length),
+      [&](unsigned long offset, unsigned long n, bool stream) {
+        Iterator1 const in1 = first1 + offset;
+        Iterator2 const in2 = first2 + offset;
+        if (stream) {
+          streaming_write(d_first + offset, n, [&](unsigned long j) {
+            return op(in1[j], in2[j]);
+          });
+        } else {
+          std::transform(in1, in1 + n, in2, d_first + offset, op);
+        }
+      });
+  return d_first + length;
+}
+
+// 输入也是连续内存并且元素类型相同时, 流式写入直接从输入复制, 不经过暂存区
+template <typename Executor, typename Iterator, typename OutputIt>
+  requires(std::random_access_iterator<Iterator> &&
+           std::random_access_iterator<OutputIt>)
+OutputIt parallel_copy(Executor& executor, Iterator first, Iterator last,
+                       OutputIt d_first,
+                       store_policy policy = store_policy::automatic) {
+  using namespace transform_detail;
+  unsigned long const length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_copy", Iterator, OutputIt>();
+  run_output_blocks(
+      executor, grains, d_first, length,
+      use_streaming<OutputIt>(policy, length),
+      [&](unsigned long offset, unsigned long n, bool stream) {
+        Iterator const in = first + offset;
+        if (!stream) {
+          std::copy(in, in + n, d_first + offset);
+        } else if constexpr (std::contiguous_iterator<Iterator> &&
+                             std::is_same_v<std::iter_value_t<Iterator>,
+                                            std::iter_value_t<OutputIt>>) {
+          streaming::copy(std::to_address(d_first + offset),
+                          std::to_address(in),
+                          n * sizeof(std::iter_value_t<OutputIt>));
+          streaming::fence();
+        } else {
+          streaming_write(d_first + offset, n,
+                          [&](unsigned long j) { return in[j]; });
+        }
+      });
+  return d_first + length;
+}
+
+// 在尚未写入过的 uninitialized_buffer 上调用时, 同时完成并行的 first-touch
+template <typename Executor, typename OutputIt, typename T>
+  requires std::random_access_iterator<OutputIt>
+void parallel_fill(Executor& executor, OutputIt first, OutputIt last,
+                   T const& value,
+                   store_policy policy = store_policy::automatic) {
+  using namespace transform_detail;
+  using value_type = std::iter_value_t<OutputIt>;
+  unsigned long const length = std::distance(first, last);
+  grain_controller& grains =
+      grain_controller_for<"parallel_fill", OutputIt>();
+  value_type const v(value);
+  run_output_blocks(
+      executor, grains, first, length,
+      use_streaming<OutputIt>(policy, length),
+      [&](unsigned long offset, unsigned long n, bool stream) {
+        if (!stream) {
+          std::fill_n(first + offset, n, v);
+        } else if constexpr (streamable_v<OutputIt>) {
+          streaming_fill(std::to_address(first + offset), n, v);
+        }
+      });
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#include "streaming_store.h"
+
+// 不初始化元素的输出缓冲区, 起始地址按页对齐
+// std::vector<T>(n) 在构造时由调用线程把所有元素清零, 操作系统按
+// first-touch 策略把每一页分配在调用线程所在的 NUMA 节点上, 之后其他节点的
+// 线程写入时都是远程访问. 这里只申请内存不写入, 页面在第一次被写入时才分配,
+// 由 parallel_transform/parallel_fill 的工作线程写入时, 每一页就落在
+// 写它的线程所在的节点上; 起始地址按页对齐, 块的边界才能与页边界对齐
+template <typename T>
+class uninitialized_buffer {
+  static_assert(std::is_trivially_copyable_v<T> &&
+                    std::is_trivially_default_constructible_v<T>,
+                "uninitialized_buffer requires a trivial element type");
+
+ public:
+  explicit uninitialized_buffer(std::size_t size)
+      : data_(static_cast<T*>(::operator new(
+            size * sizeof(T), std::align_val_t(alignment())))),
+        size_(size) {}
+
+  ~uninitialized_buffer() {
+    ::operator delete(data_, std::align_val_t(alignment()));
+  }
+
+  uninitialized_buffer(uninitialized_buffer const&) = delete;
+  uninitialized_buffer& operator=(uninitialized_buffer const&) = delete;
+
+  T* data() { return data_; }
+  T const* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  T* begin() { return data_; }
+  T* end() { return data_ + size_; }
+  T const* begin() const { return data_; }
+  T const* end() const { return data_ + size_; }
+
+  T& operator[](std::size_t i) { return data_[i]; }
+  T const& operator[](std::size_t i) const { return data_[i]; }
+
+ private:
+  static std::size_t alignment() {
+    return std::max(streaming::page_size(), alignof(T));
+  }
+
+  T* data_;
+  std::size_t size_;
+};
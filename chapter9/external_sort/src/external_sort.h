@@ -0,0 +1,351 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "file_io.h"
+#include "loser_tree.h"
+#include "multiway_merge.h"
+#include "parallel_introsort.h"
+#include "thread_pool.h"
+
+// 外部排序: 对大于内存的定长记录文件排序
+// 1. 生成初始段: 每次读入 memory_budget 字节, 用 parallel_introsort 排序,
+//    整段一次写到临时文件的末尾(大块顺序写)
+// 2. 并行合并: 用 multiway_split 把输出切成等长的部分, 二分查找先在生成段
+//    时留在内存里的样本上进行, 每个段只需要读相邻两个样本之间的一小块;
+//    每个部分由一个任务用败者树合并, 按算出的偏移量 pwrite 到
+//    输出文件, 所有线程同时参与合并, 不需要再经过一个串行的归并阶段
+// 记录必须是可平凡复制的定长类型, 这样第 i 个元素的位置可以直接算出来;
+// 日志这类变长文本可以先提取成 (时间戳, 行偏移) 之类的定长记录再排序
+struct external_sort_options {
+  // 每个初始段占用的内存, 也是合并阶段所有读写缓冲区的总预算
+  std::size_t memory_budget = std::size_t(256) << 20;
+  // 合并阶段每个缓冲区的上限, 每次 pread/pwrite 至多这么多字节
+  std::size_t io_block_size = std::size_t(4) << 20;
+  // 临时文件所在的目录, 应该是本地磁盘; 结束时连同其中的文件一起删除
+  std::filesystem::path temp_dir = std::filesystem::temp_directory_path();
+};
+
+struct external_sort_stats {
+  std::uint64_t elements = 0;
+  std::size_t runs = 0;
+  std::size_t merge_parts = 0;
+  std::chrono::microseconds run_time{0};    // 生成初始段
+  std::chrono::microseconds merge_time{0};  // 并行合并
+};
+
+namespace external_sort_detail {
+
+// 合并阶段每个缓冲区至少这么大, 太小的读写会退化成随机访问
+constexpr std::size_t min_io_block_size = std::size_t(64) << 10;
+
+// 临时文件中的一个已排序段. 生成段时排好序的数据还在内存里, 每隔
+// sample_stride 个元素留一个样本(下标是 sample_stride 的倍数), 划分时先在
+// 样本上二分查找, 只有相邻两个样本之间的一小块需要读文件(见 run_probe)
+template <typename T>
+class disk_run {
+ public:
+  disk_run(file_descriptor const& file, std::uint64_t first,
+           std::vector<T> const& sorted, std::size_t sample_stride)
+      : file_(&file),
+        first_(first),
+        length_(sorted.size()),
+        sample_stride_(sample_stride) {
+    for (std::size_t i = 0; i < length_; i += sample_stride_) {
+      samples_.push_back(sorted[i]);
+    }
+  }
+
+  std::size_t size() const { return length_; }
+
+  T operator[](std::size_t i) const {
+    if (i % sample_stride_ == 0) {
+      return samples_[i / sample_stride_];
+    }
+    T value;
+    read(i, i + 1, &value);
+    return value;
+  }
+
+  // 把 [begin, end) 读到 out, 文件比段短时抛出异常
+  void read(std::size_t begin, std::size_t end, T* out) const {
+    std::size_t const bytes = (end - begin) * sizeof(T);
+    if (file_->read_at(out, bytes, (first_ + begin) * sizeof(T)) != bytes) {
+      throw std::runtime_error("external_sort: run file truncated");
+    }
+  }
+
+  std::vector<T> const& samples() const { return samples_; }
+  std::size_t sample_stride() const { return sample_stride_; }
+  file_descriptor const& file() const { return *file_; }
+  std::uint64_t first() const { return first_; }
+
+ private:
+  file_descriptor const* file_;
+  std::uint64_t first_;  // 在临时文件中的起始元素下标
+  std::size_t length_;
+  std::size_t sample_stride_;
+  std::vector<T> samples_;
+};
+
+// 一个合并部分做 multiway_split 时对 disk_run 的视图. 二分查找先在样本上
+// 把范围缩小到相邻两个样本之间, 再把这一块(不到 sample_stride 个元素)一次
+// 读进来留在视图里, 之后几轮落在同一块里的查找不再读文件; 划分值取窗口里
+// 的样本, 也不用读文件. 每个部分有自己的视图, 缓存不需要同步
+template <typename T>
+class run_probe {
+ public:
+  explicit run_probe(disk_run<T> const& run) : run_(&run) {}
+
+  std::size_t size() const { return run_->size(); }
+
+  T operator[](std::size_t i) const {
+    std::size_t const stride = run_->sample_stride();
+    if (i % stride == 0) {
+      return run_->samples()[i / stride];
+    }
+    return block(i / stride)[i % stride];
+  }
+
+  // 划分值的位置: 取 [lo, hi) 里最靠近中间的样本, 没有样本时取中间
+  std::size_t pivot(std::size_t lo, std::size_t hi) const {
+    std::size_t const stride = run_->sample_stride();
+    std::size_t const mid = lo + (hi - lo) / 2;
+    std::size_t const below = mid / stride * stride;
+    std::size_t const above = below + stride;
+    if (below >= lo && (above >= hi || mid - below <= above - mid)) {
+      return below;
+    }
+    return above < hi ? above : mid;
+  }
+
+  // [lo, hi) 中第一个使 pred 为 false 的位置
+  template <typename Pred>
+  std::size_t partition_point(std::size_t lo, std::size_t hi,
+                              Pred pred) const {
+    if (lo == hi) {
+      return lo;
+    }
+    std::size_t const stride = run_->sample_stride();
+    auto const& samples = run_->samples();
+    // 落在 [lo, hi) 里的样本是 samples[a, b)
+    std::size_t const a = (lo + stride - 1) / stride;
+    std::size_t const b = (hi + stride - 1) / stride;
+    std::size_t const t = static_cast<std::size_t>(
+        std::partition_point(samples.begin() + a, samples.begin() + b, pred) -
+        samples.begin());
+    // 结果在前一个满足 pred 的样本之后, 不超过第一个不满足的样本
+    std::size_t begin = t > a ? (t - 1) * stride + 1 : lo;
+    std::size_t const end = t < b ? t * stride : hi;
+    if (begin == end) {
+      return begin;
+    }
+    std::vector<T> const& data = block(begin / stride);
+    std::size_t const base = begin / stride * stride;
+    for (std::size_t count = end - begin; count != 0;) {
+      std::size_t const half = count / 2;
+      if (pred(data[begin + half - base])) {
+        begin += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return begin;
+  }
+
+ private:
+  // 第 index 块: [index * stride, (index + 1) * stride) 与段的交集
+  std::vector<T> const& block(std::size_t index) const {
+    if (!cached_ || cached_index_ != index) {
+      std::size_t const stride = run_->sample_stride();
+      std::size_t const begin = index * stride;
+      std::size_t const end = std::min(begin + stride, run_->size());
+      cache_.resize(end - begin);
+      run_->read(begin, end, cache_.data());
+      cached_ = true;
+      cached_index_ = index;
+    }
+    return cache_;
+  }
+
+  disk_run<T> const* run_;
+  mutable std::vector<T> cache_;
+  mutable std::size_t cached_index_ = 0;
+  mutable bool cached_ = false;
+};
+
+// 顺序读取段的一部分 [begin, end), 每次读满一个缓冲区, 用作 loser_tree 的一路
+template <typename T>
+class run_reader {
+ public:
+  using value_type = T;
+
+  run_reader(disk_run<T> const& run, std::size_t begin, std::size_t end,
+             std::size_t buffer_elements)
+      : file_(&run.file()),
+        next_(run.first() + begin),
+        end_(run.first() + end),
+        buffer_elements_(buffer_elements) {}
+
+  bool next(T& value) {
+    if (pos_ == buffer_.size()) {
+      if (next_ == end_) {
+        return false;
+      }
+      std::size_t const n = static_cast<std::size_t>(
+          std::min<std::uint64_t>(buffer_elements_, end_ - next_));
+      buffer_.resize(n);
+      if (file_->read_at(buffer_.data(), n * sizeof(T), next_ * sizeof(T)) !=
+          n * sizeof(T)) {
+        throw std::runtime_error("external_sort: run file truncated");
+      }
+      next_ += n;
+      pos_ = 0;
+    }
+    value = buffer_[pos_++];
+    return true;
+  }
+
+ private:
+  file_descriptor const* file_;
+  std::uint64_t next_;  // 下一次从文件读取的元素下标
+  std::uint64_t end_;
+  std::size_t buffer_elements_;
+  std::vector<T> buffer_;
+  std::size_t pos_ = 0;
+};
+
+// 攒满一个缓冲区再按偏移量写出
+template <typename T>
+class run_writer {
+ public:
+  run_writer(file_descriptor& file, std::uint64_t first,
+             std::size_t buffer_elements)
+      : file_(file), next_(first) {
+    buffer_.reserve(buffer_elements);
+  }
+
+  void push(T const& value) {
+    buffer_.push_back(value);
+    if (buffer_.size() == buffer_.capacity()) {
+      flush();
+    }
+  }
+
+  void flush() {
+    file_.write_at(buffer_.data(), buffer_.size() * sizeof(T),
+                   next_ * sizeof(T));
+    next_ += buffer_.size();
+    buffer_.clear();
+  }
+
+ private:
+  file_descriptor& file_;
+  std::uint64_t next_;  // 下一次写出的元素下标
+  std::vector<T> buffer_;
+};
+
+}  // namespace external_sort_detail
+
+template <typename T, typename Compare = std::less<>>
+external_sort_stats external_sort(thread_pool& pool,
+                                  std::filesystem::path const& input,
+                                  std::filesystem::path const& output,
+                                  Compare comp = Compare(),
+                                  external_sort_options const& options = {}) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "external_sort needs fixed-size, trivially copyable records");
+  using namespace external_sort_detail;
+  using clock = std::chrono::steady_clock;
+
+  file_descriptor in(input, O_RDONLY);
+  std::uint64_t const bytes = in.size();
+  if (bytes % sizeof(T) != 0) {
+    throw std::runtime_error(
+        "external_sort: input size is not a multiple of the record size");
+  }
+  external_sort_stats stats;
+  stats.elements = bytes / sizeof(T);
+
+  temp_directory temp(options.temp_dir);
+  file_descriptor runs_file(temp.path() / "runs",
+                            O_RDWR | O_CREAT | O_TRUNC);
+
+  // 1. 生成初始段
+  auto const run_start = clock::now();
+  std::size_t const run_capacity =
+      std::max<std::size_t>(options.memory_budget / sizeof(T), 1);
+  std::vector<disk_run<T>> runs;
+  // 每块样本间隔的数据正好是一个最小的读缓冲区
+  std::size_t const sample_stride =
+      std::max<std::size_t>(min_io_block_size / sizeof(T), 1);
+  {
+    std::vector<T> buffer;
+    for (std::uint64_t first = 0; first < stats.elements;
+         first += run_capacity) {
+      std::size_t const n = static_cast<std::size_t>(
+          std::min<std::uint64_t>(run_capacity, stats.elements - first));
+      buffer.resize(n);
+      if (in.read_at(buffer.data(), n * sizeof(T), first * sizeof(T)) !=
+          n * sizeof(T)) {
+        throw std::runtime_error("external_sort: input changed while sorting");
+      }
+      parallel_introsort(pool, buffer.begin(), buffer.end(), comp);
+      runs_file.write_at(buffer.data(), n * sizeof(T), first * sizeof(T));
+      runs.emplace_back(runs_file, first, buffer, sample_stride);
+    }
+  }
+  stats.runs = runs.size();
+  stats.run_time = std::chrono::duration_cast<std::chrono::microseconds>(
+      clock::now() - run_start);
+
+  // 2. 并行合并
+  auto const merge_start = clock::now();
+  file_descriptor out(output, O_WRONLY | O_CREAT | O_TRUNC);
+  out.truncate(bytes);
+  std::size_t const hardware_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  std::size_t const parts = static_cast<std::size_t>(std::clamp<std::uint64_t>(
+      stats.elements / (options.io_block_size / sizeof(T) + 1),
+      1, hardware_threads * merge_detail::parts_per_thread));
+  // 同时进行的部分不超过线程数, 每个部分有 k 个读缓冲区和 1 个写缓冲区
+  std::size_t const block_bytes = std::clamp(
+      options.memory_budget /
+          (std::min(parts, hardware_threads) * (runs.size() + 1)),
+      std::min(min_io_block_size, options.io_block_size),
+      options.io_block_size);
+  std::size_t const block_elements =
+      std::max<std::size_t>(block_bytes / sizeof(T), 1);
+  stats.merge_parts = parts;
+
+  merge_detail::run_parts(pool, parts, [&](std::size_t p) {
+    std::uint64_t const first = stats.elements * p / parts;
+    std::uint64_t const last = stats.elements * (p + 1) / parts;
+    std::vector<run_probe<T>> const probes(runs.begin(), runs.end());
+    std::vector<std::size_t> const begin = multiway_split(probes, first, comp);
+    std::vector<std::size_t> const end = multiway_split(probes, last, comp);
+    std::vector<run_reader<T>> readers;
+    for (std::size_t j = 0; j != runs.size(); ++j) {
+      readers.emplace_back(runs[j], begin[j], end[j], block_elements);
+    }
+    loser_tree<run_reader<T>, Compare> tree(readers, comp);
+    run_writer<T> writer(out, first, block_elements);
+    for (; !tree.empty(); tree.pop()) {
+      writer.push(tree.top());
+    }
+    writer.flush();
+  });
+  stats.merge_time = std::chrono::duration_cast<std::chrono::microseconds>(
+      clock::now() - merge_start);
+  return stats;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// 按偏移量读写的文件描述符
+// pread/pwrite 不使用也不修改文件位置, 多个线程可以共用一个描述符
+// 各自读写文件的不同部分, 不需要加锁
+class file_descriptor {
+ public:
+  file_descriptor(std::filesystem::path const& path, int flags,
+                  mode_t mode = 0644)
+      : fd_(::open(path.c_str(), flags | O_CLOEXEC, mode)) {
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              "open " + path.string());
+    }
+  }
+
+  file_descriptor(file_descriptor&& other) noexcept
+      : fd_(std::exchange(other.fd_, -1)) {}
+  file_descriptor& operator=(file_descriptor&& other) noexcept {
+    std::swap(fd_, other.fd_);
+    return *this;
+  }
+  file_descriptor(file_descriptor const&) = delete;
+  file_descriptor& operator=(file_descriptor const&) = delete;
+
+  ~file_descriptor() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  std::uint64_t size() const {
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+      throw std::system_error(errno, std::generic_category(), "fstat");
+    }
+    return static_cast<std::uint64_t>(st.st_size);
+  }
+
+  void truncate(std::uint64_t size) {
+    if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+      throw std::system_error(errno, std::generic_category(), "ftruncate");
+    }
+  }
+
+  // 读取至多 n 个字节, 只有到达文件末尾时才会少于 n, 返回实际读到的字节数
+  std::size_t read_at(void* data, std::size_t n, std::uint64_t offset) const {
+    char* p = static_cast<char*>(data);
+    std::size_t done = 0;
+    while (done != n) {
+      ssize_t const r = ::pread(fd_, p + done, n - done,
+                                static_cast<off_t>(offset + done));
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "pread");
+      }
+      if (r == 0) {
+        break;
+      }
+      done += static_cast<std::size_t>(r);
+    }
+    return done;
+  }
+
+  void write_at(void const* data, std::size_t n, std::uint64_t offset) {
+    char const* p = static_cast<char const*>(data);
+    std::size_t done = 0;
+    while (done != n) {
+      ssize_t const r = ::pwrite(fd_, p + done, n - done,
+                                 static_cast<off_t>(offset + done));
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "pwrite");
+      }
+      done += static_cast<std::size_t>(r);
+    }
+  }
+
+ private:
+  int fd_;
+};
+
+// 在 parent 下创建一个名字唯一的临时目录, 析构时连同其中的文件一起删除
+class temp_directory {
+ public:
+  explicit temp_directory(std::filesystem::path const& parent) {
+    std::string pattern = (parent / "external_sort-XXXXXX").string();
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    if (::mkdtemp(name.data()) == nullptr) {
+      throw std::system_error(errno, std::generic_category(),
+                              "mkdtemp " + pattern);
+    }
+    path_ = name.data();
+  }
+
+  temp_directory(temp_directory const&) = delete;
+  temp_directory& operator=(temp_directory const&) = delete;
+
+  ~temp_directory() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+  }
+
+  std::filesystem::path const& path() const { return path_; }
+
+ private:
+  std::filesystem::path path_;
+};
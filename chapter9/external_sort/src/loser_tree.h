@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// k 路合并用的败者树
+// 每个内部节点记住在这里输掉比较的那一路, 根之上(tree_[0])是总的胜者
+// 取走胜者之后只需要沿着它的叶子到根的路径重新比较 log2(k) 次;
+// 与二叉堆相比, 每层只和一个节点比较, 不用比较两个孩子
+// Source 需要提供 value_type 和 bool next(value_type&), 返回 false 表示已取完
+// 相等的元素按路的编号先后输出, 所以合并是稳定的
+template <typename Source, typename Compare>
+class loser_tree {
+ public:
+  using value_type = typename Source::value_type;
+
+  loser_tree(std::vector<Source>& sources, Compare comp)
+      : sources_(sources),
+        comp_(comp),
+        keys_(sources.size()),
+        live_(sources.size()),
+        tree_(std::max<std::size_t>(sources.size(), 1)) {
+    std::size_t const k = sources_.size();
+    for (std::size_t i = 0; i != k; ++i) {
+      live_[i] = sources_[i].next(keys_[i]);
+    }
+    // 自底向上建树: 叶子 i 位于 k + i, 节点 n 的孩子是 2n 和 2n + 1
+    std::vector<std::size_t> winner(2 * k);
+    for (std::size_t i = 0; i != k; ++i) {
+      winner[k + i] = i;
+    }
+    for (std::size_t n = k > 1 ? k - 1 : 0; n != 0; --n) {
+      std::size_t a = winner[2 * n], b = winner[2 * n + 1];
+      if (beats(b, a)) {
+        std::swap(a, b);
+      }
+      winner[n] = a;
+      tree_[n] = b;
+    }
+    tree_[0] = k > 1 ? winner[1] : 0;
+  }
+
+  loser_tree(loser_tree const&) = delete;
+  loser_tree& operator=(loser_tree const&) = delete;
+
+  bool empty() const { return sources_.empty() || !live_[tree_[0]]; }
+
+  value_type const& top() const { return keys_[tree_[0]]; }
+
+  // 取走胜者, 从同一路补充下一个元素
+  void pop() {
+    std::size_t s = tree_[0];
+    live_[s] = sources_[s].next(keys_[s]);
+    for (std::size_t n = (s + sources_.size()) / 2; n >= 1; n /= 2) {
+      if (beats(tree_[n], s)) {
+        std::swap(tree_[n], s);
+      }
+    }
+    tree_[0] = s;
+  }
+
+ private:
+  // a 路的当前元素是否应该先于 b 路输出; 取完的路总是输
+  bool beats(std::size_t a, std::size_t b) const {
+    if (!live_[a] || !live_[b]) {
+      return live_[a];
+    }
+    if (comp_(keys_[a], keys_[b])) {
+      return true;
+    }
+    if (comp_(keys_[b], keys_[a])) {
+      return false;
+    }
+    return a < b;
+  }
+
+  std::vector<Source>& sources_;
+  Compare comp_;
+  std::vector<value_type> keys_;  // 每一路的当前元素
+  std::vector<bool> live_;        // 每一路是否还有元素
+  std::vector<std::size_t> tree_;
+};
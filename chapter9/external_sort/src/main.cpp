@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+#include "external_sort.h"
+#include "file_io.h"
+#include "multiway_merge.h"
+#include "thread_pool.h"
+
+// 从日志中提取出的定长记录, 按时间戳排序
+struct log_record {
+  std::uint64_t timestamp;
+  std::uint32_t host;
+  std::uint32_t line;
+};
+
+struct by_timestamp {
+  bool operator()(log_record const& a, log_record const& b) const {
+    return a.timestamp < b.timestamp;
+  }
+};
+
+template <typename T>
+void write_file(std::filesystem::path const& path, std::vector<T> const& data) {
+  file_descriptor f(path, O_WRONLY | O_CREAT | O_TRUNC);
+  f.write_at(data.data(), data.size() * sizeof(T), 0);
+}
+
+template <typename T>
+std::vector<T> read_file(std::filesystem::path const& path) {
+  file_descriptor f(path, O_RDONLY);
+  std::vector<T> data(f.size() / sizeof(T));
+  f.read_at(data.data(), data.size() * sizeof(T), 0);
+  return data;
+}
+
+// 排序结果与内存中排序的结果比较: 时间戳逐个相同, 并且记录没有丢失或重复
+bool same_records(std::vector<log_record> result,
+                  std::vector<log_record> expected) {
+  auto key = [](log_record const& r) {
+    return std::tuple(r.timestamp, r.host, r.line);
+  };
+  auto by_key = [&](log_record const& a, log_record const& b) {
+    return key(a) < key(b);
+  };
+  if (result.size() != expected.size() ||
+      !std::is_sorted(result.begin(), result.end(), by_timestamp())) {
+    return false;
+  }
+  std::sort(result.begin(), result.end(), by_key);
+  std::sort(expected.begin(), expected.end(), by_key);
+  return std::equal(result.begin(), result.end(), expected.begin(),
+                    [&](log_record const& a, log_record const& b) {
+                      return key(a) == key(b);
+                    });
+}
+
+bool check_multiway_merge(thread_pool& pool, int max_value) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(0, max_value);
+  std::vector<std::vector<int>> runs(7);
+  std::vector<int> expected;
+  for (std::size_t j = 0; j < runs.size(); ++j) {
+    runs[j].resize(j * 30000);
+    for (int& v : runs[j]) {
+      v = dist(gen);
+    }
+    std::sort(runs[j].begin(), runs[j].end());
+    expected.insert(expected.end(), runs[j].begin(), runs[j].end());
+  }
+  std::sort(expected.begin(), expected.end());
+
+  std::vector<std::span<int const>> spans(runs.begin(), runs.end());
+  std::vector<int> result(expected.size());
+  parallel_multiway_merge(pool, spans, result.data());
+  return result == expected;
+}
+
+int main() {
+  try {
+    thread_pool pool;
+    temp_directory work(std::filesystem::temp_directory_path());
+
+    std::mt19937_64 gen(42);
+    std::uniform_int_distribution<std::uint64_t> dist(0, 1u << 30);
+    std::vector<log_record> records(1000000);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      records[i] = {dist(gen), static_cast<std::uint32_t>(i % 64),
+                    static_cast<std::uint32_t>(i)};
+    }
+    write_file(work.path() / "input", records);
+
+    std::vector<log_record> expected = records;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::sort(expected.begin(), expected.end(), by_timestamp());
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "in-memory std::sort time: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                       start)
+                     .count()
+              << " microseconds" << std::endl;
+
+    // 内存预算只有数据量的 1/8, 产生 8 个初始段
+    // 缓冲区也取得较小, 让合并切成更多的部分
+    external_sort_options options;
+    options.memory_budget = records.size() * sizeof(log_record) / 8;
+    options.io_block_size = std::size_t(256) << 10;
+    options.temp_dir = work.path();
+    external_sort_stats stats =
+        external_sort<log_record>(pool, work.path() / "input",
+                                  work.path() / "output", by_timestamp(),
+                                  options);
+    std::cout << "external_sort: " << stats.elements << " records, "
+              << stats.runs << " runs (" << stats.run_time.count()
+              << " microseconds), " << stats.merge_parts
+              << " merge parts (" << stats.merge_time.count()
+              << " microseconds)" << std::endl;
+    bool correct =
+        same_records(read_file<log_record>(work.path() / "output"), expected);
+
+    // 空输入
+    write_file(work.path() / "empty", std::vector<log_record>());
+    external_sort<log_record>(pool, work.path() / "empty",
+                              work.path() / "empty_output", by_timestamp(),
+                              options);
+    correct = correct &&
+              read_file<log_record>(work.path() / "empty_output").empty();
+
+    // 文件长度不是记录长度的整数倍
+    write_file(work.path() / "partial", std::vector<char>(5));
+    try {
+      external_sort<log_record>(pool, work.path() / "partial",
+                                work.path() / "partial_output",
+                                by_timestamp(), options);
+      correct = false;
+    } catch (std::runtime_error const&) {
+    }
+
+    // 内存中的并行合并, 包括大量重复值的情况
+    correct = correct && check_multiway_merge(pool, 1000000) &&
+              check_multiway_merge(pool, 3);
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "system error, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
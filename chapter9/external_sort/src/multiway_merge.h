@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "loser_tree.h"
+#include "thread_pool.h"
+
+// 多路划分(co-ranking): 在 k 个已排序的序列中找出合并结果的前 rank 个元素
+// 来自哪里, 返回每个序列的划分位置 split[j], Σ split[j] == rank
+// 合并结果按 (值, 序列编号, 位置) 排序, 与 loser_tree 的输出顺序一致,
+// 所以对不同的 rank 求出的划分位置各自单调, 相邻两次划分之间的部分可以独立合并
+// 每一轮在窗口最大的序列中取中间元素 v, 在每个序列的窗口里二分查找 v:
+//   - 小于 v 的元素已经超过 rank 个: 划分点都在它们之前, 收缩上界
+//   - 不大于 v 的元素不足 rank 个: 划分点都在它们之后, 收缩下界
+//   - 否则划分值就是 v: 取所有小于 v 的元素, 再按序列编号补足等于 v 的元素
+// 每一轮至少把最大的窗口减半, 共 O(k log n) 轮, 每轮 k 次二分查找
+// Sequence 只需要 size() 和 operator[], 所以也可以是磁盘上的段. 访问元素
+// 代价高的序列可以另外提供 partition_point(lo, hi, pred) 代替逐个元素的
+// 二分查找, 以及 pivot(lo, hi) 指定窗口里用作划分值的元素; 划分值不在正中
+// 时窗口不一定减半, 但每一轮仍然至少缩小一个元素
+template <typename Sequence, typename Compare>
+std::vector<std::size_t> multiway_split(std::vector<Sequence> const& seqs,
+                                        std::size_t rank, Compare comp) {
+  std::size_t const k = seqs.size();
+  std::vector<std::size_t> lo(k, 0), hi(k), less(k), less_equal(k);
+  for (std::size_t j = 0; j != k; ++j) {
+    hi[j] = seqs[j].size();
+  }
+  // [lo, hi) 中第一个使 pred 为 false 的位置
+  auto partition_point = [](Sequence const& seq, std::size_t lo,
+                            std::size_t hi, auto pred) {
+    if constexpr (requires { seq.partition_point(lo, hi, pred); }) {
+      return seq.partition_point(lo, hi, pred);
+    } else {
+      while (lo != hi) {
+        std::size_t const mid = lo + (hi - lo) / 2;
+        if (pred(seq[mid])) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo;
+    }
+  };
+
+  for (;;) {
+    std::size_t m = 0;
+    for (std::size_t j = 1; j < k; ++j) {
+      if (hi[j] - lo[j] > hi[m] - lo[m]) {
+        m = j;
+      }
+    }
+    if (k == 0 || hi[m] == lo[m]) {
+      return lo;
+    }
+    std::size_t pivot = lo[m] + (hi[m] - lo[m]) / 2;
+    if constexpr (requires { seqs[m].pivot(lo[m], hi[m]); }) {
+      pivot = seqs[m].pivot(lo[m], hi[m]);
+    }
+    auto const value = seqs[m][pivot];
+    std::size_t total_less = 0, total_less_equal = 0;
+    for (std::size_t j = 0; j != k; ++j) {
+      less[j] = partition_point(seqs[j], lo[j], hi[j], [&](auto const& x) {
+        return comp(x, value);
+      });
+      less_equal[j] = partition_point(
+          seqs[j], less[j], hi[j],
+          [&](auto const& x) { return !comp(value, x); });
+      total_less += less[j];
+      total_less_equal += less_equal[j];
+    }
+    if (rank < total_less) {
+      hi = less;
+    } else if (rank > total_less_equal) {
+      lo = less_equal;
+    } else {
+      std::size_t extra = rank - total_less;
+      for (std::size_t j = 0; j != k; ++j) {
+        std::size_t const take = std::min(extra, less_equal[j] - less[j]);
+        less[j] += take;
+        extra -= take;
+      }
+      return less;
+    }
+  }
+}
+
+namespace merge_detail {
+
+// 把 parts 个部分交给线程池, 调用线程执行第 0 部分, 等待时帮忙执行其他任务
+// 所有部分都结束后才重新抛出第一个异常, 之后不会有任务还在访问调用方的数据
+template <typename Body>
+void run_parts(thread_pool& pool, std::size_t parts, Body const& body) {
+  std::vector<std::future<void>> futures;
+  std::exception_ptr error;
+  try {
+    for (std::size_t p = 1; p < parts; ++p) {
+      futures.push_back(pool.submit([&body, p] { body(p); }));
+    }
+    body(0);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  for (auto& f : futures) {
+    while (f.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::timeout) {
+      pool.run_pending_task();
+    }
+  }
+  for (auto& f : futures) {
+    try {
+      f.get();
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// 每个线程合并的部分个数; 多于一个可以在部分之间的耗时不均时平衡负载
+constexpr std::size_t parts_per_thread = 2;
+
+}  // namespace merge_detail
+
+// 内存中已排序区间的游标, 用作 loser_tree 的一路
+template <typename T>
+class span_source {
+ public:
+  using value_type = T;
+
+  explicit span_source(std::span<T const> s) : s_(s) {}
+
+  bool next(T& value) {
+    if (pos_ == s_.size()) {
+      return false;
+    }
+    value = s_[pos_++];
+    return true;
+  }
+
+ private:
+  std::span<T const> s_;
+  std::size_t pos_ = 0;
+};
+
+// 并行 k 路合并: 用 multiway_split 把输出切成等长的部分,
+// 每个部分各自用败者树合并, 写到 out 中对应的位置
+template <typename T, typename Compare = std::less<>>
+void parallel_multiway_merge(thread_pool& pool,
+                             std::vector<std::span<T const>> const& runs,
+                             T* out, Compare comp = Compare()) {
+  std::size_t const total = std::accumulate(
+      runs.begin(), runs.end(), std::size_t(0),
+      [](std::size_t n, std::span<T const> s) { return n + s.size(); });
+  std::size_t const hardware_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  std::size_t const parts = std::max<std::size_t>(
+      std::min(hardware_threads * merge_detail::parts_per_thread,
+               total / (1 << 14)),
+      1);
+
+  merge_detail::run_parts(pool, parts, [&](std::size_t p) {
+    std::size_t const first = total * p / parts;
+    std::size_t const last = total * (p + 1) / parts;
+    std::vector<std::size_t> const begin = multiway_split(runs, first, comp);
+    std::vector<std::size_t> const end = multiway_split(runs, last, comp);
+    std::vector<span_source<T>> sources;
+    for (std::size_t j = 0; j != runs.size(); ++j) {
+      sources.emplace_back(runs[j].subspan(begin[j], end[j] - begin[j]));
+    }
+    loser_tree<span_source<T>, Compare> tree(sources, comp);
+    for (T* o = out + first; !tree.empty(); tree.pop()) {
+      *o++ = tree.top();
+    }
+  });
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+// 可以递归对半切分的迭代空间, 供 parallel_for 使用
+// blocked_range 是一维区间 [begin, end), 元素个数超过 grainsize 时可以切分;
+// blocked_range2d/3d 是几个一维区间的笛卡尔积, 每次只切一个维度:
+// 选 size / grainsize 最大的那一维, 也就是相对于块大小最 "长" 的一边,
+// 切出来的子块始终接近 grainsize 给定的形状(例如 32x32 的方块),
+// 而不是按行切成又扁又长的条带
+// 所有区间都满足 Range 的要求:
+//   bool empty() const;                        是否为空
+//   bool is_divisible() const;                 是否还能切分
+//   std::pair<Range, Range> split() const;     对半切成前后两部分
+
+template <typename Value>
+class blocked_range {
+ public:
+  using value_type = Value;
+
+  // grainsize 为 0 时按 1 处理
+  blocked_range(Value begin, Value end, std::size_t grainsize = 1)
+      : begin_(begin),
+        end_(end),
+        grainsize_(grainsize != 0 ? grainsize : 1) {}
+
+  Value begin() const { return begin_; }
+  Value end() const { return end_; }
+  std::size_t size() const { return static_cast<std::size_t>(end_ - begin_); }
+  std::size_t grainsize() const { return grainsize_; }
+  bool empty() const { return !(begin_ < end_); }
+
+  bool is_divisible() const { return size() > grainsize_; }
+
+  std::pair<blocked_range, blocked_range> split() const {
+    Value const middle = begin_ + (end_ - begin_) / 2;
+    return {blocked_range(begin_, middle, grainsize_),
+            blocked_range(middle, end_, grainsize_)};
+  }
+
+  // 相对于 grainsize 的长度, 多维区间用它选择切分的维度
+  double relative_size() const {
+    return static_cast<double>(size()) / static_cast<double>(grainsize_);
+  }
+
+ private:
+  Value begin_;
+  Value end_;
+  std::size_t grainsize_;
+};
+
+template <typename RowValue, typename ColValue = RowValue>
+class blocked_range2d {
+ public:
+  using row_range_type = blocked_range<RowValue>;
+  using col_range_type = blocked_range<ColValue>;
+
+  blocked_range2d(row_range_type rows, col_range_type cols)
+      : rows_(rows), cols_(cols) {}
+
+  blocked_range2d(RowValue row_begin, RowValue row_end,
+                  std::size_t row_grainsize, ColValue col_begin,
+                  ColValue col_end, std::size_t col_grainsize)
+      : rows_(row_begin, row_end, row_grainsize),
+        cols_(col_begin, col_end, col_grainsize) {}
+
+  row_range_type const& rows() const { return rows_; }
+  col_range_type const& cols() const { return cols_; }
+  bool empty() const { return rows_.empty() || cols_.empty(); }
+
+  bool is_divisible() const {
+    return rows_.is_divisible() || cols_.is_divisible();
+  }
+
+  std::pair<blocked_range2d, blocked_range2d> split() const {
+    if (split_rows()) {
+      auto const [first, second] = rows_.split();
+      return {blocked_range2d(first, cols_), blocked_range2d(second, cols_)};
+    }
+    auto const [first, second] = cols_.split();
+    return {blocked_range2d(rows_, first), blocked_range2d(rows_, second)};
+  }
+
+ private:
+  bool split_rows() const {
+    if (!cols_.is_divisible()) {
+      return true;
+    }
+    return rows_.is_divisible() &&
+           rows_.relative_size() > cols_.relative_size();
+  }
+
+  row_range_type rows_;
+  col_range_type cols_;
+};
+
+template <typename PageValue, typename RowValue = PageValue,
+          typename ColValue = RowValue>
+class blocked_range3d {
+ public:
+  using page_range_type = blocked_range<PageValue>;
+  using row_range_type = blocked_range<RowValue>;
+  using col_range_type = blocked_range<ColValue>;
+
+  blocked_range3d(page_range_type pages, row_range_type rows,
+                  col_range_type cols)
+      : pages_(pages), rows_(rows), cols_(cols) {}
+
+  page_range_type const& pages() const { return pages_; }
+  row_range_type const& rows() const { return rows_; }
+  col_range_type const& cols() const { return cols_; }
+  bool empty() const {
+    return pages_.empty() || rows_.empty() || cols_.empty();
+  }
+
+  bool is_divisible() const {
+    return pages_.is_divisible() || rows_.is_divisible() ||
+           cols_.is_divisible();
+  }
+
+  std::pair<blocked_range3d, blocked_range3d> split() const {
+    // 在能切分的维度里选相对长度最大的一维
+    double const pages = pages_.is_divisible() ? pages_.relative_size() : 0;
+    double const rows = rows_.is_divisible() ? rows_.relative_size() : 0;
+    double const cols = cols_.is_divisible() ? cols_.relative_size() : 0;
+    if (pages >= rows && pages >= cols) {
+      auto const [first, second] = pages_.split();
+      return {blocked_range3d(first, rows_, cols_),
+              blocked_range3d(second, rows_, cols_)};
+    }
+    if (rows >= cols) {
+      auto const [first, second] = rows_.split();
+      return {blocked_range3d(pages_, first, cols_),
+              blocked_range3d(pages_, second, cols_)};
+    }
+    auto const [first, second] = cols_.split();
+    return {blocked_range3d(pages_, rows_, first),
+            blocked_range3d(pages_, rows_, second)};
+  }
+
+ private:
+  page_range_type pages_;
+  row_range_type rows_;
+  col_range_type cols_;
+};
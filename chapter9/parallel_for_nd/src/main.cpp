@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include "blocked_range.h"
+#include "parallel_for.h"
+#include "thread_pool.h"
+
+using index_range = blocked_range<std::size_t>;
+using tile_range = blocked_range2d<std::size_t>;
+using volume_range = blocked_range3d<std::size_t>;
+
+template <typename F>
+void timed(char const* name, F&& f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  f();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << name << ": "
+            << std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                     start)
+                   .count()
+            << " microseconds" << std::endl;
+}
+
+// 行优先存储的 n x n 矩阵; 元素取小整数, 不同的求和顺序结果完全相同
+std::vector<float> random_matrix(std::size_t n, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> dist(0, 7);
+  std::vector<float> m(n * n);
+  for (float& v : m) {
+    v = static_cast<float>(dist(gen));
+  }
+  return m;
+}
+
+bool check_transpose(thread_pool& pool) {
+  std::size_t const n = 4096;
+  std::vector<float> const in = random_matrix(n, 1);
+  std::vector<float> expected(n * n), out(n * n);
+
+  std::cout << "--- transpose " << n << "x" << n << " ---" << std::endl;
+  timed("sequential", [&] {
+    for (std::size_t i = 0; i < n; ++i) {
+      for (std::size_t j = 0; j < n; ++j) {
+        expected[j * n + i] = in[i * n + j];
+      }
+    }
+  });
+  // 按行切分: 每个块读连续的几行, 写入时却跨越了整个输出
+  timed("parallel_for, blocked_range rows", [&] {
+    parallel_for(pool, index_range(0, n, 16), [&](index_range const& r) {
+      for (std::size_t i = r.begin(); i != r.end(); ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+          out[j * n + i] = in[i * n + j];
+        }
+      }
+    });
+  });
+  bool correct = out == expected;
+  // 32x32 的块: 读写的 4KB + 4KB 都在 L1 里
+  std::fill(out.begin(), out.end(), 0.0f);
+  timed("parallel_for, blocked_range2d 32x32 tiles", [&] {
+    parallel_for(pool, tile_range(0, n, 32, 0, n, 32),
+                 [&](tile_range const& r) {
+                   for (std::size_t i = r.rows().begin(); i != r.rows().end();
+                        ++i) {
+                     for (std::size_t j = r.cols().begin();
+                          j != r.cols().end(); ++j) {
+                       out[j * n + i] = in[i * n + j];
+                     }
+                   }
+                 });
+  });
+  return correct && out == expected;
+}
+
+bool check_gemm(thread_pool& pool) {
+  std::size_t const n = 512;
+  std::vector<float> const a = random_matrix(n, 2);
+  std::vector<float> const b = random_matrix(n, 3);
+  std::vector<float> expected(n * n), c(n * n);
+
+  std::cout << "\n--- gemm " << n << "x" << n << " ---" << std::endl;
+  timed("sequential i-j-k", [&] {
+    for (std::size_t i = 0; i < n; ++i) {
+      for (std::size_t j = 0; j < n; ++j) {
+        float sum = 0;
+        for (std::size_t k = 0; k < n; ++k) {
+          sum += a[i * n + k] * b[k * n + j];
+        }
+        expected[i * n + j] = sum;
+      }
+    }
+  });
+  // 按行切分, i-k-j 顺序: 每一行 C 都要把整个 B 读一遍
+  timed("parallel_for, blocked_range rows", [&] {
+    parallel_for(pool, index_range(0, n, 8), [&](index_range const& r) {
+      for (std::size_t i = r.begin(); i != r.end(); ++i) {
+        float* const c_row = &c[i * n];
+        for (std::size_t k = 0; k < n; ++k) {
+          float const aik = a[i * n + k];
+          float const* const b_row = &b[k * n];
+          for (std::size_t j = 0; j < n; ++j) {
+            c_row[j] += aik * b_row[j];
+          }
+        }
+      }
+    });
+  });
+  bool correct = c == expected;
+  // C 的 64x64 块, k 方向也按 64 分段: 每一段只用到 A 和 B 各一个 16KB 的块
+  std::size_t const k_block = 64;
+  std::fill(c.begin(), c.end(), 0.0f);
+  timed("parallel_for, blocked_range2d 64x64 tiles", [&] {
+    parallel_for(pool, tile_range(0, n, 64, 0, n, 64),
+                 [&](tile_range const& r) {
+                   std::size_t const i_end = r.rows().end();
+                   std::size_t const j_begin = r.cols().begin();
+                   std::size_t const j_end = r.cols().end();
+                   for (std::size_t kk = 0; kk < n; kk += k_block) {
+                     std::size_t const k_end = std::min(kk + k_block, n);
+                     for (std::size_t i = r.rows().begin(); i != i_end; ++i) {
+                       float* const c_row = &c[i * n];
+                       for (std::size_t k = kk; k != k_end; ++k) {
+                         float const aik = a[i * n + k];
+                         float const* const b_row = &b[k * n];
+                         for (std::size_t j = j_begin; j != j_end; ++j) {
+                           c_row[j] += aik * b_row[j];
+                         }
+                       }
+                     }
+                   }
+                 });
+  });
+  return correct && c == expected;
+}
+
+// 三维 7 点模板: 每个内部点等于自己和 6 个邻居之和
+bool check_stencil(thread_pool& pool) {
+  std::size_t const n = 128;
+  std::vector<int> in(n * n * n), expected(n * n * n), out(n * n * n);
+  std::mt19937 gen(4);
+  for (int& v : in) {
+    v = static_cast<int>(gen() % 100);
+  }
+  auto at = [n](std::size_t z, std::size_t y, std::size_t x) {
+    return (z * n + y) * n + x;
+  };
+  auto stencil = [&](std::vector<int>& dst, std::size_t z, std::size_t y,
+                     std::size_t x) {
+    dst[at(z, y, x)] = in[at(z, y, x)] + in[at(z - 1, y, x)] +
+                       in[at(z + 1, y, x)] + in[at(z, y - 1, x)] +
+                       in[at(z, y + 1, x)] + in[at(z, y, x - 1)] +
+                       in[at(z, y, x + 1)];
+  };
+
+  std::cout << "\n--- 7-point stencil " << n << "^3 ---" << std::endl;
+  timed("sequential", [&] {
+    for (std::size_t z = 1; z + 1 < n; ++z) {
+      for (std::size_t y = 1; y + 1 < n; ++y) {
+        for (std::size_t x = 1; x + 1 < n; ++x) {
+          stencil(expected, z, y, x);
+        }
+      }
+    }
+  });
+  timed("parallel_for, blocked_range3d 8x8x64 tiles", [&] {
+    parallel_for(pool,
+                 volume_range(index_range(1, n - 1, 8),
+                              index_range(1, n - 1, 8),
+                              index_range(1, n - 1, 64)),
+                 [&](volume_range const& r) {
+                   for (std::size_t z = r.pages().begin();
+                        z != r.pages().end(); ++z) {
+                     for (std::size_t y = r.rows().begin();
+                          y != r.rows().end(); ++y) {
+                       for (std::size_t x = r.cols().begin();
+                            x != r.cols().end(); ++x) {
+                         stencil(out, z, y, x);
+                       }
+                     }
+                   }
+                 });
+  });
+  return out == expected;
+}
+
+// 切分覆盖每个元素恰好一次, 块的形状接近 grainsize; 异常会传回调用线程
+bool check_splitting(thread_pool& pool) {
+  std::size_t const rows = 300, cols = 1000;
+  std::vector<int> visits(rows * cols);
+  std::vector<tile_range> tiles;
+  std::mutex mtx;
+  parallel_for(pool, tile_range(0, rows, 16, 0, cols, 16),
+               [&](tile_range const& r) {
+                 for (std::size_t i = r.rows().begin(); i != r.rows().end();
+                      ++i) {
+                   for (std::size_t j = r.cols().begin();
+                        j != r.cols().end(); ++j) {
+                     ++visits[i * cols + j];
+                   }
+                 }
+                 std::lock_guard<std::mutex> lock(mtx);
+                 tiles.push_back(r);
+               });
+  bool correct =
+      std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; });
+  correct = correct && std::all_of(tiles.begin(), tiles.end(),
+                                   [](tile_range const& r) {
+                                     return r.rows().size() <= 16 &&
+                                            r.cols().size() <= 16 &&
+                                            r.rows().size() > 8 &&
+                                            r.cols().size() > 8;
+                                   });
+
+  try {
+    parallel_for(pool, index_range(0, 100000, 100),
+                 [](index_range const& r) {
+                   if (r.begin() <= 77777 && 77777 < r.end()) {
+                     throw std::runtime_error("tile failed");
+                   }
+                 });
+    correct = false;
+  } catch (std::runtime_error const&) {
+  }
+  parallel_for(pool, index_range(5, 5), [&](index_range const&) {
+    correct = false;
+  });
+  return correct;
+}
+
+int main() {
+  try {
+    thread_pool pool;
+    bool correct = check_transpose(pool);
+    correct = check_gemm(pool) && correct;
+    correct = check_stencil(pool) && correct;
+    correct = check_splitting(pool) && correct;
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "blocked_range.h"
+#include "thread_pool.h"
+
+// 在 thread_pool(任务窃取线程池)上并行处理一个可切分的区间
+// body(子区间) 处理一个不能再切分的块, 块的形状由区间的 grainsize 决定
+// 切分分两段:
+//   - 前 parallel_depth 层: 每次对半切, 后一半提交给线程池, 当前线程继续
+//     切前一半. 提交的任务先进入当前线程的本地队列, 空闲线程从队列的另一端
+//     窃取, 偷走的总是最早提交, 也就是最大的那一块
+//   - 之后在当前线程上顺序递归: 先处理前一半再处理后一半. 每次切最长的
+//     一维, 二维时的访问顺序是 Z 形(Morton 序), 任何尺度上相邻的块都是连续
+//     处理的, 不需要知道各级缓存的大小就能在每一级上复用数据(cache-oblivious)
+namespace parallel_for_detail {
+
+// 提交的任务数约为线程数的这么多倍, 足够让先做完的线程窃取到任务
+constexpr unsigned tasks_per_thread = 8;
+
+template <typename T>
+void wait_for(thread_pool& pool, std::future<T>& f) {
+  while (f.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
+    pool.run_pending_task();
+  }
+}
+
+inline unsigned parallel_depth() {
+  unsigned const tasks =
+      std::max(std::thread::hardware_concurrency(), 1u) * tasks_per_thread;
+  unsigned depth = 0;
+  while ((1u << depth) < tasks) {
+    ++depth;
+  }
+  return depth;
+}
+
+template <typename Range, typename Body>
+void run_serial(Range const& range, Body const& body) {
+  if (!range.is_divisible()) {
+    body(range);
+    return;
+  }
+  auto const [first, second] = range.split();
+  run_serial(first, body);
+  run_serial(second, body);
+}
+
+template <typename Range, typename Body>
+void run_parallel(thread_pool& pool, Range range, Body const& body,
+                  unsigned depth) {
+  std::vector<std::future<void>> pending;
+  try {
+    for (; depth != 0 && range.is_divisible(); --depth) {
+      auto const [first, second] = range.split();
+      pending.push_back(pool.submit([&pool, second, &body, depth] {
+        run_parallel(pool, second, body, depth - 1);
+      }));
+      range = first;
+    }
+    run_serial(range, body);
+  } catch (...) {
+    // 已提交的任务还在使用 body, 异常时也要等它们结束
+    for (auto& f : pending) {
+      wait_for(pool, f);
+    }
+    throw;
+  }
+  for (auto& f : pending) {
+    wait_for(pool, f);
+  }
+  for (auto& f : pending) {
+    f.get();
+  }
+}
+
+}  // namespace parallel_for_detail
+
+template <typename Range, typename Body>
+void parallel_for(thread_pool& pool, Range const& range, Body const& body) {
+  using namespace parallel_for_detail;
+  if (range.empty()) {
+    return;
+  }
+  run_parallel(pool, range, body, parallel_depth());
+}
@@ -1,8 +1,16 @@
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <future>
+#include <iostream>
 #include <list>
-#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
 
+#include "parallel_introsort.h"
 #include "thread_pool.h"
 
 template <typename T>
@@ -24,8 +32,10 @@ struct sorter {
     new_lower_chunk.splice(new_lower_chunk.end(), chunk_data,
                            chunk_data.begin(), divide_point);
 
-    std::future<std::list<T> > new_lower = pool.submit(
-        std::bind(&sorter::do_sort, this, std::move(new_lower_chunk)));
+    std::future<std::list<T> > new_lower =
+        pool.submit([this, chunk = std::move(new_lower_chunk)]() mutable {
+          return do_sort(std::move(chunk));
+        });
     std::list<T> new_higher(do_sort(std::move(chunk_data)));
     result.splice(result.end(), new_higher);
 
@@ -46,4 +56,113 @@ std::list<T> parallel_quick_sort(std::list<T> input) {
   }
   sorter<T> s;
   return s.do_sort(std::move(input));
-}
\ No newline at end of file
+}
+
+template <typename F>
+long long elapsed_us(F&& f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  f();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+      .count();
+}
+
+// 与 std::sort 比较耗时和结果
+template <typename T, typename Compare = std::less<>>
+bool check_introsort(thread_pool& pool, std::string const& name,
+                     std::vector<T> data, Compare comp = Compare()) {
+  std::vector<T> expected = data;
+  long long std_us =
+      elapsed_us([&] { std::sort(expected.begin(), expected.end(), comp); });
+  long long parallel_us = elapsed_us(
+      [&] { parallel_introsort(pool, data.begin(), data.end(), comp); });
+  std::cout << name << ": std::sort " << std_us
+            << " us, parallel_introsort " << parallel_us << " us, speedup "
+            << static_cast<double>(std_us) / std::max(parallel_us, 1ll) << "x"
+            << std::endl;
+  return data == expected;
+}
+
+int main() {
+  try {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 1000000000);
+    std::vector<int> random(2000000);
+    for (int& v : random) {
+      v = dist(gen);
+    }
+
+    thread_pool pool;
+    bool correct = check_introsort(pool, "random", random);
+
+    std::vector<int> sorted = random;
+    std::sort(sorted.begin(), sorted.end());
+    correct = check_introsort(pool, "sorted", sorted) && correct;
+    correct = check_introsort(pool, "reversed", sorted, std::greater<>()) &&
+              correct;
+
+    std::vector<int> few_values = random;
+    for (int& v : few_values) {
+      v %= 4;
+    }
+    correct = check_introsort(pool, "4 distinct values", few_values) && correct;
+    std::vector<int> all_equal(1000000, 7);
+    correct = check_introsort(pool, "all equal", all_equal) && correct;
+
+    // 锯齿形输入: 针对三数取中的常见退化情况
+    std::vector<int> sawtooth(1000000);
+    for (std::size_t i = 0; i < sawtooth.size(); ++i) {
+      sawtooth[i] = static_cast<int>(i % 1000);
+    }
+    correct = check_introsort(pool, "sawtooth", sawtooth) && correct;
+
+    std::vector<std::string> strings(200000);
+    for (std::string& s : strings) {
+      s = std::to_string(dist(gen));
+    }
+    correct = check_introsort(pool, "strings", strings) && correct;
+
+    std::vector<int> empty, one = {1}, small = {3, 1, 2};
+    parallel_introsort(pool, empty.begin(), empty.end());
+    parallel_introsort(pool, one.begin(), one.end());
+    parallel_introsort(pool, small.begin(), small.end());
+    correct = correct && empty.empty() && one == std::vector<int>{1} &&
+              small == std::vector<int>{1, 2, 3};
+
+    // 并行划分单独检查: 结果是原数据的排列, 划分点两侧分别满足和不满足谓词
+    std::vector<int> parted = random;
+    auto is_even = [](int v) { return v % 2 == 0; };
+    auto mid = parallel_partition(pool, parted.begin(), parted.end(), is_even);
+    correct = correct && std::all_of(parted.begin(), mid, is_even) &&
+              std::none_of(mid, parted.end(), is_even);
+    std::sort(parted.begin(), parted.end());
+    correct = correct && parted == sorted;
+
+    // 链表版本: 划分点取第一个元素, 每个元素都提交一个任务, 等待时又在栈上
+    // 嵌套执行其他任务, 大输入或有序输入会栈溢出, 这里只测小的随机输入
+    std::list<int> list_data(random.begin(), random.begin() + 5000);
+    std::list<int> list_expected = list_data;
+    list_expected.sort();
+    correct = correct && parallel_quick_sort(list_data) == list_expected;
+
+    if (correct) {
+      std::cout << "result validation: correct" << std::endl;
+    } else {
+      std::cout << "result validation: incorrect" << std::endl;
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << "thread create failed, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::bad_alloc& e) {
+    std::cerr << "badalloc, " << e.what() << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "exception, " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown exception, " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 随机访问区间上的并行内省排序(introsort)
+// 链表版本每次划分都要把一半元素 splice 到新链表, 再把结果拼回去;
+// 这里直接在原数组上划分, 不分配任何额外的存储:
+//   - 大区间用分块并行划分, 所有线程同时参与一次划分
+//   - 划分后两半足够大时, 一半作为任务提交给线程池, 另一半在当前线程继续
+//   - 划分点用多级三数取中(median of medians of 3)选取, 样本数随长度增加
+//   - 短区间用插入排序, 递归过深时改用堆排序, 最坏情况仍是 O(n log n)
+namespace introsort_detail {
+
+// 短于这个长度的区间直接插入排序
+constexpr std::ptrdiff_t insertion_cutoff = 16;
+// 两半都长于这个长度时才把其中一半提交给线程池
+constexpr std::ptrdiff_t task_cutoff = 1 << 13;
+// 长于这个长度的区间才值得用多个线程一起划分
+constexpr std::ptrdiff_t parallel_partition_cutoff = 1 << 16;
+// 并行划分时每个块的元素个数, 每个线程至少分到 4 个块
+constexpr std::ptrdiff_t partition_block_size = 1 << 10;
+constexpr std::ptrdiff_t min_blocks_per_thread = 4;
+
+template <typename T>
+void wait_for(thread_pool& pool, std::future<T>& f) {
+  while (f.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
+    pool.run_pending_task();
+  }
+}
+
+// 析构时等待任务完成: 任务还在访问调用方的区间, 异常时也不能提前返回
+template <typename T>
+class task_guard {
+ public:
+  task_guard(thread_pool& pool, std::future<T>& f) : pool_(pool), f_(f) {}
+  task_guard(task_guard const&) = delete;
+  task_guard& operator=(task_guard const&) = delete;
+  ~task_guard() {
+    if (f_.valid()) {
+      wait_for(pool_, f_);
+    }
+  }
+
+ private:
+  thread_pool& pool_;
+  std::future<T>& f_;
+};
+
+// 分块并行划分, 满足 pred 的元素放在前面
+// 区间从两端切成大小相同的块: 左块从前往后编号, 右块从后往前编号
+// 每个线程各领一个左块和一个右块, 把左块中不满足 pred 的元素与右块中满足
+// pred 的元素成对交换; 哪一边的块处理完了就再领一个同侧的块, 直到没有块可领
+// 处理完的左块全部满足 pred, 处理完的右块全部不满足 pred
+// 每个线程退出时至多剩下一个左块和一个右块没处理完, 由 finish() 收尾:
+// 先把未完成的块交换到紧挨中间的位置, 再对这一小段混合区域顺序划分
+template <typename RandomIt, typename Predicate>
+class block_partitioner {
+ public:
+  static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+  // 一个线程退出时没处理完的左块和右块编号, none 表示没有
+  struct leftover {
+    std::size_t left = none;
+    std::size_t right = none;
+  };
+
+  block_partitioner(RandomIt first, RandomIt last, Predicate& pred)
+      : first_(first),
+        last_(last),
+        pred_(pred),
+        remaining_((last - first) / partition_block_size) {}
+
+  block_partitioner(block_partitioner const&) = delete;
+  block_partitioner& operator=(block_partitioner const&) = delete;
+
+  leftover run() {
+    leftover result;
+    std::size_t left, right;
+    if (!claim(left_claimed_, left)) {
+      return result;
+    }
+    if (!claim(right_claimed_, right)) {
+      result.left = left;
+      return result;
+    }
+    RandomIt l = left_block(left), l_end = l + partition_block_size;
+    RandomIt r = right_block(right), r_end = r + partition_block_size;
+    for (;;) {
+      while (l != l_end && pred_(*l)) {
+        ++l;
+      }
+      while (r != r_end && !pred_(*r)) {
+        ++r;
+      }
+      if (l == l_end) {
+        if (!claim(left_claimed_, left)) {
+          break;
+        }
+        l = left_block(left);
+        l_end = l + partition_block_size;
+        continue;
+      }
+      if (r == r_end) {
+        if (!claim(right_claimed_, right)) {
+          break;
+        }
+        r = right_block(right);
+        r_end = r + partition_block_size;
+        continue;
+      }
+      std::iter_swap(l, r);
+      ++l;
+      ++r;
+    }
+    if (l != l_end) {
+      result.left = left;
+    }
+    if (r != r_end) {
+      result.right = right;
+    }
+    return result;
+  }
+
+  // 所有线程的 run() 都返回之后调用, 返回第一个不满足 pred 的位置
+  RandomIt finish(std::vector<leftover> const& leftovers) {
+    std::vector<std::size_t> lefts, rights;
+    for (leftover const& l : leftovers) {
+      if (l.left != none) {
+        lefts.push_back(l.left);
+      }
+      if (l.right != none) {
+        rights.push_back(l.right);
+      }
+    }
+    std::size_t const left_count = left_claimed_.load();
+    std::size_t const right_count = right_claimed_.load();
+    pack(lefts, left_count, [this](std::size_t i) { return left_block(i); });
+    pack(rights, right_count,
+         [this](std::size_t i) { return right_block(i); });
+    // 混合区域: 未完成的左块 + 没有被领走的零头(不足一块) + 未完成的右块
+    RandomIt const mixed_first =
+        first_ + (left_count - lefts.size()) * partition_block_size;
+    RandomIt const mixed_last =
+        last_ - (right_count - rights.size()) * partition_block_size;
+    return std::partition(mixed_first, mixed_last, pred_);
+  }
+
+ private:
+  // 领取一个块; 两侧共用 remaining_ 计数, 所以左块和右块不会重叠
+  bool claim(std::atomic<std::size_t>& side, std::size_t& index) {
+    if (remaining_.fetch_sub(1) <= 0) {
+      return false;
+    }
+    index = side.fetch_add(1);
+    return true;
+  }
+
+  RandomIt left_block(std::size_t i) const {
+    return first_ + i * partition_block_size;
+  }
+  RandomIt right_block(std::size_t i) const {
+    return last_ - (i + 1) * partition_block_size;
+  }
+
+  // 把同侧 count 个块中未完成的块换到编号最大的位置(紧挨混合区域)
+  template <typename BlockAt>
+  static void pack(std::vector<std::size_t>& unfinished, std::size_t count,
+                   BlockAt block_at) {
+    std::sort(unfinished.begin(), unfinished.end());
+    std::size_t const target = count - unfinished.size();
+    std::vector<std::size_t> done_in_target;
+    for (std::size_t i = target; i != count; ++i) {
+      if (!std::binary_search(unfinished.begin(), unfinished.end(), i)) {
+        done_in_target.push_back(i);
+      }
+    }
+    auto next = done_in_target.begin();
+    for (std::size_t i : unfinished) {
+      if (i < target) {
+        std::swap_ranges(block_at(i), block_at(i) + partition_block_size,
+                         block_at(*next++));
+      }
+    }
+  }
+
+  RandomIt const first_;
+  RandomIt const last_;
+  Predicate& pred_;
+  std::atomic<std::ptrdiff_t> remaining_;  // 还没被领走的块数
+  std::atomic<std::size_t> left_claimed_{0};
+  std::atomic<std::size_t> right_claimed_{0};
+};
+
+// 在 [first, first + n) 上均匀取 3^levels 个样本, 逐层取三数中值
+template <typename RandomIt, typename Compare>
+RandomIt sample_median(RandomIt first, std::ptrdiff_t n, int levels,
+                       Compare& comp) {
+  auto median_of_three = [&comp](RandomIt a, RandomIt b, RandomIt c) {
+    if (comp(*a, *b)) {
+      return comp(*b, *c) ? b : (comp(*a, *c) ? c : a);
+    }
+    return comp(*a, *c) ? a : (comp(*b, *c) ? c : b);
+  };
+  if (levels == 1) {
+    return median_of_three(first, first + n / 2, first + (n - 1));
+  }
+  std::ptrdiff_t const third = n / 3;
+  return median_of_three(
+      sample_median(first, third, levels - 1, comp),
+      sample_median(first + third, third, levels - 1, comp),
+      sample_median(first + 2 * third, n - 2 * third, levels - 1, comp));
+}
+
+// 区间越长, 划分不均的代价越大, 多取一些样本: 3, 9, 27 或 81 个
+// 不取 *first: 上一次划分把划分点换回时, 放到 first 的常常是较小一半的最大值
+template <typename RandomIt, typename Compare>
+RandomIt choose_pivot(RandomIt first, RandomIt last, Compare& comp) {
+  std::ptrdiff_t const n = last - first - 1;
+  int const levels = n < 128 ? 1 : n < (1 << 13) ? 2 : n < (1 << 20) ? 3 : 4;
+  return sample_median(first + 1, n, levels, comp);
+}
+
+template <typename RandomIt, typename Compare>
+void insertion_sort(RandomIt first, RandomIt last, Compare& comp) {
+  if (first == last) {
+    return;
+  }
+  for (RandomIt i = first + 1; i != last; ++i) {
+    auto value = std::move(*i);
+    RandomIt j = i;
+    for (; j != first && comp(value, *(j - 1)); --j) {
+      *j = std::move(*(j - 1));
+    }
+    *j = std::move(value);
+  }
+}
+
+template <typename RandomIt, typename Compare>
+void heap_sort(RandomIt first, RandomIt last, Compare& comp) {
+  std::make_heap(first, last, comp);
+  std::sort_heap(first, last, comp);
+}
+
+}  // namespace introsort_detail
+
+// 并行的 std::partition: 满足 pred 的元素放在前面, 返回第一个不满足的位置
+// 调用线程也参与划分, 等待其他任务时会帮线程池执行任务
+// 与 std::partition 一样不是稳定的
+template <typename RandomIt, typename Predicate>
+RandomIt parallel_partition(thread_pool& pool, RandomIt first, RandomIt last,
+                            Predicate pred) {
+  using namespace introsort_detail;
+  using partitioner_type = block_partitioner<RandomIt, Predicate>;
+
+  std::ptrdiff_t const n = last - first;
+  std::ptrdiff_t const hardware_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  std::ptrdiff_t const num_threads = std::min(
+      hardware_threads, n / (partition_block_size * min_blocks_per_thread));
+  if (n < parallel_partition_cutoff || num_threads <= 1) {
+    return std::partition(first, last, pred);
+  }
+
+  partitioner_type partitioner(first, last, pred);
+  std::vector<std::future<typename partitioner_type::leftover>> futures;
+  std::vector<typename partitioner_type::leftover> leftovers;
+  try {
+    for (std::ptrdiff_t i = 1; i < num_threads; ++i) {
+      futures.push_back(pool.submit([&partitioner] {
+        return partitioner.run();
+      }));
+    }
+    leftovers.push_back(partitioner.run());
+  } catch (...) {
+    for (auto& f : futures) {
+      wait_for(pool, f);
+    }
+    throw;
+  }
+  // 先等所有任务结束再取结果, get() 抛出异常时不会有任务还在访问区间
+  for (auto& f : futures) {
+    wait_for(pool, f);
+  }
+  for (auto& f : futures) {
+    leftovers.push_back(f.get());
+  }
+  return partitioner.finish(leftovers);
+}
+
+namespace introsort_detail {
+
+template <typename RandomIt, typename Compare>
+void introsort_loop(thread_pool& pool, RandomIt first, RandomIt last,
+                    Compare comp, int depth_limit) {
+  while (last - first > insertion_cutoff) {
+    if (depth_limit == 0) {
+      heap_sort(first, last, comp);
+      return;
+    }
+    --depth_limit;
+    // 划分点换到 first, 划分其余元素, 再把划分点换到两部分之间
+    std::iter_swap(first, choose_pivot(first, last, comp));
+    RandomIt const pivot =
+        parallel_partition(pool, first + 1, last,
+                           [&](auto const& x) { return comp(x, *first); }) -
+        1;
+    std::iter_swap(first, pivot);
+    RandomIt upper = pivot + 1;
+    // 没有比划分点小的元素时, 可能有大量与它相等的元素, 一次把它们都排除,
+    // 否则全部相等的输入每次划分只能排除一个元素
+    if (pivot == first) {
+      upper = parallel_partition(
+          pool, upper, last, [&](auto const& x) { return !comp(*pivot, x); });
+    }
+
+    if (pivot - first >= task_cutoff && last - upper >= task_cutoff) {
+      std::future<void> lower =
+          pool.submit([&pool, first, pivot, comp, depth_limit] {
+            introsort_loop(pool, first, pivot, comp, depth_limit);
+          });
+      task_guard<void> guard(pool, lower);
+      introsort_loop(pool, upper, last, comp, depth_limit);
+      wait_for(pool, lower);
+      lower.get();
+      return;
+    }
+    // 顺序处理时递归较短的一半, 循环处理较长的一半, 栈深度不超过 log n
+    if (pivot - first < last - upper) {
+      introsort_loop(pool, first, pivot, comp, depth_limit);
+      first = upper;
+    } else {
+      introsort_loop(pool, upper, last, comp, depth_limit);
+      last = pivot;
+    }
+  }
+  insertion_sort(first, last, comp);
+}
+
+}  // namespace introsort_detail
+
+// 递归深度超过 2 log2(n) 时剩余部分改用堆排序
+template <typename RandomIt, typename Compare = std::less<>>
+void parallel_introsort(thread_pool& pool, RandomIt first, RandomIt last,
+                        Compare comp = Compare()) {
+  int depth_limit = 0;
+  for (std::ptrdiff_t n = last - first; n > 1; n >>= 1) {
+    depth_limit += 2;
+  }
+  introsort_detail::introsort_loop(pool, first, last, comp, depth_limit);
+}
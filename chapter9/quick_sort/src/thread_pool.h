@@ -1,12 +1,15 @@
+#pragma once
 
 #include <atomic>
 #include <future>
+#include <memory>
 #include <thread>
 #include <vector>
 
 #include "function_wrapper.h"
 #include "join_threads.h"
 #include "threadsafe_queue.h"
+#include "work_stealing_queue.h"
 
 class thread_pool {
  public:
@@ -14,14 +17,18 @@ class thread_pool {
     unsigned const thread_count = std::thread::hardware_concurrency();
     try {
       for (unsigned i = 0; i < thread_count; ++i) {
-        threads_.push_back(std::thread(&thread_pool::worker_thread, this));
+        queues_.push_back(
+            std::make_unique<work_stealing_queue<function_wrapper>>());
+      }
+
+      for (unsigned i = 0; i < thread_count; ++i) {
+        threads_.push_back(std::thread(&thread_pool::worker_thread, this, i));
       }
     } catch (...) {
       done_ = true;
       throw;
     }
   }
-
   ~thread_pool() { done_ = true; }
 
   template <typename FunctionType>
@@ -34,13 +41,25 @@ class thread_pool {
     if (done_) {
       return std::future<result_type>();
     }
-    work_queue_.push(std::move(task));
+
+    if (local_work_queue_) {
+      local_work_queue_->push(std::move(task));
+      // std::cout << "push to thread " << index_ << " local queue" << std::endl;
+    } else {
+      pool_work_queue_.push(std::move(task));
+      // std::cout << "push to thread " << index_ << " pool queue" << std::endl;
+    }
+
     return result;
   }
 
   void run_pending_task() {
     function_wrapper task;
-    if (work_queue_.try_pop(task)) {
+    // 优先从当前线程的专属任务队列中获取任务
+    // 如果当前线程的专属任务队列为空, 则从全局任务队列中获取任务
+    // 如果全局任务队列为空, 则从其他线程的专属任务队列中获取任务
+    if (pop_task_from_local_queue(task) || pop_task_from_pool_queue(task) ||
+        pop_task_from_other_thread_queue(task)) {
       task();
     } else {
       std::this_thread::yield();
@@ -48,20 +67,46 @@ class thread_pool {
   }
 
  private:
-  void worker_thread() {
+  void worker_thread(size_t index) {
+    index_ = index;
+    local_work_queue_ = queues_[index].get();
     while (!done_) {
-      function_wrapper task;
-      if (work_queue_.try_pop(task)) {
-        task();
-      } else {
-        std::this_thread::yield();
+      run_pending_task();
+    }
+  }
+
+  bool pop_task_from_local_queue(function_wrapper& task) {
+    return local_work_queue_ && local_work_queue_->try_pop(task);
+  }
+
+  bool pop_task_from_pool_queue(function_wrapper& task) {
+    return pool_work_queue_.try_pop(task);
+  }
+
+  bool pop_task_from_other_thread_queue(function_wrapper& task) {
+    for (size_t i = 0; i < queues_.size(); ++i) {
+      size_t index = (index_ + i + 1) %
+                     queues_.size();  // 从下一个线程的专属任务队列中获取任务
+      if (queues_[index]->try_steal(task)) {
+        return true;
       }
     }
+    return false;
   }
 
  private:
   std::atomic<bool> done_;
-  threadsafe_queue<function_wrapper> work_queue_;
+  threadsafe_queue<function_wrapper>
+      pool_work_queue_;  // 全局任务队列, 被所有线程共享
+  std::vector<std::unique_ptr<work_stealing_queue<function_wrapper>>>
+      queues_;  // 线程专属任务队列, 被每个线程持有
   std::vector<std::thread> threads_;
   join_threads joiner_;
-};
\ No newline at end of file
+  static thread_local work_stealing_queue<function_wrapper>*
+      local_work_queue_;              // 当前线程的专属任务队列
+  static thread_local size_t index_;  // 当前线程的索引
+};
+
+inline thread_local work_stealing_queue<function_wrapper>*
+    thread_pool::local_work_queue_ = nullptr;
+inline thread_local size_t thread_pool::index_ = 0;
\ No newline at end of file